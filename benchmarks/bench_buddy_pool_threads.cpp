@@ -0,0 +1,68 @@
+#include <random>
+#include <thread>
+
+#include <crocore/BuddyPool.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+/**
+ * @brief   Each thread performs a steady-state mix of allocations/frees with random sizes,
+ *          keeping a bounded number of live allocations. The pool is spread across several toplevel blocks.
+ *
+ * @return  the average duration per operation in nanoseconds, measured across all threads.
+ */
+double run(uint32_t num_threads, bool block_locks)
+{
+    constexpr size_t num_ops = 1U << 18U;
+    constexpr size_t num_live = 256;
+
+    BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 22U;
+    fmt.min_block_size = 64;
+    fmt.min_num_blocks = 8;
+    fmt.bitmap_tree = true;
+    fmt.block_locks = block_locks;
+    auto pool = BuddyPool::create(fmt);
+
+    auto worker = [&pool](uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<void *> pointers;
+
+        for(size_t i = 0; i < num_ops; ++i)
+        {
+            if(pointers.size() >= num_live || (!pointers.empty() && (i & 1U)))
+            {
+                size_t index = rng() % pointers.size();
+                pool->free(pointers[index]);
+                pointers[index] = pointers.back();
+                pointers.pop_back();
+            }
+            else{ pointers.push_back(pool->allocate(64 + rng() % 16384)); }
+        }
+        for(void *ptr: pointers){ pool->free(ptr); }
+    };
+
+    return benchmark::measure_ns([&] {
+        std::vector<std::thread> threads;
+        for(uint32_t t = 0; t < num_threads; ++t){ threads.emplace_back(worker, t); }
+        for(auto &t: threads){ t.join(); }
+    }, num_ops * num_threads);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("BuddyPool: pool-lock vs. per-block locks, 8 toplevel blocks (ns/op)");
+    spdlog::info("{:>8} | {:>12} {:>12}", "threads", "pool-lock", "block-locks");
+
+    for(uint32_t num_threads: {1, 2, 4, 8})
+    {
+        spdlog::info("{:>8} | {:>12.1f} {:>12.1f}", num_threads, run(num_threads, false), run(num_threads, true));
+    }
+    return 0;
+}
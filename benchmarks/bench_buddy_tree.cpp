@@ -0,0 +1,96 @@
+#include <random>
+
+#include <crocore/BuddyPool.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+struct result_t
+{
+    double random_ns = 0.0;
+    double fragmented_ns = 0.0;
+};
+
+/**
+ * @brief   Run two workloads against a single toplevel block:
+ *
+ *          - random: steady-state mix of allocations/frees with random sizes
+ *          - fragmented: a block filled with minimum-sized allocations, every other one freed,
+ *            except for one pair of buddies at the very end. allocating and freeing a block of two leaves
+ *            requires a search across the whole block.
+ */
+result_t run(size_t height, bool bitmap_tree)
+{
+    constexpr size_t min_block_size = 16;
+    constexpr size_t num_random_ops = 1U << 20U;
+    constexpr size_t num_fragmented_ops = 1U << 10U;
+
+    BuddyPool::create_info_t fmt = {};
+    fmt.block_size = min_block_size << height;
+    fmt.min_block_size = min_block_size;
+    fmt.max_num_blocks = 1;
+    fmt.dealloc_unused_blocks = false;
+    fmt.bitmap_tree = bitmap_tree;
+
+    result_t ret = {};
+
+    // random workload, keep the block roughly half-full
+    {
+        auto pool = BuddyPool::create(fmt);
+        std::mt19937 rng(42);
+        std::vector<void *> pointers;
+        size_t num_leaves = size_t(1) << height;
+
+        for(size_t i = 0; i < num_leaves / 8; ++i){ pointers.push_back(pool->allocate(min_block_size << (rng() % 3))); }
+
+        ret.random_ns = benchmark::measure_ns([&] {
+            for(size_t i = 0; i < num_random_ops; ++i)
+            {
+                if(i & 1U)
+                {
+                    size_t index = rng() % pointers.size();
+                    pool->free(pointers[index]);
+                    pointers[index] = pointers.back();
+                    pointers.pop_back();
+                }
+                else if(void *ptr = pool->allocate(min_block_size << (rng() % 3))){ pointers.push_back(ptr); }
+            }
+        }, num_random_ops);
+    }
+
+    // fragmented workload
+    {
+        auto pool = BuddyPool::create(fmt);
+        std::vector<void *> pointers;
+        while(void *ptr = pool->allocate(min_block_size)){ pointers.push_back(ptr); }
+        for(size_t i = 0; i < pointers.size() - 2; i += 2){ pool->free(pointers[i]); }
+        pool->free(pointers[pointers.size() - 2]);
+        pool->free(pointers[pointers.size() - 1]);
+
+        ret.fragmented_ns = benchmark::measure_ns([&] {
+            for(size_t i = 0; i < num_fragmented_ops; ++i){ pool->free(pool->allocate(2 * min_block_size)); }
+        }, num_fragmented_ops);
+    }
+    return ret;
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("BuddyPool: node-state tree vs. bitmap tree (ns/op)");
+    spdlog::info("{:>8} | {:>14} {:>14} | {:>14} {:>14}", "leaves", "random/nodes", "random/bitmap",
+                 "fragmented/nodes", "fragmented/bitmap");
+
+    for(size_t height: {10, 14, 16, 18})
+    {
+        auto nodes = run(height, false);
+        auto bitmap = run(height, true);
+        spdlog::info("{:>8} | {:>14.1f} {:>14.1f} | {:>16.1f} {:>17.1f}", fmt::format("2^{}", height),
+                     nodes.random_ns, bitmap.random_ns, nodes.fragmented_ns, bitmap.fragmented_ns);
+    }
+    return 0;
+}
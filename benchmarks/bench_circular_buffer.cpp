@@ -0,0 +1,90 @@
+#include <numeric>
+
+#include <crocore/CircularBuffer.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+struct result_t
+{
+    double push_ns = 0.0;
+    double push_bulk_ns = 0.0;
+    double consume_ns = 0.0;
+    double consume_bulk_ns = 0.0;
+};
+
+/**
+ * @brief   Stream samples through a CircularBuffer, one at a time vs. in chunks.
+ *
+ * @return  durations per sample in nanoseconds.
+ */
+result_t run(uint32_t capacity, size_t chunk_size)
+{
+    constexpr size_t num_samples = 1U << 24U;
+
+    std::vector<float> chunk(chunk_size);
+    std::iota(chunk.begin(), chunk.end(), 0.f);
+    std::vector<float> out(chunk_size);
+
+    CircularBuffer<float> circ_buf(capacity);
+    result_t ret = {};
+
+    ret.push_ns = benchmark::measure_ns([&] {
+        for(size_t i = 0; i < num_samples; i += chunk_size)
+        {
+            for(float v: chunk){ circ_buf.push_back(v); }
+        }
+        benchmark::do_not_optimize(circ_buf.back());
+    }, num_samples);
+
+    ret.push_bulk_ns = benchmark::measure_ns([&] {
+        for(size_t i = 0; i < num_samples; i += chunk_size){ circ_buf.push_back(chunk); }
+        benchmark::do_not_optimize(circ_buf.back());
+    }, num_samples);
+
+    ret.consume_ns = benchmark::measure_ns([&] {
+        for(size_t i = 0; i < num_samples; i += chunk_size)
+        {
+            circ_buf.push_back(chunk);
+            for(size_t j = 0; j < chunk_size; ++j)
+            {
+                out[j] = circ_buf.front();
+                circ_buf.pop_front();
+            }
+            benchmark::do_not_optimize(out.back());
+        }
+    }, num_samples);
+
+    ret.consume_bulk_ns = benchmark::measure_ns([&] {
+        for(size_t i = 0; i < num_samples; i += chunk_size)
+        {
+            circ_buf.push_back(chunk);
+            circ_buf.pop_front(circ_buf.read(out));
+            benchmark::do_not_optimize(out.back());
+        }
+    }, num_samples);
+    return ret;
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("CircularBuffer<float>: single values vs. spans (ns/sample)");
+    spdlog::info("{:>8} {:>6} | {:>10} {:>10} | {:>12} {:>12}", "capacity", "chunk", "push", "push-span",
+                 "pop", "read+pop");
+
+    for(uint32_t capacity: {1000, 4095, 48000})
+    {
+        for(size_t chunk_size: {64, 512})
+        {
+            auto r = run(capacity, chunk_size);
+            spdlog::info("{:>8} {:>6} | {:>10.2f} {:>10.2f} | {:>12.2f} {:>12.2f}", capacity, chunk_size, r.push_ns,
+                         r.push_bulk_ns, r.consume_ns, r.consume_bulk_ns);
+        }
+    }
+    return 0;
+}
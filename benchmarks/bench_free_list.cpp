@@ -0,0 +1,72 @@
+#include <random>
+#include <thread>
+
+#include <crocore/fixed_size_free_list.h>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+struct object_t
+{
+    uint64_t data[4] = {};
+};
+
+/**
+ * @brief   Multi-threaded churn: each thread keeps up to 64 live objects,
+ *          randomly creating and destroying objects.
+ *
+ * @return  the average duration per operation in nanoseconds.
+ */
+double run(uint32_t num_threads, uint32_t cache_size)
+{
+    constexpr uint32_t num_ops = 1U << 20U;
+    constexpr uint32_t max_num_live = 64;
+
+    fixed_size_free_list<object_t> free_list(fixed_size_free_list<object_t>::s_invalid_index, 1024, cache_size);
+
+    auto worker = [&free_list, num_threads](uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint32_t> indices;
+
+        for(uint32_t i = 0; i < num_ops / num_threads; ++i)
+        {
+            if(!indices.empty() && (indices.size() >= max_num_live || rng() % 2))
+            {
+                size_t pos = rng() % indices.size();
+                free_list.destroy(indices[pos]);
+                indices[pos] = indices.back();
+                indices.pop_back();
+            }
+            else
+            {
+                indices.push_back(free_list.create());
+                benchmark::do_not_optimize(free_list.get(indices.back()));
+            }
+        }
+        for(auto index: indices){ free_list.destroy(index); }
+    };
+
+    return benchmark::measure_ns([&] {
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < num_threads; ++i){ threads.emplace_back(worker, i); }
+        for(auto &t: threads){ t.join(); }
+    }, num_ops);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("fixed_size_free_list: shared head vs. per-thread caches (ns/op)");
+    spdlog::info("{:>8} | {:>10} {:>10} {:>10}", "threads", "uncached", "cache 16", "cache 64");
+
+    for(uint32_t num_threads: {1, 2, 4, 8, 16})
+    {
+        spdlog::info("{:>8} | {:>10.1f} {:>10.1f} {:>10.1f}", num_threads, run(num_threads, 0),
+                     run(num_threads, 16), run(num_threads, 64));
+    }
+    return 0;
+}
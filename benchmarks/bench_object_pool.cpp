@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+
+#include <crocore/ObjectPool.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+struct entity_t
+{
+    float position[3] = {};
+    float velocity[3] = {1.f, 2.f, 3.f};
+};
+
+constexpr uint32_t num_entities = 1U << 16U;
+
+//! integrate all live entities
+template<typename Container>
+double iterate(Container &entities)
+{
+    constexpr uint32_t num_iterations = 16;
+
+    return benchmark::measure_ns([&entities] {
+        for(uint32_t i = 0; i < num_iterations; ++i)
+        {
+            if constexpr(std::is_same_v<Container, ObjectPool<entity_t>>)
+            {
+                entities.for_each([](auto, entity_t &e) {
+                    for(uint32_t j = 0; j < 3; ++j){ e.position[j] += e.velocity[j]; }
+                });
+            }
+            else
+            {
+                for(auto &e: entities)
+                {
+                    for(uint32_t j = 0; j < 3; ++j){ e->position[j] += e->velocity[j]; }
+                }
+            }
+        }
+        benchmark::do_not_optimize(entities);
+    }, num_iterations * num_entities / 2);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    std::mt19937 rng(0);
+
+    // shared_ptr baseline, half of all entities destroyed in random order
+    std::vector<std::shared_ptr<entity_t>> shared_entities;
+    double shared_create_ns = benchmark::measure_ns([&] {
+        for(uint32_t i = 0; i < num_entities; ++i){ shared_entities.push_back(std::make_shared<entity_t>()); }
+    }, num_entities);
+    std::shuffle(shared_entities.begin(), shared_entities.end(), rng);
+    shared_entities.resize(num_entities / 2);
+
+    // ObjectPool, same pattern
+    ObjectPool<entity_t> pool;
+    std::vector<ObjectPool<entity_t>::handle_t> handles;
+    double pool_create_ns = benchmark::measure_ns([&] {
+        for(uint32_t i = 0; i < num_entities; ++i){ handles.push_back(pool.create()); }
+    }, num_entities);
+    std::shuffle(handles.begin(), handles.end(), rng);
+    for(uint32_t i = num_entities / 2; i < num_entities; ++i){ pool.destroy(handles[i]); }
+    handles.resize(num_entities / 2);
+
+    // handle lookups in random order
+    double lookup_ns = benchmark::measure_ns([&] {
+        for(const auto &handle: handles){ benchmark::do_not_optimize(pool.get(handle)); }
+    }, handles.size());
+
+    spdlog::info("ObjectPool vs. std::shared_ptr ({} entities, 50% live)", num_entities);
+    spdlog::info("{:>12} | {:>10} {:>12}", "", "create ns", "iterate ns");
+    spdlog::info("{:>12} | {:>10.1f} {:>12.2f}", "shared_ptr", shared_create_ns, iterate(shared_entities));
+    spdlog::info("{:>12} | {:>10.1f} {:>12.2f}", "ObjectPool", pool_create_ns, iterate(pool));
+    spdlog::info("handle lookup: {:.1f} ns", lookup_ns);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <vector>
+
+#include <crocore/BuddyPool.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+constexpr size_t num_containers = 64;
+constexpr size_t num_elements = 256;
+constexpr size_t num_rounds = 64;
+
+/**
+ * @brief   Create, copy and destroy node-based containers, all allocating from the same BuddyPool.
+ *          Every container-copy also copies its allocator.
+ *
+ * @return  the average duration per element-operation in nanoseconds.
+ */
+template<typename MakeList>
+double run(MakeList make_list)
+{
+    return benchmark::measure_ns([&] {
+        for(size_t r = 0; r < num_rounds; ++r)
+        {
+            std::vector<decltype(make_list())> lists;
+            lists.reserve(2 * num_containers);
+
+            for(size_t c = 0; c < num_containers; ++c)
+            {
+                auto list = make_list();
+                for(size_t i = 0; i < num_elements; ++i){ list.push_back(i); }
+                lists.push_back(list);
+                lists.push_back(std::move(list));
+            }
+            benchmark::do_not_optimize(lists);
+        }
+    }, num_rounds * num_containers * num_elements * 2);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 24U;
+    fmt.min_block_size = 16;
+    BuddyPoolPtr pool = BuddyPool::create(fmt);
+    AllocatorPtr pool_ptr = pool;
+
+    // shared_ptr based stl_allocator, refcount traffic on every allocator-copy
+    double stl_ns = run([&pool_ptr] {
+        return std::list<size_t, stl_allocator<size_t>>(stl_allocator<size_t>(pool_ptr));
+    });
+
+    // std::pmr containers with a plain pointer to a de-virtualized resource
+    pmr_resource<BuddyPool> resource(pool.get());
+    double pmr_ns = run([&resource] { return std::pmr::list<size_t>(&resource); });
+
+    // baseline with global new/delete
+    double std_ns = run([] { return std::list<size_t>(); });
+
+    spdlog::info("std::list: create/copy/destroy (ns/element)");
+    spdlog::info("{:>20} {:>20} {:>20}", "stl_allocator", "pmr_resource", "std::allocator");
+    spdlog::info("{:>20.1f} {:>20.1f} {:>20.1f}", stl_ns, pmr_ns, std_ns);
+    return 0;
+}
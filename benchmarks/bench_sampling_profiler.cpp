@@ -0,0 +1,69 @@
+#include <random>
+
+#include <crocore/BuddyPool.hpp>
+#include <crocore/SamplingProfiler.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+AllocatorPtr create_pool()
+{
+    BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 24U;
+    fmt.min_block_size = 16;
+    fmt.bitmap_tree = true;
+    return BuddyPoolPtr(BuddyPool::create(fmt));
+}
+
+/**
+ * @brief   random allocate/free churn with up to 1024 live allocations of 16 - 1024 bytes.
+ *
+ * @return  the average duration per operation in nanoseconds.
+ */
+double run(const AllocatorPtr &allocator)
+{
+    constexpr uint32_t num_ops = 1U << 20U;
+    std::mt19937 rng(0);
+    std::vector<void *> ptrs;
+
+    return benchmark::measure_ns([&] {
+        for(uint32_t i = 0; i < num_ops; ++i)
+        {
+            if(!ptrs.empty() && (ptrs.size() >= 1024 || rng() % 2))
+            {
+                size_t pos = rng() % ptrs.size();
+                allocator->free(ptrs[pos]);
+                ptrs[pos] = ptrs.back();
+                ptrs.pop_back();
+            }
+            else{ ptrs.push_back(allocator->allocate(16 + rng() % 1009)); }
+        }
+        for(void *ptr: ptrs){ allocator->free(ptr); }
+    }, num_ops);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("SamplingProfiler overhead, wrapping a BuddyPool (ns/op)");
+    spdlog::info("{:>16} | {:>8} {:>9}", "sample interval", "ns/op", "overhead");
+
+    double baseline_ns = run(create_pool());
+    spdlog::info("{:>16} | {:>8.1f} {:>9}", "none", baseline_ns, "-");
+
+    for(size_t sample_interval: {1U << 20U, 1U << 19U, 1U << 16U, 1U << 12U})
+    {
+        SamplingProfiler::create_info_t create_info = {};
+        create_info.allocator = create_pool();
+        create_info.sample_interval = sample_interval;
+        SamplingProfilerPtr profiler = SamplingProfiler::create(create_info);
+
+        double ns = run(profiler);
+        spdlog::info("{:>16} | {:>8.1f} {:>8.1f}%", sample_interval, ns, 100.0 * (ns / baseline_ns - 1.0));
+    }
+    return 0;
+}
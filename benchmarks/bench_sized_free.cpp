@@ -0,0 +1,92 @@
+#include <random>
+
+#include <crocore/BuddyPool.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+enum class FreeMode
+{
+    POINTER,
+    SIZED,
+    HANDLE
+};
+
+/**
+ * @brief   Steady-state mix of allocations/frees with random sizes across many toplevel blocks,
+ *          freeing by pointer (block-search + tree-descent), by pointer and size (block-search only)
+ *          or by allocation-handle (no lookups).
+ */
+double run(FreeMode mode, size_t num_blocks, bool bitmap_tree)
+{
+    constexpr size_t min_block_size = 16;
+    constexpr size_t height = 14;
+    constexpr size_t num_ops = 1U << 20U;
+
+    BuddyPool::create_info_t fmt = {};
+    fmt.block_size = min_block_size << height;
+    fmt.min_block_size = min_block_size;
+    fmt.min_num_blocks = num_blocks;
+    fmt.max_num_blocks = num_blocks;
+    fmt.bitmap_tree = bitmap_tree;
+
+    auto pool = BuddyPool::create(fmt);
+    std::mt19937 rng(42);
+    std::vector<Allocator::allocation_t> allocations;
+
+    auto allocate = [&] {
+        size_t num_bytes = min_block_size << (rng() % 3);
+        auto allocation = mode == FreeMode::HANDLE ? pool->allocate_handle(num_bytes)
+                                                   : Allocator::allocation_t{pool->allocate(num_bytes), num_bytes};
+        if(allocation.ptr){ allocations.push_back(allocation); }
+    };
+
+    // keep blocks roughly half-full
+    for(size_t i = 0; i < num_blocks * (size_t(1) << height) / 8; ++i){ allocate(); }
+
+    return benchmark::measure_ns([&] {
+        for(size_t i = 0; i < num_ops; ++i)
+        {
+            if(i & 1U)
+            {
+                size_t index = rng() % allocations.size();
+                auto allocation = allocations[index];
+                allocations[index] = allocations.back();
+                allocations.pop_back();
+
+                switch(mode)
+                {
+                    case FreeMode::POINTER:pool->free(allocation.ptr);
+                        break;
+                    case FreeMode::SIZED:pool->free(allocation.ptr, allocation.num_bytes);
+                        break;
+                    case FreeMode::HANDLE:pool->free(allocation);
+                        break;
+                }
+            }
+            else{ allocate(); }
+        }
+    }, num_ops);
+}
+
+}// namespace
+
+int main(int, char **)
+{
+    spdlog::info("BuddyPool: free(ptr) vs. free(ptr, size) vs. free(allocation) (ns/op, allocate + free)");
+    spdlog::info("{:>8} {:>8} | {:>10} {:>10} {:>10}", "blocks", "tree", "pointer", "sized", "handle");
+
+    for(size_t num_blocks: {1, 16, 256})
+    {
+        for(bool bitmap_tree: {false, true})
+        {
+            spdlog::info("{:>8} {:>8} | {:>10.1f} {:>10.1f} {:>10.1f}", num_blocks, bitmap_tree ? "bitmap" : "nodes",
+                         run(FreeMode::POINTER, num_blocks, bitmap_tree), run(FreeMode::SIZED, num_blocks, bitmap_tree),
+                         run(FreeMode::HANDLE, num_blocks, bitmap_tree));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#include <crocore/BuddyPool.hpp>
+#include <crocore/MemoryCache.hpp>
+#include <crocore/RecordingAllocator.hpp>
+#include <crocore/SlabAllocator.hpp>
+#include <crocore/TLSFPool.hpp>
+#include <crocore/utils.hpp>
+#include "benchmark.hpp"
+
+using namespace crocore;
+
+namespace
+{
+
+//! baseline, forwarding to malloc/free
+class malloc_allocator_t : public Allocator
+{
+public:
+    void *allocate(size_t num_bytes) override { return ::malloc(num_bytes); }
+
+    //! posix_memalign is used for over-aligned requests, which can be released with free()
+    void *allocate(size_t num_bytes, size_t alignment) override
+    {
+        return alignment <= alignof(std::max_align_t) ? ::malloc(num_bytes)
+                                                      : crocore::aligned_alloc(num_bytes, alignment);
+    }
+
+    void *reallocate(void *ptr, size_t num_bytes) override { return ::realloc(ptr, num_bytes); }
+
+    void free(void *ptr) override { ::free(ptr); }
+
+    void shrink() override {}
+
+    [[nodiscard]] state_t state() const override { return {}; }
+};
+
+//! reads a value in kB from /proc/self/status, e.g. "VmHWM:     1234 kB"
+size_t proc_status_bytes(const std::string &key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string token;
+    size_t value = 0;
+
+    while(status >> token)
+    {
+        if(token == key && status >> value){ return value << 10U; }
+    }
+    return 0;
+}
+
+//! reset the peak resident set size (VmHWM) to the current one, supported since linux 4.0
+void reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+/**
+ * @brief   Record a synthetic workload: mostly small objects, some medium and few large buffers,
+ *          occasional reallocations and frees from other threads.
+ */
+RecordingAllocatorUPtr synthesize_trace(uint32_t num_threads, size_t num_ops_per_thread)
+{
+    auto recorder = RecordingAllocator::create({std::make_shared<malloc_allocator_t>(),
+                                                num_threads * num_ops_per_thread});
+    std::mutex mailbox_mutex;
+    std::vector<void *> mailbox;
+
+    auto worker = [&](uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<void *> pointers;
+
+        auto random_size = [&rng]() -> size_t {
+            uint32_t r = rng() % 100;
+            if(r < 70){ return 16 + rng() % 240; }
+            if(r < 95){ return 256 + rng() % 16128; }
+            return 16384 + rng() % (1U << 20U);
+        };
+
+        for(size_t i = 0; i < num_ops_per_thread; ++i)
+        {
+            uint32_t r = rng() % 100;
+
+            if(pointers.size() > 512 || (!pointers.empty() && r < 40))
+            {
+                size_t index = rng() % pointers.size();
+                void *ptr = pointers[index];
+                pointers[index] = pointers.back();
+                pointers.pop_back();
+
+                // hand over to another thread
+                if(r < 4)
+                {
+                    std::unique_lock lock(mailbox_mutex);
+                    mailbox.push_back(ptr);
+                }
+                else{ recorder->free(ptr); }
+            }
+            else if(!pointers.empty() && r < 50)
+            {
+                size_t index = rng() % pointers.size();
+                if(void *ptr = recorder->reallocate(pointers[index], random_size())){ pointers[index] = ptr; }
+            }
+            else if(r < 52)
+            {
+                // free objects handed over by other threads
+                std::unique_lock lock(mailbox_mutex);
+                for(void *ptr: mailbox){ recorder->free(ptr); }
+                mailbox.clear();
+            }
+            else{ pointers.push_back(recorder->allocate(random_size())); }
+        }
+        for(void *ptr: pointers){ recorder->free(ptr); }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < num_threads; ++t){ threads.emplace_back(worker, t); }
+    for(auto &t: threads){ t.join(); }
+    for(void *ptr: mailbox){ recorder->free(ptr); }
+    return recorder;
+}
+
+struct replay_result_t
+{
+    double ops_per_sec = 0;
+    double p50_ns = 0, p99_ns = 0, p999_ns = 0;
+    size_t peak_rss = 0;
+    double overhead = 0;
+    float fragmentation = 0.f;
+    size_t num_failed = 0;
+};
+
+/**
+ * @brief   Replay a trace against an allocator, using one thread per recorded thread.
+ *          Events on the same allocation are applied in their recorded order,
+ *          threads wait for allocations from other threads, if necessary.
+ */
+replay_result_t replay(const std::vector<trace_event_t> &trace, const AllocatorPtr &allocator)
+{
+    struct slot_t
+    {
+        std::atomic<void *> ptr = nullptr;
+        std::atomic<uint32_t> num_applied = 0;
+    };
+
+    // per-thread event-lists and the ordinal of each event on its allocation
+    std::unordered_map<uint32_t, std::vector<std::pair<size_t, uint32_t>>> thread_events;
+    std::vector<uint32_t> ordinals(trace.size());
+    uint64_t max_id = 0;
+    for(const auto &e: trace){ max_id = std::max(max_id, e.id); }
+
+    std::vector<uint32_t> num_events(max_id + 1, 0);
+    std::vector<size_t> num_requested(max_id + 1, 0);
+    size_t live_bytes = 0, peak_requested_bytes = 0;
+
+    for(size_t i = 0; i < trace.size(); ++i)
+    {
+        const auto &e = trace[i];
+        ordinals[i] = num_events[e.id]++;
+        thread_events[e.thread].emplace_back(i, ordinals[i]);
+
+        // peak of requested bytes
+        live_bytes -= num_requested[e.id];
+        num_requested[e.id] = e.op == TraceOp::FREE ? 0 : e.num_bytes;
+        live_bytes += num_requested[e.id];
+        peak_requested_bytes = std::max(peak_requested_bytes, live_bytes);
+    }
+
+    std::unique_ptr<slot_t[]> slots(new slot_t[max_id + 1]);
+    std::vector<std::vector<uint32_t>> latencies(thread_events.size());
+    std::atomic<size_t> num_failed = 0;
+
+    auto worker = [&](const std::vector<std::pair<size_t, uint32_t>> &events, std::vector<uint32_t> &latency) {
+        latency.reserve(events.size());
+
+        for(const auto &[index, ordinal]: events)
+        {
+            const auto &e = trace[index];
+            auto &slot = slots[e.id];
+
+            // wait for preceding events on this allocation
+            while(slot.num_applied.load(std::memory_order_acquire) != ordinal){ std::this_thread::yield(); }
+            void *ptr = slot.ptr.load(std::memory_order_relaxed);
+
+            auto start = std::chrono::steady_clock::now();
+
+            switch(e.op)
+            {
+                case TraceOp::ALLOCATE:
+                    ptr = e.alignment_log2 ? allocator->allocate(e.num_bytes, size_t(1) << e.alignment_log2)
+                                           : allocator->allocate(e.num_bytes);
+                    if(!ptr){ num_failed++; }
+                    break;
+
+                case TraceOp::REALLOCATE:
+                    if(ptr)
+                    {
+                        void *new_ptr = allocator->reallocate(ptr, e.num_bytes);
+                        if(new_ptr){ ptr = new_ptr; }
+                        else{ num_failed++; }
+                    }
+                    break;
+
+                case TraceOp::FREE:
+                    allocator->free(ptr);
+                    ptr = nullptr;
+                    break;
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                 start);
+            latency.push_back(static_cast<uint32_t>(duration.count()));
+
+            slot.ptr.store(ptr, std::memory_order_relaxed);
+            slot.num_applied.store(ordinal + 1, std::memory_order_release);
+        }
+    };
+
+    replay_result_t ret = {};
+    size_t rss_before = proc_status_bytes("VmRSS:");
+    reset_peak_rss();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::thread> threads;
+        size_t t = 0;
+        for(const auto &[thread, events]: thread_events)
+        {
+            threads.emplace_back(worker, std::cref(events), std::ref(latencies[t++]));
+        }
+        for(auto &thread: threads){ thread.join(); }
+    }
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t peak_rss = proc_status_bytes("VmHWM:");
+    ret.peak_rss = peak_rss > rss_before ? peak_rss - rss_before : 0;
+
+    auto state = allocator->state();
+    ret.ops_per_sec = static_cast<double>(trace.size()) / duration;
+    ret.overhead = static_cast<double>(state.max_bytes_allocated) / static_cast<double>(peak_requested_bytes);
+    ret.fragmentation = state.fragmentation;
+    ret.num_failed = num_failed;
+
+    std::vector<uint32_t> all_latencies;
+    for(const auto &l: latencies){ all_latencies.insert(all_latencies.end(), l.begin(), l.end()); }
+
+    auto percentile = [&all_latencies](double p) -> double {
+        if(all_latencies.empty()){ return 0.; }
+        auto nth = all_latencies.begin() + static_cast<ptrdiff_t>(p * static_cast<double>(all_latencies.size() - 1));
+        std::nth_element(all_latencies.begin(), nth, all_latencies.end());
+        return *nth;
+    };
+    ret.p50_ns = percentile(0.5);
+    ret.p99_ns = percentile(0.99);
+    ret.p999_ns = percentile(0.999);
+
+    // release allocations which were never freed in the trace
+    for(uint64_t id = 0; id <= max_id; ++id){ allocator->free(slots[id].ptr.load()); }
+    return ret;
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+    // replay a recorded trace or synthesize one, optionally saving it
+    std::vector<trace_event_t> trace;
+    if(argc > 1){ trace = RecordingAllocator::load(argv[1]); }
+
+    if(trace.empty())
+    {
+        auto recorder = synthesize_trace(4, 1U << 16U);
+        trace = recorder->trace();
+
+        if(argc > 1 && recorder->save(argv[1]))
+        {
+            spdlog::info("no valid trace found, saved a synthetic trace to '{}'", argv[1]);
+        }
+    }
+    spdlog::info("replaying {} events", trace.size());
+
+    std::vector<std::pair<std::string, std::function<AllocatorPtr()>>> allocators;
+    allocators.emplace_back("malloc", [] { return std::make_shared<malloc_allocator_t>(); });
+
+    allocators.emplace_back("BuddyPool", [] {
+        BuddyPool::create_info_t fmt = {};
+        fmt.block_size = 1U << 24U;
+        fmt.min_block_size = 16;
+        return BuddyPoolPtr(BuddyPool::create(fmt));
+    });
+
+    allocators.emplace_back("BuddyPool (magazines)", [] {
+        BuddyPool::create_info_t fmt = {};
+        fmt.block_size = 1U << 24U;
+        fmt.min_block_size = 16;
+        fmt.magazine_size = 32;
+        return BuddyPoolPtr(BuddyPool::create(fmt));
+    });
+
+    allocators.emplace_back("MemoryCache", [] {
+        MemoryCache::create_info_t fmt = {};
+        fmt.min_size = 16;
+        return MemoryCache::create(fmt);
+    });
+
+    allocators.emplace_back("MemoryCache (classes)", [] {
+        MemoryCache::create_info_t fmt = {};
+        fmt.min_size = 16;
+        fmt.size_classes = true;
+        return MemoryCache::create(fmt);
+    });
+
+    allocators.emplace_back("SlabAllocator", [] {
+        SlabAllocator::create_info_t fmt = {};
+        fmt.slab_size = 1U << 20U;
+        return SlabAllocatorPtr(SlabAllocator::create(fmt));
+    });
+
+    allocators.emplace_back("TLSFPool", [] {
+        TLSFPool::create_info_t fmt = {};
+        fmt.pool_size = 1U << 24U;
+        return TLSFPoolPtr(TLSFPool::create(fmt));
+    });
+
+    spdlog::info("{:>22} | {:>9} {:>8} {:>8} {:>8} | {:>10} {:>9} {:>6} | {:>7}", "allocator", "Mops/s", "p50 ns",
+                 "p99 ns", "p99.9 ns", "peak RSS", "overhead", "frag", "failed");
+
+    for(const auto &[name, create_fn]: allocators)
+    {
+        auto r = replay(trace, create_fn());
+        spdlog::info("{:>22} | {:>9.2f} {:>8.0f} {:>8.0f} {:>8.0f} | {:>8.1f}MB {:>9.2f} {:>6.2f} | {:>7}", name,
+                     r.ops_per_sec * 1e-6, r.p50_ns, r.p99_ns, r.p999_ns, static_cast<double>(r.peak_rss) / (1U << 20U),
+                     r.overhead, r.fragmentation, r.num_failed);
+    }
+    return 0;
+}
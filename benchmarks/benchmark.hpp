@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <crocore/crocore.hpp>
+
+namespace crocore::benchmark
+{
+
+/**
+ * @brief   Measure the average duration of an operation in nanoseconds.
+ *
+ * @param   fn      function object to measure, executes num_ops operations.
+ * @param   num_ops number of operations performed by fn.
+ * @return  the average duration per operation in nanoseconds.
+ */
+template<typename Func>
+inline double measure_ns(Func &&fn, size_t num_ops)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    return duration.count() / static_cast<double>(std::max<size_t>(num_ops, 1));
+}
+
+//! prevent the compiler from optimizing away a value
+template<typename T>
+inline void do_not_optimize(const T &value)
+{
+    static volatile const void *sink = nullptr;
+    sink = &value;
+}
+
+}// namespace crocore::benchmark
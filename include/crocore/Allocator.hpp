@@ -4,6 +4,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
 #include <crocore/define_class_ptr.hpp>
 
 
@@ -30,6 +36,34 @@ public:
 
         //! total number of bytes in active (client-) allocations.
         size_t num_bytes_used = 0;
+
+        //! number of active (client-) allocations, if tracked by the allocator.
+        size_t num_live_allocations = 0;
+
+        //! high-water mark of num_bytes_used, if tracked by the allocator.
+        size_t max_bytes_used = 0;
+
+        //! high-water mark of num_bytes_allocated, if tracked by the allocator.
+        size_t max_bytes_allocated = 0;
+
+        //! external fragmentation in [0, 1]: 1 - (largest free range / free bytes), 0 if nothing is free.
+        float fragmentation = 0.f;
+    };
+
+    /**
+     * @brief   allocation_t is returned by handle-based allocations.
+     *          Next to the pointer it carries the requested size and an allocator-specific handle
+     *          (e.g. a block-index and offset), so the allocation can be freed without any lookups.
+     */
+    struct allocation_t
+    {
+        void *ptr = nullptr;
+
+        //! requested number of bytes
+        size_t num_bytes = 0;
+
+        //! allocator-specific encoding of the allocation's location, 0 if not provided
+        uint64_t handle = 0;
     };
 
     /**
@@ -40,6 +74,41 @@ public:
      */
     virtual void *allocate(size_t numBytes) = 0;
 
+    /**
+     * @brief   Allocate a contiguous block of memory with a specific alignment.
+     *
+     *          The default implementation satisfies alignments up to alignof(std::max_align_t),
+     *          which are guaranteed by all allocators, and fails for larger alignments.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    virtual void *allocate(size_t num_bytes, size_t alignment)
+    {
+        return alignment <= alignof(std::max_align_t) ? allocate(num_bytes) : nullptr;
+    }
+
+    /**
+     * @brief   Change the size of an existing allocation, preserving its contents (up to the smaller size).
+     *
+     *          Implementations should resize in place whenever possible.
+     *          Otherwise new memory is allocated, the contents are copied and the old memory is freed.
+     *          Like std::realloc, a nullptr is treated as a new allocation and a size of zero frees the memory.
+     *          The default implementation can not resize existing allocations and returns nullptr in that case.
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this allocator, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     *          the original memory-block remains valid, if the reallocation failed.
+     */
+    virtual void *reallocate(void *ptr, size_t num_bytes)
+    {
+        if(!ptr){ return allocate(num_bytes); }
+        if(!num_bytes){ free(ptr); }
+        return nullptr;
+    }
+
     /**
      * @brief   Free a block of memory, previously returned by this allocator.
      *
@@ -47,6 +116,42 @@ public:
      */
     virtual void free(void *ptr) = 0;
 
+    /**
+     * @brief   Free a block of memory with a known size, previously returned by allocate(num_bytes).
+     *
+     *          Allocators can use the size to skip looking up the allocation.
+     *          The default implementation ignores the size.
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this allocator.
+     * @param   num_bytes   the number of bytes, requested when allocating ptr.
+     */
+    virtual void free(void *ptr, size_t num_bytes)
+    {
+        (void) num_bytes;
+        free(ptr);
+    }
+
+    /**
+     * @brief   Allocate a contiguous block of memory, returning an allocation-handle.
+     *
+     *          The default implementation provides no handle, allocators can encode internal locations,
+     *          e.g. a block-index and offset.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @return  an allocation_t, ptr is nullptr if the allocation failed.
+     */
+    virtual allocation_t allocate_handle(size_t num_bytes) { return {allocate(num_bytes), num_bytes, 0}; }
+
+    /**
+     * @brief   Free an allocation, previously returned by allocate_handle().
+     *
+     * @param   allocation  an allocation_t, returned by allocate_handle().
+     */
+    virtual void free(const allocation_t &allocation)
+    {
+        if(allocation.ptr){ free(allocation.ptr, allocation.num_bytes); }
+    }
+
     /**
      * @brief   Shrinks the internally allocated memory to a minimum, without affecting existing allocations.
      */
@@ -58,6 +163,82 @@ public:
     [[nodiscard]] virtual Allocator::state_t state() const = 0;
 };
 
+/**
+ * @brief   allocation_counters_t groups atomic running counters,
+ *          allowing allocators to report their state in O(1), without traversing internal structures.
+ */
+struct allocation_counters_t
+{
+    std::atomic<size_t> num_allocations = 0;
+    std::atomic<size_t> num_bytes_allocated = 0;
+    std::atomic<size_t> num_bytes_used = 0;
+    std::atomic<size_t> num_live_allocations = 0;
+    std::atomic<size_t> max_bytes_used = 0;
+    std::atomic<size_t> max_bytes_allocated = 0;
+
+    //! count an internal allocation (e.g. a block or chunk)
+    void add_internal(size_t num_bytes)
+    {
+        num_allocations.fetch_add(1, std::memory_order_relaxed);
+        update_max(max_bytes_allocated, num_bytes_allocated.fetch_add(num_bytes, std::memory_order_relaxed) + num_bytes);
+    }
+
+    //! count an internal de-allocation
+    void remove_internal(size_t num_bytes)
+    {
+        num_allocations.fetch_sub(1, std::memory_order_relaxed);
+        num_bytes_allocated.fetch_sub(num_bytes, std::memory_order_relaxed);
+    }
+
+    //! count a client-allocation
+    void add_used(size_t num_bytes)
+    {
+        num_live_allocations.fetch_add(1, std::memory_order_relaxed);
+        update_max(max_bytes_used, num_bytes_used.fetch_add(num_bytes, std::memory_order_relaxed) + num_bytes);
+    }
+
+    //! count a client-deallocation
+    void remove_used(size_t num_bytes)
+    {
+        num_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        num_bytes_used.fetch_sub(num_bytes, std::memory_order_relaxed);
+    }
+
+    //! count a resized client-allocation
+    void resize_used(size_t num_bytes, size_t new_num_bytes)
+    {
+        update_max(max_bytes_used,
+                   num_bytes_used.fetch_add(new_num_bytes - num_bytes, std::memory_order_relaxed) + new_num_bytes -
+                   num_bytes);
+    }
+
+    //! returns a snapshot of all counters, fragmentation is left to the allocator.
+    [[nodiscard]] Allocator::state_t state() const
+    {
+        Allocator::state_t ret = {};
+        ret.num_allocations = num_allocations.load(std::memory_order_relaxed);
+        ret.num_bytes_allocated = num_bytes_allocated.load(std::memory_order_relaxed);
+        ret.num_bytes_used = num_bytes_used.load(std::memory_order_relaxed);
+        ret.num_live_allocations = num_live_allocations.load(std::memory_order_relaxed);
+        ret.max_bytes_used = max_bytes_used.load(std::memory_order_relaxed);
+        ret.max_bytes_allocated = max_bytes_allocated.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    //! raise a high-water mark
+    static void update_max(std::atomic<size_t> &max_value, size_t value)
+    {
+        size_t current = max_value.load(std::memory_order_relaxed);
+        while(value > current && !max_value.compare_exchange_weak(current, value, std::memory_order_relaxed)){}
+    }
+};
+
+//! returns the external fragmentation for a total number of free bytes and the largest free range.
+inline float fragmentation(size_t num_free_bytes, size_t max_free_range)
+{
+    return num_free_bytes ? 1.f - static_cast<float>(max_free_range) / static_cast<float>(num_free_bytes) : 0.f;
+}
+
 template<class T>
 struct stl_allocator
 {
@@ -72,16 +253,86 @@ struct stl_allocator
     [[nodiscard]] T *allocate(std::size_t n)
     {
         if(n > std::numeric_limits<std::size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
-        T *ptr = allocator ? static_cast<T *>(allocator->allocate(n * sizeof(T))) : nullptr;
+        T *ptr = nullptr;
+
+        if(allocator)
+        {
+            // forward alignment of over-aligned types
+            if constexpr(alignof(T) > alignof(std::max_align_t))
+            {
+                ptr = static_cast<T *>(allocator->allocate(n * sizeof(T), alignof(T)));
+            }
+            else{ ptr = static_cast<T *>(allocator->allocate(n * sizeof(T))); }
+        }
         if(ptr) { return ptr; }
         throw std::bad_alloc();
     }
 
-    void deallocate(T *p, std::size_t) noexcept { allocator->free(p); }
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        // sized free for allocations without extended alignment
+        if constexpr(alignof(T) > alignof(std::max_align_t)){ allocator->free(p); }
+        else{ allocator->free(p, n * sizeof(T)); }
+    }
 
     AllocatorPtr allocator;
 };
 
+/**
+ * @brief   pmr_resource adapts a crocore::Allocator to std::pmr::memory_resource.
+ *
+ *          Containers using std::pmr::polymorphic_allocator only store a plain pointer to the resource,
+ *          so copies and rebinds do not touch any reference-count.
+ *          Instantiated with a concrete (final) allocator-type, calls into the allocator are de-virtualized.
+ *          The wrapped allocator is not owned and must outlive the resource.
+ *
+ *          example-usage:
+ *
+ *          ```````````````````````````````````````````````````````````
+ *          crocore::pmr_resource<crocore::BuddyPool> resource(pool.get());
+ *          std::pmr::vector<int> vec(&resource);
+ *          ```````````````````````````````````````````````````````````
+ */
+template<class T = Allocator>
+class pmr_resource : public std::pmr::memory_resource
+{
+public:
+    explicit pmr_resource(T *allocator = nullptr) noexcept : m_allocator(allocator) {}
+
+    [[nodiscard]] T *allocator() const noexcept { return m_allocator; }
+
+private:
+    void *do_allocate(std::size_t num_bytes, std::size_t alignment) override
+    {
+        void *ptr = nullptr;
+
+        if(m_allocator)
+        {
+            num_bytes = num_bytes ? num_bytes : 1;
+            ptr = alignment > alignof(std::max_align_t) ? m_allocator->allocate(num_bytes, alignment)
+                                                         : m_allocator->allocate(num_bytes);
+        }
+        if(ptr) { return ptr; }
+        throw std::bad_alloc();
+    }
+
+    void do_deallocate(void *ptr, std::size_t num_bytes, std::size_t alignment) override
+    {
+        // sized free for allocations without extended alignment
+        if(alignment > alignof(std::max_align_t)){ m_allocator->free(ptr); }
+        else{ m_allocator->free(ptr, num_bytes ? num_bytes : 1); }
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        if(this == &other) { return true; }
+        auto *other_resource = dynamic_cast<const pmr_resource *>(&other);
+        return other_resource && m_allocator && other_resource->m_allocator == m_allocator;
+    }
+
+    T *m_allocator;
+};
+
 }// namespace crocore
 
 /**
@@ -107,3 +358,19 @@ inline void *operator new(size_t num_bytes, const crocore::AllocatorPtr &allocat
  *          Purpose is solely exception-safe usage of above operator-new.
  */
 inline void operator delete(void *ptr, const crocore::AllocatorPtr &allocator) { allocator->free(ptr); }
+
+/**
+ * @brief   Overload for performing a "placement-new" with over-aligned types.
+ */
+inline void *operator new(size_t num_bytes, std::align_val_t alignment, const crocore::AllocatorPtr &allocator)
+{
+    return allocator->allocate(num_bytes, static_cast<size_t>(alignment));
+}
+
+/**
+ * @brief   Used only implicitly in combination with above aligned placement-new.
+ */
+inline void operator delete(void *ptr, std::align_val_t, const crocore::AllocatorPtr &allocator)
+{
+    allocator->free(ptr);
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <unordered_map>
 #include <chrono>
 
+#include <crocore/MonotonicArena.hpp>
 #include <crocore/ThreadPoolClassic.hpp>
 #include <crocore/precise_sleep.hpp>
 
@@ -21,6 +23,9 @@ public:
         float target_loop_frequency = 0.f;
         std::vector<std::string> arguments;
         uint32_t num_background_threads = std::max(1U, std::thread::hardware_concurrency());
+
+        //! chunk-size in bytes for per-frame arenas
+        size_t frame_arena_chunk_size = 1U << 20U;
     };
 
     std::atomic<bool> running = false;
@@ -65,6 +70,13 @@ public:
 
     [[nodiscard]] const crocore::ThreadPoolClassic &background_queue() const{ return m_background_queue; }
 
+    /*!
+    * arena for temporary per-frame allocations, intended for use by the main thread.
+    * arenas are double-buffered and reset after update(),
+    * so allocations remain valid during the current and the next loop-iteration.
+    */
+    [[nodiscard]] const crocore::MonotonicArenaPtr &frame_arena() const{ return m_frame_arenas[m_frame_index]; }
+
 private:
 
     // you are supposed to implement these in a subclass
@@ -92,6 +104,9 @@ private:
     crocore::ThreadPoolClassic m_main_queue, m_background_queue;
 
     crocore::precise_sleep m_precise_sleep;
+
+    std::array<crocore::MonotonicArenaPtr, 2> m_frame_arenas;
+    uint32_t m_frame_index = 0;
 };
 
 }
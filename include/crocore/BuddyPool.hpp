@@ -1,12 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <map>
 #include <mutex>
 #include <shared_mutex>
 #include <functional>
+#include <limits>
+#include <vector>
 
 #include "crocore/Allocator.hpp"
+#include "crocore/utils.hpp"
 
 namespace crocore
 {
@@ -17,13 +22,34 @@ DEFINE_CLASS_PTR(BuddyPool)
 /**
  * @brief   BuddyPool can be used to manage blocks of arbitrary memory using Buddy-allocations.
  *
+ *          Optionally a layer of per-thread magazines can be enabled (create_info_t::magazine_size),
+ *          caching recently freed blocks per size-order. Magazines are refilled from and flushed to
+ *          the shared toplevel-blocks in batches, so concurrent allocations rarely contend for the pool's mutex.
+ *
+ *          With create_info_t::block_locks, each toplevel block is guarded by its own lock. Allocations and frees
+ *          hold the pool's mutex only shared, threads start searching at different blocks and skip busy ones.
+ *          Only adding or removing toplevel blocks requires exclusive access.
+ *
+ *          Toplevel blocks can be backed by (huge-)page mappings, using crocore::virtual_memory::alloc_fn()
+ *          and crocore::virtual_memory::unmap(). Large free ranges inside long-lived blocks can be returned
+ *          to the OS (create_info_t::release_min_bytes).
+ *
+ *          Without alloc_fn/dealloc_fn the pool operates in offset-only mode: no backing memory is allocated,
+ *          ranges are sub-allocated via allocate_range() and addressed by block-index and offset.
+ *          This allows managing memory that cannot be addressed directly, e.g. memory-mapped files,
+ *          shared-memory segments or ranges inside a single staging-buffer.
+ *
  * @see     https://en.wikipedia.org/wiki/Buddy_memory_allocation
+ * @see     https://www.usenix.org/legacy/event/usenix01/full_papers/bonwick/bonwick.pdf
  *
  */
 class BuddyPool final : public crocore::Allocator
 {
 public:
 
+    //! alignment of toplevel blocks, when using the default alloc_fn
+    static constexpr size_t s_block_alignment = 4096;
+
     //! helper struct to group necessary information to create a BuddyPool.
     struct create_info_t
     {
@@ -42,11 +68,78 @@ public:
         //! enable automatic deallocation of unused blocks
         bool dealloc_unused_blocks = true;
 
-        //! function object to perform allocations with
-        std::function<void *(size_t)> alloc_fn = ::malloc;
+        //! number of cached blocks per size-order in thread-local magazines (default 0: disabled)
+        size_t magazine_size = 0;
+
+        //! use per-level free-bitmaps instead of a node-state tree, faster for deep trees
+        bool bitmap_tree = false;
+
+        //! lock toplevel blocks individually, instead of the whole pool.
+        //! blocks are searched first-fit, starting at a per-thread block, instead of best-fit.
+        bool block_locks = false;
+
+        //! free ranges of at least this size are returned to the OS, keeping their addresses (default 0: disabled).
+        //! only applies to blocks mapped by virtual_memory::alloc_fn(), other blocks are kept as they are.
+        size_t release_min_bytes = 0;
+
+        //! function object to perform allocations with, defaults to page-aligned allocations.
+        //! if alloc_fn or dealloc_fn are empty, the pool operates in offset-only mode.
+        std::function<void *(size_t)> alloc_fn = [](size_t num_bytes) {
+            return crocore::aligned_alloc(num_bytes, s_block_alignment);
+        };
 
         //! function object to perform de-allocations with
-        std::function<void(void *)> dealloc_fn = ::free;
+        std::function<void(void *)> dealloc_fn = crocore::aligned_free;
+    };
+
+    //! invalid block-index, returned by allocate_range() on failure
+    static constexpr uint32_t s_invalid_block = std::numeric_limits<uint32_t>::max();
+
+    //! a range within a toplevel block, returned by allocate_range()
+    struct range_t
+    {
+        //! stable index of the toplevel block, s_invalid_block if the allocation failed
+        uint32_t block = s_invalid_block;
+
+        //! offset in bytes, relative to the start of the toplevel block
+        size_t offset = 0;
+
+        //! size in bytes, rounded to the next power of two
+        size_t size = 0;
+
+        explicit operator bool() const { return block != s_invalid_block; }
+    };
+
+    //! describes a single move during defragment()
+    struct relocation_t
+    {
+        //! current and new location of an allocation
+        range_t src, dst;
+
+        //! addresses of src and dst, nullptr in offset-only mode
+        void *src_ptr = nullptr, *dst_ptr = nullptr;
+    };
+
+    /**
+     * @brief   relocation callback, responsible for copying the content and updating all references.
+     *          returns false, if an allocation cannot be moved (pinned).
+     */
+    using relocate_fn_t = std::function<bool(const relocation_t &)>;
+
+    //! summary of a defragment() call
+    struct defrag_result_t
+    {
+        //! number of moved allocations
+        size_t num_moves = 0;
+
+        //! number of moved bytes
+        size_t num_bytes_moved = 0;
+
+        //! number of released toplevel blocks
+        size_t num_blocks_released = 0;
+
+        //! true, if a full pass over all sparse blocks was completed
+        bool done = false;
     };
 
     //! helper struct to group relevant information about a BuddyPool's state.
@@ -77,6 +170,7 @@ public:
 
     /**
      * @brief   Allocate memory from the pool.
+     *          Returns nullptr in offset-only mode, use allocate_range() instead.
      *          The amount of memory allocated will be rounded to the next power of two.
      *
      *          This call will return a nullptr if:
@@ -88,6 +182,32 @@ public:
      */
     void *allocate(size_t num_bytes) override;
 
+    /**
+     * @brief   Allocate memory from the pool with a specific alignment.
+     *
+     *          Allocations are naturally aligned to their size (rounded to the next power of two),
+     *          relative to the start of their toplevel block. Alignments up to the alignment of toplevel blocks
+     *          (default: s_block_alignment) are therefore satisfied without any overhead.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    /**
+     * @brief   Change the size of an existing allocation.
+     *
+     *          Allocations grow in place, if all required buddies are free (merging upward),
+     *          and shrink in place by splitting off the unused halves.
+     *          Otherwise the allocation is moved to a new location.
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this pool, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     */
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
     /**
      * @brief   Free a block of memory, previously returned by this pool.
      *
@@ -95,21 +215,104 @@ public:
      */
     void free(void *ptr) override;
 
+    /**
+     * @brief   Free a block of memory with a known size, previously returned by allocate(num_bytes).
+     *          The size-order is derived from num_bytes, skipping the tree-descent.
+     *          With magazines enabled, no lookups are required at all.
+     *
+     *          Passing a num_bytes that does not match the allocation is undefined behaviour
+     *          (validated in debug-builds only).
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this pool.
+     * @param   num_bytes   the number of bytes, requested when allocating ptr.
+     */
+    void free(void *ptr, size_t num_bytes) override;
+
+    /**
+     * @brief   Allocate memory from the pool, returning an allocation-handle.
+     *          The handle encodes the toplevel block's index and the offset within the block.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @return  an allocation_t, ptr is nullptr if the allocation failed.
+     */
+    Allocator::allocation_t allocate_handle(size_t num_bytes) override;
+
+    /**
+     * @brief   Free an allocation, previously returned by allocate_handle().
+     *          Block and offset are decoded from the handle, so neither block-search nor tree-descent are required.
+     *
+     * @param   allocation  an allocation_t, returned by allocate_handle().
+     */
+    void free(const allocation_t &allocation) override;
+
+    /**
+     * @brief   Allocate a range from the pool, without touching any memory.
+     *          Ranges are naturally aligned to their size, relative to the start of their toplevel block.
+     *          Magazines are bypassed.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment of the offset in bytes, must be a power of two.
+     * @return  a range_t, evaluating to false if the allocation failed.
+     */
+    range_t allocate_range(size_t num_bytes, size_t alignment = 1);
+
+    /**
+     * @brief   Free a range, previously returned by allocate_range().
+     *          Block and size-order are known, so no block-search is required.
+     *          Ranges not matching an allocation (offset and size) are ignored.
+     *
+     * @param   range   a range_t, returned by allocate_range().
+     */
+    void free_range(const range_t &range);
+
+    /**
+     * @brief   Incrementally defragment the pool, moving allocations out of sparse toplevel blocks.
+     *
+     *          Blocks using less than max_block_usage are evacuated, sparsest first. Their allocations are moved
+     *          into other blocks via relocate_fn and emptied blocks above create_info_t::min_num_blocks are released.
+     *          Work stops once time_budget is exceeded (at least one move is attempted) and resumes with the next call,
+     *          so a slice can run each frame. Magazines are flushed beforehand and stay locked during the call,
+     *          concurrent allocations and frees using magazines block until it returns.
+     *
+     *          relocate_fn is called while the pool is locked and must not call into the pool.
+     *          Moved allocations must be freed using their new pointer or range.
+     *
+     * @param   relocate_fn         callback performing the actual moves.
+     * @param   time_budget         time to spend in this call.
+     * @param   max_block_usage     blocks with a lower fraction of used bytes are evacuated.
+     * @return  a defrag_result_t, summarizing this call.
+     */
+    defrag_result_t defragment(const relocate_fn_t &relocate_fn, std::chrono::nanoseconds time_budget,
+                               float max_block_usage = 0.3f);
+
+    /**
+     * @brief   Return the backing memory of a toplevel block.
+     *
+     * @param   block   a block-index, as returned in range_t::block.
+     * @return  the start-address of the toplevel block,
+     *          or nullptr in offset-only mode or if no such block exists.
+     */
+    [[nodiscard]] void *block_data(uint32_t block) const;
+
     /**
      * @brief   Shrinks the internally allocated memory to a minimum, without affecting existing allocations.
-     *          In case of a BuddyPool, unused toplevel-blocks above create_info_t::min_num_blocks will be de-allocated.
+     *          In case of a BuddyPool, all magazines are flushed and
+     *          unused toplevel-blocks above create_info_t::min_num_blocks will be de-allocated.
      *
      */
     void shrink() override;
 
 
     /**
-     * @brief   Return a summary of the allocator's internal state.
+     * @brief   Return a summary of the allocator's internal state in O(1), based on running counters.
+     *          num_bytes_used and its high-water mark refer to allocation-sizes, rounded to a power of two.
+     *          With create_info_t::block_locks, deriving the fragmentation is linear in the number of blocks.
      */
     [[nodiscard]] Allocator::state_t state() const override;
 
     /**
-     * @brief   Query the current state of the pool.
+     * @brief   Query the current state of the pool. This is a slow path, traversing all block-trees.
+     *          Blocks cached in magazines are reported as allocations.
      *
      * @return  a state_t object, grouping relevant state information.
      */
@@ -121,10 +324,120 @@ private:
 
     struct block_t create_block() const;
 
+    //! allocate a node from toplevel blocks, requires a unique lock on m_mutex.
+    //! returns the containing block and the offset (unit is a sub-block of min_block_size) or nullptr.
+    struct block_t *allocate_node(size_t size, bool create_blocks, size_t &index_offset);
+
+    //! allocate from toplevel blocks, requires a unique lock on m_mutex. optionally returns an allocation-handle.
+    void *allocate_locked(size_t size, bool create_blocks, uint64_t *handle = nullptr);
+
+    //! first-fit search for a node, starting at the calling thread's block.
+    //! requires a lock on m_mutex, locks the blocks if create_info_t::block_locks is enabled.
+    struct block_t *search_node(size_t size, size_t &index_offset);
+
+    //! allocate a node, holding m_mutex shared if create_info_t::block_locks is enabled, unique otherwise.
+    //! returns the node's range and optionally its address and an allocation-handle.
+    range_t allocate_shared(size_t size, void **ptr = nullptr, uint64_t *handle = nullptr);
+
+    //! free an allocation within a block, requires a lock on m_mutex and on the block, if it has one.
+    //! returns the number of freed bytes (0 if no allocation starts at index_offset),
+    //! remove is set if the block should be removed afterward.
+    size_t free_node(struct block_t &b, size_t index_offset, size_t order, bool &remove);
+
+    //! free an allocation, holding m_mutex shared if create_info_t::block_locks is enabled, unique otherwise.
+    //! find_fn resolves the block and offset of the allocation. returns the number of freed bytes.
+    //! with validate set, nothing is freed unless an allocation of exactly this size-order starts at the offset.
+    template<typename Fn>
+    size_t free_shared(Fn &&find_fn, size_t order, bool validate = false);
+
+    //! free a block of memory, requires a unique lock on m_mutex. returns the number of freed bytes.
+    size_t free_locked(void *ptr);
+
+    //! free an allocation at an offset (and size-order, if known) within a block, requires a unique lock on m_mutex.
+    size_t free_locked(struct block_t &b, size_t index_offset, size_t order);
+
+    //! allocate from the calling thread's magazine
+    void *allocate_cached(size_t size);
+
+    //! return all blocks cached in a magazine to their toplevel blocks,
+    //! requires a lock on the magazine and a unique lock on m_mutex.
+    void flush_magazine(struct magazine_t &magazine);
+
+    //! return all blocks cached in magazines to their toplevel blocks
+    void flush_magazines();
+
+    //! lookup the size-order of an allocation, tree::INDEX_MAX if not found. holds m_mutex shared.
+    size_t find_order(const void *ptr) const;
+
+    //! free into the calling thread's magazine
+    void free_cached(void *ptr);
+
+    //! free into the calling thread's magazine, with known size-order.
+    //! if validate is set, pointers already cached in the magazine are ignored (double free).
+    void free_cached(void *ptr, size_t order, bool validate);
+
+    //! add a new toplevel block, update indices
+    struct block_t &add_block(struct block_t &&b);
+
+    //! remove a toplevel block, update indices
+    void remove_block(struct block_t &b);
+
+    //! find the toplevel block containing an address or nullptr, if not found
+    struct block_t *find_block(const void *ptr) const;
+
+    //! find the toplevel block of an allocation and its offset, or nullptr if not found or misaligned
+    struct block_t *find_block(const void *ptr, size_t &index_offset) const;
+
+    //! move a block to the index-bucket matching its largest free size-order,
+    //! or publish its free size-orders, if create_info_t::block_locks is enabled
+    void index_update(struct block_t &b);
+
+    //! remove a block from the free-index
+    void index_remove(struct block_t &b);
+
     create_info_t m_format;
 
+    //! no backing memory is allocated, only ranges can be allocated
+    bool m_offset_only = false;
+
     std::list<struct block_t> m_toplevel_blocks;
 
+    //! toplevel blocks sorted by start-address, used for binary searches
+    std::vector<std::pair<const uint8_t *, std::list<struct block_t>::iterator>> m_address_index;
+
+    //! toplevel blocks indexed by their slot, nullptr for unused slots
+    std::vector<struct block_t *> m_block_slots;
+
+    //! unused slots
+    std::vector<uint32_t> m_free_slots;
+
+    //! maps size-orders to toplevel blocks, whose largest free node is of exactly that order
+    std::vector<std::vector<struct block_t *>> m_free_index;
+
+    //! bit k is set, if m_free_index[k] is not empty
+    uint64_t m_free_index_mask = 0;
+
+    //! optional per-thread magazines
+    std::unique_ptr<struct magazine_t[]> m_magazines;
+
+    //! number of magazines (pow2)
+    uint32_t m_num_magazines = 0;
+
+    //! total number of bytes currently cached in magazines
+    std::atomic<size_t> m_num_cached_bytes = 0;
+
+    //! slot of the block currently evacuated by defragment(), s_invalid_block if none
+    uint32_t m_defrag_slot = s_invalid_block;
+
+    //! leaf-offset to resume defragmentation at
+    size_t m_defrag_offset = 0;
+
+    //! slots of blocks already evacuated during the current defragmentation-pass
+    std::vector<uint32_t> m_defrag_visited;
+
+    //! running counters for toplevel blocks and client-allocations
+    allocation_counters_t m_counters;
+
     mutable std::shared_mutex m_mutex;
 };
 
@@ -8,11 +8,21 @@
 
 #pragma once
 
+#include <memory>
+#include <span>
+#include <type_traits>
+
 #include "crocore/crocore.hpp"
 
 namespace crocore
 {
 
+/**
+ * @brief   CircularBuffer is a fixed-capacity ring-buffer. Pushing into a full buffer drops the oldest element.
+ *
+ *          Indices wrap around by a conditional subtraction, no divisions are involved.
+ *          Bulk operations copy up to two contiguous regions at once, using memcpy for trivially copyable types.
+ */
 template<typename T, typename Allocator = std::allocator<T>>
 class CircularBuffer
 {
@@ -31,13 +41,20 @@ public:
         : m_stl_allocator(other.m_stl_allocator), m_array_size(other.m_array_size), m_first(other.m_first),
           m_last(other.m_last), m_data(m_stl_allocator.allocate(m_array_size))
     {
-        memcpy(m_data, other.m_data, m_array_size * sizeof(T));
+        // elements keep their positions
+        auto [first, second] = other.as_spans();
+        copy_construct(first.data(), first.size(), m_data + m_first);
+        copy_construct(second.data(), second.size(), m_data);
     }
 
     // move constructor
     CircularBuffer(CircularBuffer &&other) noexcept : CircularBuffer() { swap(*this, other); }
 
-    ~CircularBuffer() { m_stl_allocator.deallocate(m_data, m_array_size); }
+    ~CircularBuffer()
+    {
+        clear();
+        if(m_data){ m_stl_allocator.deallocate(m_data, m_array_size); }
+    }
 
     CircularBuffer &operator=(CircularBuffer other)
     {
@@ -45,7 +62,11 @@ public:
         return *this;
     }
 
-    inline void clear() { m_first = m_last = 0; }
+    inline void clear()
+    {
+        pop_front(size());
+        m_first = m_last = 0;
+    }
 
     template<class InputIt>
     void assign(InputIt first, InputIt last)
@@ -56,35 +77,116 @@ public:
 
     inline void push_back(const T &the_val)
     {
-        m_data[m_last] = the_val;
-        m_last = (m_last + 1) % m_array_size;
+        if(!capacity()) { return; }
+        size_t next = wrap(m_last + 1);
+
+        // slot at m_last is always free, construct first, the_val might refer to the oldest value
+        std::allocator_traits<Allocator>::construct(m_stl_allocator, m_data + m_last, the_val);
 
         // buffer is full, drop oldest value
-        if(m_first == m_last) { m_first = (m_first + 1) % m_array_size; }
+        if(next == m_first) { pop_front(); }
+        m_last = next;
+    }
+
+    /**
+     * @brief   Append a range of values. If the buffer overflows, the oldest values are dropped,
+     *          only the last capacity() values are kept.
+     *
+     * @param   values  a contiguous range of values.
+     */
+    inline void push_back(std::span<const T> values)
+    {
+        if(!capacity()) { return; }
+        if(values.size() > capacity()) { values = values.last(capacity()); }
+
+        // make room, drop oldest values
+        size_t num_free = capacity() - size();
+        if(values.size() > num_free) { pop_front(values.size() - num_free); }
+
+        // copy up to two contiguous regions
+        size_t num_tail = std::min(values.size(), m_array_size - m_last);
+        copy_construct(values.data(), num_tail, m_data + m_last);
+        copy_construct(values.data() + num_tail, values.size() - num_tail, m_data);
+        m_last = wrap(m_last + values.size());
     }
 
     inline void pop_front()
     {
-        if(!empty()) { m_first = (m_first + 1) % m_array_size; }
+        if(!empty())
+        {
+            std::allocator_traits<Allocator>::destroy(m_stl_allocator, m_data + m_first);
+            m_first = wrap(m_first + 1);
+        }
+    }
+
+    /**
+     * @brief   Remove up to n values from the front.
+     *
+     * @param   n   number of values to remove.
+     */
+    inline void pop_front(size_t n)
+    {
+        n = std::min(n, size());
+
+        if constexpr(!std::is_trivially_destructible_v<T>)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                std::allocator_traits<Allocator>::destroy(m_stl_allocator, m_data + wrap(m_first + i));
+            }
+        }
+        m_first = wrap(m_first + n);
+    }
+
+    /**
+     * @brief   Copy values from the front into a range, without removing them.
+     *
+     * @param   out a contiguous range to copy values into.
+     * @return  the number of copied values, min(out.size(), size()).
+     */
+    inline size_t read(std::span<T> out) const
+    {
+        auto [first, second] = as_spans();
+        size_t num_first = std::min(out.size(), first.size());
+        size_t num_second = std::min(out.size() - num_first, second.size());
+        copy_assign(first.data(), num_first, out.data());
+        copy_assign(second.data(), num_second, out.data() + num_first);
+        return num_first + num_second;
+    }
+
+    /**
+     * @brief   Access the stored values as two contiguous regions, in order.
+     *          The second region is empty, unless the values wrap around the end of the storage.
+     *
+     * @return  a pair of spans, covering all values.
+     */
+    inline std::pair<std::span<T>, std::span<T>> as_spans()
+    {
+        if(m_first <= m_last) { return {{m_data + m_first, m_last - m_first}, {}}; }
+        return {{m_data + m_first, m_array_size - m_first}, {m_data, m_last}};
+    }
+
+    inline std::pair<std::span<const T>, std::span<const T>> as_spans() const
+    {
+        if(m_first <= m_last) { return {{m_data + m_first, m_last - m_first}, {}}; }
+        return {{m_data + m_first, m_array_size - m_first}, {m_data, m_last}};
     }
 
     inline T &front() { return m_data[m_first]; }
 
-    inline T &back() { return m_data[(m_last - 1) % m_array_size]; }
+    inline T &back() { return m_data[m_last ? m_last - 1 : m_array_size - 1]; }
 
     inline const T &front() const { return m_data[m_first]; }
 
-    inline const T &back() const { return m_data[(m_last - 1) % m_array_size]; }
+    inline const T &back() const { return m_data[m_last ? m_last - 1 : m_array_size - 1]; }
 
-    [[nodiscard]] inline size_t capacity() const { return std::max<size_t>(0, m_array_size - 1); };
+    [[nodiscard]] inline size_t capacity() const { return m_array_size ? m_array_size - 1 : 0; };
 
     inline void set_capacity(uint32_t the_cap) { *this = CircularBuffer(the_cap); }
 
     [[nodiscard]] inline size_t size() const
     {
-        int64_t ret = m_last - m_first;
-        if(ret < 0) { ret += m_array_size; }
-        return static_cast<size_t>(ret);
+        return m_last >= m_first ? m_last - m_first : m_last + m_array_size - m_first;
     };
 
     [[nodiscard]] inline bool empty() const { return m_first == m_last; }
@@ -92,13 +194,13 @@ public:
     inline T &operator[](uint32_t the_index)
     {
         if(the_index >= size()) { throw std::runtime_error("CircularBuffer: index out of bounds"); }
-        return m_data[(m_first + the_index) % m_array_size];
+        return m_data[wrap(m_first + the_index)];
     };
 
     inline const T &operator[](uint32_t the_index) const
     {
         if(the_index >= size()) { throw std::runtime_error("CircularBuffer: index out of bounds"); }
-        return m_data[(m_first + the_index) % m_array_size];
+        return m_data[wrap(m_first + the_index)];
     };
 
     class iterator
@@ -199,6 +301,39 @@ public:
     }
 
 private:
+
+    //! wrap an index in range [0, 2 * m_array_size) into the storage
+    [[nodiscard]] inline size_t wrap(size_t index) const
+    {
+        return index >= m_array_size ? index - m_array_size : index;
+    }
+
+    //! construct copies of n values in uninitialized storage
+    inline void copy_construct(const T *src, size_t n, T *dst)
+    {
+        if constexpr(std::is_trivially_copyable_v<T>)
+        {
+            if(n) { memcpy(dst, src, n * sizeof(T)); }
+        }
+        else
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                std::allocator_traits<Allocator>::construct(m_stl_allocator, dst + i, src[i]);
+            }
+        }
+    }
+
+    //! copy n values into existing objects
+    static inline void copy_assign(const T *src, size_t n, T *dst)
+    {
+        if constexpr(std::is_trivially_copyable_v<T>)
+        {
+            if(n) { memcpy(dst, src, n * sizeof(T)); }
+        }
+        else { std::copy_n(src, n, dst); }
+    }
+
     Allocator m_stl_allocator;
     size_t m_array_size = 0, m_first = 0, m_last = 0;
     T *m_data = nullptr;
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <crocore/define_class_ptr.hpp>
+#include <crocore/utils.hpp>
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for an EpochReclaimer
+DEFINE_CLASS_PTR(EpochReclaimer)
+
+/**
+ * @brief   EpochReclaimer implements epoch-based memory reclamation (EBR).
+ *
+ *          Lock-free and read-mostly structures cannot free a node directly after unlinking it,
+ *          because concurrent readers might still hold a reference to it.
+ *          Threads register as participants and enclose their accesses in short critical sections (pin).
+ *          Unlinked nodes are retired instead of freed and will be reclaimed in batches,
+ *          once every pinned participant has observed a newer global epoch.
+ *
+ *          Entering a critical section announces the observed global epoch using a seq_cst exchange
+ *          on the participant's own cache-line, followed by a re-load of the global epoch.
+ *          The exchange acts as a full barrier (e.g. a locked instruction on x86), so protected loads cannot
+ *          be reordered before the announcement. It dominates the cost of pin(), typically a few tens of cycles.
+ *          If the epoch advanced meanwhile, the announcement is repeated. Nested pins are free.
+ *
+ *          example-usage:
+ *
+ *          ```````````````````````````````````
+ *          auto participant = reclaimer->register_thread();
+ *          {
+ *              auto guard = participant.pin();
+ *              node_t *node = head.load();
+ *              ...
+ *          }
+ *          participant.retire(unlinked_node);
+ *          ```````````````````````````````````
+ *
+ * @see     https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf
+ */
+class EpochReclaimer
+{
+public:
+    //! function-pointer type used to reclaim retired objects
+    using deleter_fn_t = void (*)(void *ptr, void *user_data);
+
+    //! helper struct to group necessary information to create an EpochReclaimer.
+    struct create_info_t
+    {
+        //! maximum number of concurrently registered threads
+        uint32_t max_num_threads = 64;
+
+        //! number of retired objects per thread, before an attempt is made to advance the epoch and reclaim.
+        uint32_t batch_size = 64;
+    };
+
+    class participant_t;
+
+    /**
+     * @brief   guard_t is a RAII-object representing a critical section.
+     *          Objects observed while a guard is alive will not be reclaimed.
+     */
+    class guard_t
+    {
+    public:
+        guard_t(const guard_t &) = delete;
+
+        guard_t(guard_t &&other) noexcept : m_participant(other.m_participant) { other.m_participant = nullptr; }
+
+        ~guard_t();
+
+        guard_t &operator=(const guard_t &) = delete;
+
+    private:
+        friend class participant_t;
+
+        explicit guard_t(participant_t *participant) : m_participant(participant) {}
+
+        participant_t *m_participant = nullptr;
+    };
+
+    /**
+     * @brief   participant_t is a per-thread handle, obtained by EpochReclaimer::register_thread().
+     *          A participant must only be used by one thread at a time.
+     */
+    class participant_t
+    {
+    public:
+        participant_t() = default;
+
+        participant_t(participant_t &&other) noexcept;
+
+        participant_t(const participant_t &) = delete;
+
+        ~participant_t();
+
+        participant_t &operator=(participant_t other);
+
+        /**
+         * @brief   Enter a critical section. Critical sections can be nested.
+         *
+         * @return  a guard_t object, leaving the critical section upon destruction.
+         */
+        [[nodiscard]] guard_t pin();
+
+        /**
+         * @brief   Retire an object, which is no longer reachable for new readers.
+         *          The object will be reclaimed, once no reader can hold a reference to it anymore.
+         *
+         * @param   ptr         pointer to an object, that should be reclaimed.
+         * @param   deleter     function-pointer used to reclaim the object.
+         * @param   user_data   optional user-data, passed to the deleter.
+         */
+        void retire(void *ptr, deleter_fn_t deleter, void *user_data = nullptr);
+
+        /**
+         * @brief   Retire an object, allocated with new. It will be reclaimed using delete.
+         *
+         * @param   object  pointer to an object, that should be reclaimed.
+         */
+        template<typename T>
+        inline void retire(T *object)
+        {
+            retire(object, [](void *ptr, void *) { delete static_cast<T *>(ptr); });
+        }
+
+        /**
+         * @brief   Attempt to advance the global epoch and reclaim all eligible objects retired by this participant.
+         *
+         * @return  the number of reclaimed objects.
+         */
+        size_t collect();
+
+        //! returns the number of retired objects, which are not yet reclaimed.
+        [[nodiscard]] inline size_t num_retired() const { return m_retired.size(); }
+
+        //! returns true if this participant is registered with an EpochReclaimer.
+        [[nodiscard]] inline bool valid() const { return m_reclaimer; }
+
+        friend void swap(participant_t &lhs, participant_t &rhs) noexcept;
+
+    private:
+        friend class EpochReclaimer;
+        friend class guard_t;
+
+        struct retired_t
+        {
+            void *ptr = nullptr;
+            deleter_fn_t deleter = nullptr;
+            void *user_data = nullptr;
+            uint64_t epoch = 0;
+        };
+
+        participant_t(EpochReclaimer *reclaimer, uint32_t slot_index);
+
+        void unpin();
+
+        EpochReclaimer *m_reclaimer = nullptr;
+        uint32_t m_slot_index = 0;
+        uint32_t m_pin_count = 0;
+        std::vector<retired_t> m_retired;
+    };
+
+    /**
+     * @brief   Create an EpochReclaimer.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created EpochReclaimer.
+     */
+    static EpochReclaimerUPtr create(const create_info_t &create_info);
+
+    EpochReclaimer(const EpochReclaimer &) = delete;
+
+    /**
+     * @brief   Destroy the EpochReclaimer, reclaiming all orphaned objects.
+     *          All participants need to be destroyed before.
+     */
+    ~EpochReclaimer();
+
+    /**
+     * @brief   Register the calling thread as participant.
+     *          throws a std::runtime_error, if create_info_t::max_num_threads would be exceeded.
+     *
+     * @return  a newly registered participant_t.
+     */
+    participant_t register_thread();
+
+    /**
+     * @brief   Attempt to advance the global epoch.
+     *          This will succeed if all currently pinned participants have observed the current epoch.
+     *
+     * @return  true, if the global epoch was advanced.
+     */
+    bool try_advance();
+
+    //! returns the current global epoch.
+    [[nodiscard]] inline uint64_t epoch() const { return m_global_epoch.load(std::memory_order_acquire); }
+
+    /**
+     * @brief   Reclaim orphaned objects, left behind by unregistered participants, if possible.
+     *
+     * @return  the number of reclaimed objects.
+     */
+    size_t collect_orphans();
+
+private:
+    //! per-thread slot, padded to a cache-line to avoid false sharing
+    struct alignas(k_cache_line_size) slot_t
+    {
+        //! (epoch << 1) | 1 while pinned, 0 otherwise
+        std::atomic<uint64_t> state = 0;
+
+        std::atomic<bool> in_use = false;
+    };
+
+    //! number of epochs a retired object needs to age, before it can be safely reclaimed
+    static constexpr uint64_t s_grace_epochs = 2;
+
+    explicit EpochReclaimer(const create_info_t &create_info);
+
+    static size_t reclaim(std::vector<participant_t::retired_t> &retired, uint64_t epoch);
+
+    create_info_t m_create_info;
+
+    std::atomic<uint64_t> m_global_epoch = 1;
+
+    std::unique_ptr<slot_t[]> m_slots;
+
+    std::mutex m_orphan_mutex;
+    std::vector<participant_t::retired_t> m_orphans;
+};
+
+}// namespace crocore
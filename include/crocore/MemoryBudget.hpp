@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "crocore/Allocator.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a MemoryBudget
+DEFINE_CLASS_PTR(MemoryBudget)
+
+//! memory-pressure levels, relative to a MemoryBudget
+enum class MemoryPressure : uint8_t
+{
+    NONE = 0,
+    MODERATE,
+    HIGH,
+    CRITICAL
+};
+
+//! sources to measure memory-usage with
+enum class MemoryUsageSource : uint8_t
+{
+    //! sum of num_bytes_allocated of all registered allocators
+    ALLOCATORS = 0,
+
+    //! resident set size of the process (/proc/self/statm)
+    PROCESS_RSS,
+
+    //! memory charged to the process' cgroup (memory.current / memory.usage_in_bytes)
+    CGROUP
+};
+
+/**
+ * @brief   MemoryBudget is a registry of allocators, sharing a process-wide memory budget.
+ *
+ *          update() measures the current usage and derives a pressure-level. Under pressure, registered allocators
+ *          are asked to release memory in order of their priority (lowest first), until usage drops below
+ *          the moderate threshold: at MODERATE pressure an optional trim-function is called,
+ *          at HIGH and CRITICAL pressure allocators are shrunk.
+ *
+ *          update() is intended to be called periodically, e.g. from a background-task or an application's
+ *          update-loop. It never runs from within an allocation, so allocators' locks are never nested.
+ *          Allocators can query the last pressure-level lock-free, via pressure().
+ *
+ *          Allocators are referenced weakly, destroyed allocators are removed automatically.
+ */
+class MemoryBudget
+{
+public:
+
+    //! helper struct to group necessary information to create a MemoryBudget.
+    struct create_info_t
+    {
+        //! budget in bytes (default 0: unlimited, unless use_cgroup_limit provides one)
+        size_t budget = 0;
+
+        //! use the memory-limit of the process' cgroup as budget, if no budget was provided
+        bool use_cgroup_limit = false;
+
+        //! source to measure memory-usage with
+        MemoryUsageSource usage_source = MemoryUsageSource::ALLOCATORS;
+
+        //! fractions of the budget, at which pressure-levels are reached
+        float moderate_threshold = 0.7f;
+        float high_threshold = 0.85f;
+        float critical_threshold = 0.95f;
+
+        //! optional function object, called by update() whenever the pressure-level changes
+        std::function<void(MemoryPressure)> pressure_fn;
+    };
+
+    /**
+     * @brief   Create a MemoryBudget.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created MemoryBudget.
+     */
+    static MemoryBudgetUPtr create(create_info_t create_info);
+
+    //! returns a process-wide MemoryBudget, using the cgroup's memory-limit as budget (if any)
+    static const MemoryBudgetPtr &global();
+
+    MemoryBudget(const MemoryBudget &) = delete;
+
+    MemoryBudget(MemoryBudget &&) = delete;
+
+    MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+    /**
+     * @brief   Register an allocator.
+     *
+     * @param   allocator   the allocator to register, referenced weakly.
+     * @param   priority    allocators with lower priority release memory first.
+     * @param   trim_fn     optional function object to incrementally release memory at MODERATE pressure,
+     *                      e.g. calling MemoryCache::trim().
+     * @return  an id, to remove the allocator again.
+     */
+    uint64_t add(const AllocatorPtr &allocator, int32_t priority = 0, std::function<void()> trim_fn = {});
+
+    //! remove a registered allocator
+    void remove(uint64_t id);
+
+    /**
+     * @brief   Measure current usage, update the pressure-level and release memory if necessary.
+     *
+     * @return  the pressure-level after releasing memory.
+     */
+    MemoryPressure update();
+
+    //! returns the pressure-level, determined by the last call to update(). lock-free.
+    [[nodiscard]] MemoryPressure pressure() const { return m_pressure.load(std::memory_order_relaxed); }
+
+    //! measure the current memory-usage in bytes
+    [[nodiscard]] size_t usage() const;
+
+    //! returns the budget in bytes, 0 for unlimited
+    [[nodiscard]] size_t budget() const { return m_budget.load(std::memory_order_relaxed); }
+
+    //! set the budget in bytes, 0 for unlimited
+    void set_budget(size_t budget) { m_budget.store(budget, std::memory_order_relaxed); }
+
+    //! returns the resident set size of the process in bytes, 0 if not available
+    static size_t process_rss();
+
+    //! returns the memory-limit of the process' cgroup in bytes, 0 if not available or unlimited
+    static size_t cgroup_limit();
+
+    //! returns the memory charged to the process' cgroup in bytes, 0 if not available
+    static size_t cgroup_usage();
+
+private:
+
+    struct entry_t
+    {
+        uint64_t id = 0;
+        std::weak_ptr<Allocator> allocator;
+        int32_t priority = 0;
+        std::function<void()> trim_fn;
+    };
+
+    explicit MemoryBudget(create_info_t create_info);
+
+    //! map a usage to a pressure-level
+    [[nodiscard]] MemoryPressure pressure_level(size_t usage) const;
+
+    create_info_t m_format;
+
+    std::atomic<size_t> m_budget = 0;
+
+    std::atomic<MemoryPressure> m_pressure = MemoryPressure::NONE;
+
+    //! registered allocators, sorted by priority
+    std::vector<entry_t> m_entries;
+
+    uint64_t m_next_id = 1;
+
+    mutable std::mutex m_mutex;
+
+    //! serializes update()
+    std::mutex m_update_mutex;
+};
+
+}// namespace crocore
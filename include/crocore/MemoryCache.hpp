@@ -4,10 +4,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <functional>
 #include <crocore/Allocator.hpp>
+#include <crocore/MemoryBudget.hpp>
 
 
 namespace crocore
@@ -18,6 +22,22 @@ using MemoryCachePtr = std::shared_ptr<class MemoryCache>;
 
 /**
  * @brief   MemoryCache is an implementation of uf::Allocator, using a caching-strategy.
+ *
+ *          Chunks can be backed by (huge-)page mappings,
+ *          using crocore::virtual_memory::alloc_fn() and crocore::virtual_memory::unmap().
+ *
+ *          With create_info_t::size_classes enabled, chunk-sizes are rounded to geometric size-classes
+ *          (four per power of two). Each chunk starts with a small header, so used pointers are resolved in O(1),
+ *          and free chunks are kept in intrusive per-class lists. Lists are sharded by thread,
+ *          each shard guarded by its own lock. A free chunk is re-used, if it is within size_tolerance.
+ *          In size-class mode, the order of release is tracked per shard, eviction picks the oldest shard-tail.
+ *
+ *          Free chunks can be bounded in total size (create_info_t::max_idle_bytes) and age
+ *          (create_info_t::max_idle_duration). The least recently freed chunks are evicted first,
+ *          so memory for recently used sizes stays warm.
+ *
+ *          With a MemoryBudget (create_info_t::budget), free chunks are released before growing,
+ *          while the budget reports HIGH pressure or above.
  */
 class MemoryCache final : public Allocator
 {
@@ -32,6 +52,22 @@ public:
         //! maximum size-tolerance for recycling free chunks
         float size_tolerance = 2.f;
 
+        //! pages of free chunks of at least this size are returned to the OS, keeping the chunks (default 0: disabled).
+        //! only applies to chunks mapped by virtual_memory::alloc_fn(), other chunks are kept as they are.
+        size_t release_min_bytes = 0;
+
+        //! use geometric size-classes with intrusive free-lists and sharded locks, instead of global maps
+        bool size_classes = false;
+
+        //! maximum number of bytes kept in free chunks, least recently freed chunks are evicted (default 0: unlimited)
+        size_t max_idle_bytes = 0;
+
+        //! free chunks idling for longer are evicted by trim() (default 0: no age-limit)
+        std::chrono::steady_clock::duration max_idle_duration = {};
+
+        //! optional memory-budget, free chunks are released before allocating new ones under HIGH pressure
+        MemoryBudgetPtr budget;
+
         //! function object to perform allocations with
         std::function<void *(size_t)> alloc_fn = ::malloc;
 
@@ -54,14 +90,45 @@ public:
      */
     void *allocate(size_t numBytes) override;
 
+    /**
+     * @brief   Allocate memory with a specific alignment from the cache.
+     *
+     *          Free chunks are re-used, if they can hold the requested number of bytes at the requested alignment.
+     *          Newly allocated chunks are padded for alignments larger than alignof(std::max_align_t).
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
     /**
      * @brief   Free a block of memory, previously returned by this cache.
      *          The block will be kept in the map of free chunks for later re-use.
      *
+     *          Unknown pointers are ignored. In size-class mode, the header in front of ptr is read instead of
+     *          searching a map, so ptr must at least be readable. Foreign pointers and double frees are detected
+     *          best-effort (using a magic value in the header) and ignored, passing them is undefined behaviour.
+     *
      * @param   ptr a pointer to the beginning of a memory block, managed by this MemoryCache.
      */
     void free(void *ptr) override;
 
+    //! sized and handle-based free, forwarding to free(ptr)
+    using Allocator::free;
+
+    /**
+     * @brief   Change the size of an existing allocation.
+     *
+     *          The current chunk is kept, if it can hold num_bytes and is not larger than allowed by size_tolerance.
+     *          Otherwise a different chunk is used, preserving the original alignment.
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this cache, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     */
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
     /**
      * @brief   Shrinks the internally allocated memory to a minimum, without affecting existing allocations.
      *          In case of a MemoryCache, this will free all unused memory-chunks.
@@ -70,24 +137,111 @@ public:
     void shrink() override;
 
     /**
-     * @brief   Return a summary of the allocator's internal state.
+     * @brief   Incrementally evict free chunks, exceeding create_info_t::max_idle_duration or max_idle_bytes.
+     *          Least recently freed chunks are evicted first.
+     *          Intended to be called periodically, e.g. from a background-task or an application's update-loop.
+     *
+     * @param   max_num_chunks  maximum number of chunks to evict during this call.
+     * @return  the number of evicted chunks.
+     */
+    size_t trim(size_t max_num_chunks = 16);
+
+    /**
+     * @brief   Return a summary of the allocator's internal state, based on running counters.
+     *          Only the fragmentation requires a look at the largest free chunk (per shard in size-class mode).
      */
     Allocator::state_t state() const override;
 
 private:
 
-    //! map type for used memory
-    using used_ptr_map_t = std::map<void *, size_t>;
+    //! a chunk of memory, obtained from alloc_fn
+    struct chunk_t
+    {
+        void *base = nullptr;
+        size_t num_bytes = 0;
+
+        //! alignment requested for the client-pointer
+        size_t alignment = 1;
+    };
+
+    //! map type for used memory, maps (aligned) client-pointers to chunks
+    using used_ptr_map_t = std::map<void *, chunk_t>;
+
+    //! a free chunk, waiting for re-use
+    struct idle_chunk_t
+    {
+        void *base = nullptr;
+
+        //! sequence-number, ordering free chunks by release
+        uint64_t seq = 0;
+    };
 
     //! map type for free memory
-    using free_ptr_map_t = std::multimap<size_t, void *>;
+    using free_ptr_map_t = std::multimap<size_t, idle_chunk_t>;
+
+    //! map type for free memory in order of release (oldest first)
+    using lru_map_t = std::map<uint64_t, std::pair<free_ptr_map_t::iterator, std::chrono::steady_clock::time_point>>;
 
     explicit MemoryCache(create_info_t fmt);
 
+    //! add a chunk to the free chunks, evict least recently freed chunks above max_idle_bytes.
+    void insert_free_chunk(size_t num_bytes, void *base);
+
+    //! remove a chunk from the free chunks
+    void erase_free_chunk(free_ptr_map_t::iterator it);
+
+    //! returns true, if a chunk idling since a point in time or the idle-bytes exceed their limits.
+    bool exceeds_idle_limits(std::chrono::steady_clock::time_point idle_since,
+                             std::chrono::steady_clock::time_point now) const;
+
+    //! returns true, if free chunks exist while the budget reports HIGH pressure or above.
+    inline bool under_pressure() const
+    {
+        return _format.budget && _format.budget->pressure() >= MemoryPressure::HIGH &&
+               _counters.num_bytes_allocated.load(std::memory_order_relaxed) >
+               _counters.num_bytes_used.load(std::memory_order_relaxed);
+    }
+
+    //! size-class counterparts of the public interface
+    void *allocate_sized(size_t num_bytes, size_t alignment);
+
+    void free_sized(void *ptr);
+
+    void *reallocate_sized(void *ptr, size_t num_bytes);
+
+    void shrink_sized();
+
+
+    size_t trim_sized(size_t max_num_chunks);
+
+    //! pop a free chunk of sufficient size from a shard, requires a lock on the shard.
+    struct chunk_header_t *pop_chunk(struct cache_shard_t &shard, uint32_t first_class, uint32_t last_class);
+
+    //! remove a free chunk from a shard and de-allocate it, requires a lock on the shard.
+    void evict_chunk(struct cache_shard_t &shard, struct chunk_header_t *chunk);
+
+    //! evict least recently freed chunks across all shards, until max_idle_bytes is met. locks one shard at a time.
+    void evict_idle_bytes_sized();
+
     create_info_t _format;
     free_ptr_map_t _freeChunks;
     used_ptr_map_t _usedChunks;
+    lru_map_t _lruChunks;
+    uint64_t _seq = 0;
+
+    //! total number of bytes in free chunks
+    std::atomic<size_t> _numIdleBytes = 0;
+
+    //! running counters for chunks and client-allocations
+    allocation_counters_t _counters;
+
     mutable std::recursive_mutex _mutex;
+
+    //! optional shards, used in size-class mode
+    std::unique_ptr<struct cache_shard_t[]> _shards;
+
+    //! number of shards (pow2)
+    uint32_t _num_shards = 0;
 };
 }
 
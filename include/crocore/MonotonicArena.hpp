@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+#include "crocore/Allocator.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a MonotonicArena
+DEFINE_CLASS_PTR(MonotonicArena)
+
+/**
+ * @brief   MonotonicArena is a bump-pointer allocator for short-lived data.
+ *
+ *          Allocations advance a pointer inside a chain of chunks, free() only rewinds the most recent allocation.
+ *          All memory is recycled at once with reset(), which rewinds to the first chunk in O(1),
+ *          keeping all chunks for subsequent use.
+ *
+ *          A MonotonicArena is not thread-safe, use one arena per thread (or per frame).
+ */
+class MonotonicArena final : public crocore::Allocator
+{
+public:
+
+    //! helper struct to group necessary information to create a MonotonicArena.
+    struct create_info_t
+    {
+        //! minimum size of a chunk in bytes, including a small header (default: 64kB)
+        size_t chunk_size = 1U << 16U;
+
+        //! function object to perform allocations with
+        std::function<void *(size_t)> alloc_fn = ::malloc;
+
+        //! function object to perform de-allocations with
+        std::function<void(void *)> dealloc_fn = ::free;
+    };
+
+    /**
+     * @brief   Create a MonotonicArena.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created MonotonicArena.
+     */
+    static MonotonicArenaUPtr create(create_info_t create_info);
+
+    MonotonicArena(const MonotonicArena &) = delete;
+
+    MonotonicArena(MonotonicArena &&) = delete;
+
+    ~MonotonicArena();
+
+    MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+    /**
+     * @brief   Allocate memory by bumping a pointer, aligned to alignof(std::max_align_t).
+     *          A new chunk is used, if the current chunk is exhausted.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes) override;
+
+    /**
+     * @brief   Allocate memory with a specific alignment.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    /**
+     * @brief   Change the size of an existing allocation.
+     *          The most recent allocation is resized in place, if it fits into its chunk.
+     *          Otherwise a new allocation is made and the content copied, keeping the original alignment.
+     *          Sizes of allocations are not stored, so more bytes than the original size might be copied.
+     *          The old allocation stays reserved until reset().
+     *
+     * @param   ptr         a pointer to a memory-block, returned by this arena, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     */
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
+    /**
+     * @brief   Memory is recycled with reset(), only the most recent allocation is rewound.
+     */
+    void free(void *ptr) override;
+
+    //! sized and handle-based free, forwarding to free(ptr)
+    using Allocator::free;
+
+    /**
+     * @brief   Release all chunks to dealloc_fn, which are not in use.
+     */
+    void shrink() override;
+
+    /**
+     * @brief   Return a summary of the arena's internal state.
+     *          num_bytes_used includes padding for alignment.
+     */
+    [[nodiscard]] Allocator::state_t state() const override;
+
+    /**
+     * @brief   Invalidate all allocations and rewind to the first chunk in O(1).
+     */
+    void reset();
+
+private:
+
+    struct chunk_t;
+
+    explicit MonotonicArena(create_info_t create_info);
+
+    //! continue with a chunk, large enough for num_bytes with alignment
+    bool next_chunk(size_t num_bytes, size_t alignment);
+
+    create_info_t m_format;
+
+    //! first chunk in chain and currently active chunk
+    chunk_t *m_first = nullptr, *m_current = nullptr;
+
+    //! bump-pointer and end of current chunk
+    uint8_t *m_ptr = nullptr, *m_end = nullptr;
+
+    //! most recent allocation
+    uint8_t *m_last = nullptr;
+
+    //! bytes used in chunks before m_current
+    size_t m_num_bytes_used_before = 0;
+
+    size_t m_num_chunks = 0;
+    size_t m_num_bytes_allocated = 0;
+};
+
+}// namespace crocore
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <crocore/fixed_size_free_list.h>
+
+namespace crocore
+{
+
+/**
+ * @brief   ObjectPool stores objects of type T in contiguous pages of a fixed_size_free_list,
+ *          addressed by generational handles (32-bit index + 32-bit generation).
+ *
+ *          Each slot carries a generation, which is incremented when an object is created and again when destroyed,
+ *          so live objects have odd generations. Handles of destroyed objects no longer match their slot's generation,
+ *          stale handles are detected in O(1), even after the slot was re-used.
+ *
+ *          create() and destroy() are lock-free, unless a new page needs to be allocated.
+ *          for_each() visits all live objects in index-order, page by page.
+ *
+ *          Accessing an object concurrently with its destruction is not synchronized by the pool.
+ *          After 2^31 re-uses of a single slot, generations wrap around.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    //! invalid index
+    static constexpr uint32_t s_invalid_index = fixed_size_free_list<T>::s_invalid_index;
+
+    //! generational handle, addressing an object in an ObjectPool
+    struct handle_t
+    {
+        uint32_t index = s_invalid_index;
+        uint32_t generation = 0;
+
+        //! returns the handle packed into a 64-bit value (generation in the upper 32 bits)
+        [[nodiscard]] inline uint64_t value() const { return (uint64_t(generation) << 32U) | index; }
+
+        //! create a handle from a packed 64-bit value
+        static inline handle_t from_value(uint64_t value)
+        {
+            return {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32U)};
+        }
+
+        inline bool operator==(const handle_t &other) const = default;
+
+        inline explicit operator bool() const { return index != s_invalid_index; }
+    };
+
+    /**
+     * @brief   Create an ObjectPool.
+     *
+     * @param   max_num_objects maximum number of objects (default s_invalid_index: no limit).
+     * @param   page_size       number of objects per page, must be a power of two.
+     * @param   cache_size      number of slots cached per thread (default 0: disabled), see fixed_size_free_list.
+     */
+    explicit ObjectPool(uint32_t max_num_objects = s_invalid_index, uint32_t page_size = 1024,
+                        uint32_t cache_size = 0)
+        : m_objects(max_num_objects, page_size, cache_size), m_page_size(page_size),
+          m_page_shift(std::countr_zero(page_size))
+    {
+        m_generation_tables.emplace_back(new std::atomic<uint32_t> *[m_num_generation_table_entries]);
+        m_generation_pages = m_generation_tables.back().get();
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+
+    ObjectPool(ObjectPool &&) = delete;
+
+    //! destroys all remaining objects
+    ~ObjectPool() { clear(); }
+
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    /**
+     * @brief   lockless construct a new object, parameters are passed on to the constructor.
+     *
+     * @return  a handle for the new object, evaluating to false if the pool is full.
+     */
+    template<typename... Parameters>
+    inline handle_t create(Parameters &&...parameters)
+    {
+        uint32_t index = m_objects.create(std::forward<Parameters>(parameters)...);
+        if(index == s_invalid_index){ return {}; }
+
+        // make the object visible as live, generation becomes odd
+        auto &generation = generation_storage(index);
+        uint32_t value = generation.load(std::memory_order_relaxed) + 1;
+        generation.store(value, std::memory_order_release);
+        m_num_objects.fetch_add(1, std::memory_order_relaxed);
+        return {index, value};
+    }
+
+    /**
+     * @brief   lockless destruct an object and return its slot to the pool.
+     *
+     * @return  true, if the handle was valid and the object was destroyed.
+     */
+    inline bool destroy(handle_t handle)
+    {
+        if(!is_valid(handle)){ return false; }
+
+        // generation becomes even, only one concurrent destroy succeeds
+        uint32_t expected = handle.generation;
+        if(!generation_storage(handle.index).compare_exchange_strong(expected, handle.generation + 1,
+                                                                     std::memory_order_acq_rel))
+        {
+            return false;
+        }
+        m_objects.destroy(handle.index);
+        m_num_objects.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //! returns true, if the handle refers to a live object
+    [[nodiscard]] inline bool is_valid(handle_t handle) const
+    {
+        return (handle.generation & 1U) && handle.index < m_num_generations.load(std::memory_order_acquire) &&
+               generation_storage(handle.index).load(std::memory_order_acquire) == handle.generation;
+    }
+
+    //! access an object by handle, returns nullptr for stale or invalid handles
+    inline T *get(handle_t handle) { return is_valid(handle) ? &m_objects.get(handle.index) : nullptr; }
+
+    //! access an object by handle, returns nullptr for stale or invalid handles
+    inline const T *get(handle_t handle) const { return is_valid(handle) ? &m_objects.get(handle.index) : nullptr; }
+
+    /**
+     * @brief   visit all live objects, page by page in index-order.
+     *
+     * @param   fn  a callable with signature void(handle_t, T&)
+     */
+    template<typename Fn>
+    inline void for_each(Fn &&fn)
+    {
+        for_each_index([this, &fn](uint32_t index, uint32_t generation) {
+            fn(handle_t{index, generation}, m_objects.get(index));
+        });
+    }
+
+    /**
+     * @brief   visit all live objects, page by page in index-order.
+     *
+     * @param   fn  a callable with signature void(handle_t, const T&)
+     */
+    template<typename Fn>
+    inline void for_each(Fn &&fn) const
+    {
+        for_each_index([this, &fn](uint32_t index, uint32_t generation) {
+            fn(handle_t{index, generation}, m_objects.get(index));
+        });
+    }
+
+    //! destroy all live objects, requires exclusive access
+    inline void clear()
+    {
+        for_each_index([this](uint32_t index, uint32_t generation) { destroy(handle_t{index, generation}); });
+    }
+
+    //! returns the number of live objects
+    [[nodiscard]] inline uint32_t size() const { return m_num_objects.load(std::memory_order_relaxed); }
+
+    //! returns true, if no live objects exist
+    [[nodiscard]] inline bool empty() const { return !size(); }
+
+    //! returns the number of objects, for which pages were allocated
+    [[nodiscard]] inline uint32_t capacity() const { return m_objects.capacity(); }
+
+private:
+
+    //! visit index and generation of all live objects
+    template<typename Fn>
+    inline void for_each_index(Fn &&fn) const
+    {
+        uint32_t num_generations = m_num_generations.load(std::memory_order_acquire);
+        auto *const *pages = m_generation_pages.load(std::memory_order_acquire);
+        uint32_t chunk_size = std::min<uint32_t>(m_page_size, 64);
+
+        for(uint32_t page = 0; page < (num_generations >> m_page_shift); ++page)
+        {
+            const std::atomic<uint32_t> *generations = pages[page];
+
+            for(uint32_t chunk = 0; chunk < m_page_size; chunk += chunk_size)
+            {
+                // gather live-bits first, avoiding unpredictable branches for sparse pages
+                uint64_t live_mask = 0;
+                for(uint32_t i = 0; i < chunk_size; ++i)
+                {
+                    live_mask |= uint64_t(generations[chunk + i].load(std::memory_order_acquire) & 1U) << i;
+                }
+
+                for(; live_mask; live_mask &= live_mask - 1)
+                {
+                    uint32_t i = chunk + std::countr_zero(live_mask);
+                    fn((page << m_page_shift) + i, generations[i].load(std::memory_order_relaxed));
+                }
+            }
+        }
+    }
+
+    //! access the generation of a slot, allocating its page if necessary
+    inline std::atomic<uint32_t> &generation_storage(uint32_t index)
+    {
+        if(index >= m_num_generations.load(std::memory_order_acquire))
+        {
+            std::lock_guard lock(m_generation_mutex);
+            while(index >= m_num_generations.load(std::memory_order_relaxed)){ add_generation_page(); }
+        }
+        return m_generation_pages.load(std::memory_order_acquire)[index >> m_page_shift][index & (m_page_size - 1)];
+    }
+
+    //! access the generation of a slot, which is known to exist
+    inline const std::atomic<uint32_t> &generation_storage(uint32_t index) const
+    {
+        return m_generation_pages.load(std::memory_order_acquire)[index >> m_page_shift][index & (m_page_size - 1)];
+    }
+
+    //! allocate a page of generations and grow the page table if necessary, requires a lock on m_generation_mutex
+    inline void add_generation_page()
+    {
+        uint32_t next_page = m_num_generations.load(std::memory_order_relaxed) >> m_page_shift;
+
+        // grow page table, previous tables stay valid for concurrent readers
+        if(next_page == m_num_generation_table_entries)
+        {
+            auto *pages = new std::atomic<uint32_t> *[2 * m_num_generation_table_entries];
+            auto *current = m_generation_pages.load(std::memory_order_relaxed);
+            std::copy(current, current + m_num_generation_table_entries, pages);
+            m_generation_tables.emplace_back(pages);
+            m_generation_pages.store(pages, std::memory_order_release);
+            m_num_generation_table_entries *= 2;
+        }
+
+        // generations start at zero (not live)
+        m_generations.emplace_back(new std::atomic<uint32_t>[m_page_size]());
+        m_generation_pages.load(std::memory_order_relaxed)[next_page] = m_generations.back().get();
+        m_num_generations.fetch_add(m_page_size, std::memory_order_release);
+    }
+
+    //! object-storage
+    fixed_size_free_list<T> m_objects;
+
+    //! size (in objects) of a single page
+    uint32_t m_page_size = 0;
+
+    //! number of bits to shift an index to the right to get the page number
+    uint32_t m_page_shift = 0;
+
+    //! number of live objects
+    std::atomic<uint32_t> m_num_objects = 0;
+
+    //! number of slots, for which generations were allocated
+    std::atomic<uint32_t> m_num_generations = 0;
+
+    //! number of entries in the current generation page table
+    uint32_t m_num_generation_table_entries = 8;
+
+    //! current generation page table, replaced by a copy of twice the size when full
+    std::atomic<std::atomic<uint32_t> **> m_generation_pages = nullptr;
+
+    //! all generation page tables, previous ones are kept alive for concurrent readers
+    std::vector<std::unique_ptr<std::atomic<uint32_t> *[]>> m_generation_tables;
+
+    //! pages of generations
+    std::vector<std::unique_ptr<std::atomic<uint32_t>[]>> m_generations;
+
+    //! mutex used to allocate a new page of generations
+    std::mutex m_generation_mutex;
+};
+
+}// namespace crocore
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "crocore/Allocator.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a RecordingAllocator
+DEFINE_CLASS_PTR(RecordingAllocator)
+
+//! operations captured in an allocation-trace
+enum class TraceOp : uint8_t
+{
+    ALLOCATE = 0,
+    FREE,
+    REALLOCATE
+};
+
+/**
+ * @brief   trace_event_t is a compact binary record of a single call to an Allocator.
+ *          Allocations are identified by ids, assigned in order of their allocation.
+ */
+struct trace_event_t
+{
+    //! id of the allocation
+    uint64_t id = 0;
+
+    //! requested number of bytes (ALLOCATE, REALLOCATE), 0 for FREE
+    uint64_t num_bytes = 0;
+
+    //! index of the calling thread
+    uint32_t thread = 0;
+
+    TraceOp op = TraceOp::ALLOCATE;
+
+    //! log2 of the requested alignment, 0 for default alignment
+    uint8_t alignment_log2 = 0;
+
+    uint16_t padding = 0;
+};
+static_assert(sizeof(trace_event_t) == 24);
+
+/**
+ * @brief   RecordingAllocator wraps another Allocator and captures a trace of all allocate-, reallocate-
+ *          and free-calls, including requested sizes and the calling thread.
+ *
+ *          Traces can be saved to a binary file and replayed against different allocators,
+ *          allowing to compare allocators on recorded workloads.
+ *          Recording requires a mutex, so the wrapper is intended for capturing, not for production use.
+ */
+class RecordingAllocator final : public crocore::Allocator
+{
+public:
+
+    //! helper struct to group necessary information to create a RecordingAllocator.
+    struct create_info_t
+    {
+        //! the allocator to forward all calls to
+        AllocatorPtr allocator;
+
+        //! number of events to reserve memory for
+        size_t num_reserved_events = 0;
+    };
+
+    /**
+     * @brief   Create a RecordingAllocator.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created RecordingAllocator or nullptr, if no allocator was provided.
+     */
+    static RecordingAllocatorUPtr create(create_info_t create_info);
+
+    RecordingAllocator(const RecordingAllocator &) = delete;
+
+    RecordingAllocator(RecordingAllocator &&) = delete;
+
+    RecordingAllocator &operator=(const RecordingAllocator &) = delete;
+
+    void *allocate(size_t num_bytes) override;
+
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
+    void free(void *ptr) override;
+
+    //! sized and handle-based free, forwarding to free(ptr)
+    using Allocator::free;
+
+    void shrink() override;
+
+    [[nodiscard]] Allocator::state_t state() const override;
+
+    //! returns a copy of all events recorded so far.
+    [[nodiscard]] std::vector<trace_event_t> trace() const;
+
+    //! discard all recorded events. live allocations are kept and can still be freed.
+    void clear();
+
+    /**
+     * @brief   Save the recorded trace to a binary file.
+     *
+     * @param   path    a file-path.
+     * @return  true, if the file could be written.
+     */
+    bool save(const std::filesystem::path &path) const;
+
+    /**
+     * @brief   Load a trace from a binary file, previously written by save().
+     *
+     * @param   path    a file-path.
+     * @return  the loaded events, empty if the file could not be read or has an invalid format.
+     */
+    static std::vector<trace_event_t> load(const std::filesystem::path &path);
+
+private:
+
+    explicit RecordingAllocator(create_info_t create_info);
+
+    //! record a new allocation, requires a lock on m_mutex.
+    void record_allocation(void *ptr, size_t num_bytes, size_t alignment);
+
+    AllocatorPtr m_allocator;
+
+    //! maps live pointers to allocation-ids
+    std::unordered_map<void *, uint64_t> m_ids;
+
+    std::vector<trace_event_t> m_events;
+
+    uint64_t m_next_id = 0;
+
+    mutable std::mutex m_mutex;
+};
+
+}// namespace crocore
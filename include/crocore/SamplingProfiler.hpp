@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crocore/Allocator.hpp"
+#include "crocore/utils.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a SamplingProfiler
+DEFINE_CLASS_PTR(SamplingProfiler)
+
+//! output formats of a SamplingProfiler
+enum class ProfileFormat : uint8_t
+{
+    //! flamegraph collapsed stacks: "root;...;leaf <live bytes>" per line, frames symbolized
+    COLLAPSED = 0,
+
+    //! legacy pprof heap-profile (text), including MAPPED_LIBRARIES, symbolized by pprof
+    PPROF_HEAP
+};
+
+/**
+ * @brief   SamplingProfiler wraps another Allocator and records call-stacks for a sample of allocations,
+ *          aggregating live and total bytes per call-site.
+ *
+ *          On average one allocation is sampled every create_info_t::sample_interval bytes (Poisson-sampling).
+ *          Sampled sizes are weighted by their inverse sampling-probability, so aggregated bytes are unbiased estimates.
+ *          Non-sampled allocations cost a single atomic subtraction on a per-thread counter,
+ *          frees are checked against a counting-filter of sampled addresses without locking.
+ *
+ *          Profiles can be written as flamegraph collapsed stacks or as pprof heap-profile.
+ */
+class SamplingProfiler final : public crocore::Allocator
+{
+public:
+
+    //! helper struct to group necessary information to create a SamplingProfiler.
+    struct create_info_t
+    {
+        //! the allocator to forward all calls to
+        AllocatorPtr allocator;
+
+        //! average number of bytes between samples (default: 512kB), 1 samples each allocation
+        size_t sample_interval = 1U << 19U;
+
+        //! maximum number of captured frames per call-stack
+        uint32_t max_stack_depth = 64;
+
+        //! seed for the sampling intervals
+        uint64_t seed = 0;
+    };
+
+    //! aggregated statistics of a call-site, sizes are estimates
+    struct call_site_t
+    {
+        //! return-addresses, innermost frame first
+        std::vector<void *> frames;
+
+        //! estimated number and size of live allocations
+        size_t num_live_allocations = 0;
+        size_t num_live_bytes = 0;
+
+        //! estimated number and size of all allocations
+        size_t num_allocations = 0;
+        size_t num_bytes = 0;
+    };
+
+    /**
+     * @brief   Create a SamplingProfiler.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created SamplingProfiler or nullptr, if no allocator was provided.
+     */
+    static SamplingProfilerUPtr create(create_info_t create_info);
+
+    SamplingProfiler(const SamplingProfiler &) = delete;
+
+    SamplingProfiler(SamplingProfiler &&) = delete;
+
+    SamplingProfiler &operator=(const SamplingProfiler &) = delete;
+
+    void *allocate(size_t num_bytes) override;
+
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
+    void free(void *ptr) override;
+
+    void free(void *ptr, size_t num_bytes) override;
+
+    Allocator::allocation_t allocate_handle(size_t num_bytes) override;
+
+    void free(const allocation_t &allocation) override;
+
+    void shrink() override;
+
+    [[nodiscard]] Allocator::state_t state() const override;
+
+    //! returns all call-sites, sorted by estimated live bytes (descending).
+    [[nodiscard]] std::vector<call_site_t> call_sites() const;
+
+    //! discard all statistics and samples. live sampled allocations are not reported when freed.
+    void clear();
+
+    /**
+     * @brief   Generate a profile of the current state.
+     *
+     * @param   format  the output format.
+     * @return  the profile as string.
+     */
+    [[nodiscard]] std::string profile(ProfileFormat format = ProfileFormat::COLLAPSED) const;
+
+    /**
+     * @brief   Save a profile of the current state to a file.
+     *
+     * @param   path    a file-path.
+     * @param   format  the output format.
+     * @return  true, if the file could be written.
+     */
+    bool save(const std::filesystem::path &path, ProfileFormat format = ProfileFormat::COLLAPSED) const;
+
+private:
+
+    struct alignas(k_cache_line_size) counter_t
+    {
+        //! bytes to allocate, before the next sample is taken
+        std::atomic<int64_t> num_bytes_until_sample;
+    };
+
+    //! a sampled allocation, with estimated number and size of allocations it represents
+    struct sample_t
+    {
+        uint32_t call_site;
+        size_t num_allocations;
+        size_t num_bytes;
+    };
+
+    explicit SamplingProfiler(create_info_t create_info);
+
+    //! count an allocation and record a sample, if the calling thread's interval was crossed
+    void on_allocate(void *ptr, size_t num_bytes);
+
+    //! remove a sample, if ptr was sampled
+    void on_free(void *ptr);
+
+    //! draw the next sampling-interval, requires a lock on m_mutex.
+    int64_t next_interval();
+
+    //! index into m_filter for an address
+    [[nodiscard]] inline size_t filter_index(const void *ptr) const
+    {
+        auto v = reinterpret_cast<uintptr_t>(ptr);
+        return ((v >> 4U) ^ (v >> 16U)) & (s_filter_size - 1);
+    }
+
+    static constexpr size_t s_filter_size = 4096;
+
+    AllocatorPtr m_allocator;
+
+    create_info_t m_format;
+
+    //! per-thread sampling counters
+    std::unique_ptr<counter_t[]> m_counters;
+
+    //! number of counters (pow2)
+    uint32_t m_num_counters = 0;
+
+    //! counting-filter of sampled addresses
+    std::unique_ptr<std::atomic<uint32_t>[]> m_filter;
+
+    //! aggregated call-sites
+    std::vector<call_site_t> m_call_sites;
+
+    //! maps hashes of call-stacks to indices in m_call_sites
+    std::unordered_multimap<size_t, uint32_t> m_call_site_indices;
+
+    //! live sampled allocations
+    std::unordered_map<void *, sample_t> m_samples;
+
+    std::mt19937_64 m_rng;
+
+    mutable std::mutex m_mutex;
+};
+
+}// namespace crocore
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "crocore/Allocator.hpp"
+#include "crocore/utils.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a SlabAllocator
+DEFINE_CLASS_PTR(SlabAllocator)
+
+//! internal record for a slab
+struct slab_t;
+
+/**
+ * @brief   SlabAllocator serves small allocations from slabs of equally sized objects.
+ *
+ *          Requests are rounded to a size-class (multiples of 16 bytes up to 128 bytes, then four per power of two).
+ *          Each size-class allocates from an active slab, managing its free objects with a lock-free,
+ *          tagged free-list (same scheme as crocore::fixed_size_free_list). Objects can be freed from any thread.
+ *
+ *          Slabs are aligned to their size, so the owning slab of a pointer is found by masking its address.
+ *          A mutex is only acquired, if a size-class needs to switch to a different slab,
+ *          or a slab becomes empty and is released to dealloc_fn.
+ */
+class SlabAllocator final : public crocore::Allocator
+{
+public:
+
+    //! helper struct to group necessary information to create a SlabAllocator.
+    struct create_info_t
+    {
+        //! size of a slab in bytes, will be rounded to a power of two (default: 64kB)
+        size_t slab_size = 1U << 16U;
+
+        //! maximum object-size in bytes, larger requests will fail (default 0: slab_size / 8)
+        size_t max_object_size = 0;
+
+        //! release empty slabs to dealloc_fn
+        bool dealloc_empty_slabs = true;
+
+        //! function object to perform allocations with, must return memory aligned to the requested size
+        std::function<void *(size_t)> alloc_fn = [](size_t num_bytes) {
+            return crocore::aligned_alloc(num_bytes, num_bytes);
+        };
+
+        //! function object to perform de-allocations with
+        std::function<void(void *)> dealloc_fn = crocore::aligned_free;
+    };
+
+    /**
+     * @brief   Create a SlabAllocator.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created SlabAllocator.
+     */
+    static SlabAllocatorUPtr create(create_info_t create_info);
+
+    SlabAllocator(const SlabAllocator &) = delete;
+
+    SlabAllocator(SlabAllocator &&) = delete;
+
+    ~SlabAllocator();
+
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    /**
+     * @brief   Allocate an object from a slab.
+     *
+     *          This call will return a nullptr if:
+     *          - the requested num_bytes is larger than create_info_t::max_object_size.
+     *          - alloc_fn fails to provide a new slab.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes) override;
+
+    /**
+     * @brief   Allocate an object with a specific alignment.
+     *          Alignments up to 64 bytes are supported, by selecting a size-class which is a multiple of the alignment.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    /**
+     * @brief   Change the size of an existing allocation.
+     *          The object is kept, if the new size maps to the same size-class.
+     *
+     * @param   ptr         a pointer to an object, managed by this allocator, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     */
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
+    /**
+     * @brief   Return an object to its slab. Can be called from any thread.
+     *
+     * @param   ptr a pointer to an object, returned by this allocator.
+     */
+    void free(void *ptr) override;
+
+    //! sized and handle-based free, forwarding to free(ptr)
+    using Allocator::free;
+
+    /**
+     * @brief   Release all empty slabs to dealloc_fn, including currently active ones.
+     */
+    void shrink() override;
+
+    /**
+     * @brief   Return a summary of the allocator's internal state.
+     */
+    [[nodiscard]] Allocator::state_t state() const override;
+
+    //! returns the size of an object for a requested number of bytes, or 0 if no size-class is large enough.
+    [[nodiscard]] size_t object_size(size_t num_bytes) const;
+
+private:
+
+    //! per size-class data
+    struct size_class_t
+    {
+        //! slab to allocate objects from
+        std::atomic<slab_t *> active = nullptr;
+
+        //! all slabs of this size-class, guarded by m_mutex
+        std::vector<slab_t *> slabs;
+
+        uint32_t object_size = 0;
+    };
+
+    explicit SlabAllocator(create_info_t create_info);
+
+    void *allocate_class(uint32_t class_index);
+
+    //! switch the active slab of a size-class, requires a lock on m_mutex.
+    bool refill(uint32_t class_index, slab_t *observed);
+
+    //! create a new slab for a size-class, requires a lock on m_mutex.
+    slab_t *create_slab(uint32_t class_index);
+
+    //! release an empty slab, if nobody is using it
+    void try_release(slab_t *slab);
+
+    //! release a slab, which was marked as dead, requires a lock on m_mutex.
+    void release_slab(slab_t *slab);
+
+    create_info_t m_format;
+
+    std::unique_ptr<size_class_t[]> m_classes;
+    uint32_t m_num_classes = 0;
+
+    //! maps (num_bytes + 15) / 16 to size-classes
+    std::vector<uint8_t> m_class_lookup;
+
+    //! slab-records are never de-allocated before destruction, so stale references remain valid
+    std::vector<std::unique_ptr<slab_t>> m_slab_records;
+
+    //! records available for re-use
+    std::vector<slab_t *> m_free_records;
+
+    //! guards all changes to lists of slabs
+    mutable std::mutex m_mutex;
+};
+
+}// namespace crocore
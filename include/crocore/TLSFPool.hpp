@@ -0,0 +1,168 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "crocore/Allocator.hpp"
+#include "crocore/utils.hpp"
+
+namespace crocore
+{
+
+//! forward declare smart-pointers for a TLSFPool
+DEFINE_CLASS_PTR(TLSFPool)
+
+//! internal free-lists and bitmaps of a TLSFPool
+struct tlsf_control_t;
+
+/**
+ * @brief   TLSFPool implements a Two-Level Segregated Fit allocator,
+ *          providing allocate and free in O(1) worst-case time for arbitrary sizes.
+ *
+ *          Free blocks are kept in segregated lists: a first level per power of two and 32 linear
+ *          second-level subdivisions. Two levels of bitmaps locate a sufficiently large free block with
+ *          two bit-scans, no searching involved. Blocks carry boundary-tags, so neighbours are merged in O(1) on free.
+ *          The per-allocation overhead is 16 bytes, sizes are rounded to multiples of 16 bytes.
+ *
+ *          Memory is obtained in pools of create_info_t::pool_size bytes from alloc_fn, new pools are added on demand.
+ *          For hard real-time use, preallocate pools (create_info_t::min_num_pools) and limit their number,
+ *          so alloc_fn/dealloc_fn are never called on the critical path.
+ *
+ * @see     http://www.gii.upv.es/tlsf/files/papers/ecrts04_tlsf.pdf
+ */
+class TLSFPool final : public crocore::Allocator
+{
+public:
+
+    //! alignment of pools, when using the default alloc_fn
+    static constexpr size_t s_pool_alignment = 4096;
+
+    //! helper struct to group necessary information to create a TLSFPool.
+    struct create_info_t
+    {
+        //! size of a pool in bytes, will be rounded to a multiple of 16 bytes (default: 1MB)
+        size_t pool_size = 1U << 20U;
+
+        //! minimum number of preallocated pools
+        size_t min_num_pools = 0;
+
+        //! maximum number of pools (default 0: unlimited)
+        size_t max_num_pools = 0;
+
+        //! enable automatic deallocation of unused pools
+        bool dealloc_unused_pools = true;
+
+        //! function object to perform allocations with, must return memory aligned to at least 16 bytes
+        std::function<void *(size_t)> alloc_fn = [](size_t num_bytes) {
+            return crocore::aligned_alloc(num_bytes, s_pool_alignment);
+        };
+
+        //! function object to perform de-allocations with
+        std::function<void(void *)> dealloc_fn = crocore::aligned_free;
+    };
+
+    /**
+     * @brief   Create a TLSFPool.
+     *
+     * @param   create_info  a create_info_t struct.
+     * @return  a newly created TLSFPool.
+     */
+    static TLSFPoolUPtr create(create_info_t create_info);
+
+    TLSFPool(const TLSFPool &) = delete;
+
+    TLSFPool(TLSFPool &&) = delete;
+
+    ~TLSFPool();
+
+    TLSFPool &operator=(const TLSFPool &) = delete;
+
+    /**
+     * @brief   Allocate memory from the pool in O(1).
+     *
+     *          This call will return a nullptr if:
+     *          - the requested num_bytes does not fit into a pool.
+     *          - there is no sufficient free block and no new pool can be added.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes) override;
+
+    /**
+     * @brief   Allocate memory with a specific alignment in O(1).
+     *          Larger alignments are satisfied by over-allocating and splitting off the leading gap as a free block.
+     *
+     * @param   num_bytes   the requested number of bytes to allocate.
+     * @param   alignment   the requested alignment in bytes, must be a power of two.
+     * @return  a pointer to the beginning of a memory-block or nullptr if the allocation failed.
+     */
+    void *allocate(size_t num_bytes, size_t alignment) override;
+
+    /**
+     * @brief   Change the size of an existing allocation.
+     *          Allocations shrink in place and grow in place, if the following block is free and large enough.
+     *          Otherwise the allocation is moved to a new location, aligned to 16 bytes.
+     *
+     * @param   ptr         a pointer to the beginning of a memory block, managed by this pool, or nullptr.
+     * @param   num_bytes   the requested new size in bytes.
+     * @return  a pointer to the (possibly moved) memory-block or nullptr if the reallocation failed.
+     */
+    void *reallocate(void *ptr, size_t num_bytes) override;
+
+    /**
+     * @brief   Free a block of memory in O(1), merging it with free neighbours.
+     *
+     * @param   ptr a pointer to the beginning of a memory block, managed by this pool.
+     */
+    void free(void *ptr) override;
+
+    //! sized and handle-based free, forwarding to free(ptr)
+    using Allocator::free;
+
+    /**
+     * @brief   De-allocate unused pools above create_info_t::min_num_pools.
+     */
+    void shrink() override;
+
+    /**
+     * @brief   Return a summary of the allocator's internal state.
+     *          num_bytes_used refers to usable block-sizes, excluding block-headers.
+     */
+    [[nodiscard]] Allocator::state_t state() const override;
+
+    //! returns the largest number of bytes a single allocation can hold.
+    [[nodiscard]] size_t max_allocation_size() const;
+
+private:
+
+    explicit TLSFPool(create_info_t create_info);
+
+    //! allocate a block of at least size bytes (including header), requires a lock on m_mutex.
+    struct tlsf_block_t *allocate_block(size_t size);
+
+    //! free a block, merging it with free neighbours, requires a lock on m_mutex.
+    void free_block(struct tlsf_block_t *block);
+
+    //! add a new pool, requires a lock on m_mutex.
+    bool add_pool();
+
+    //! remove an unused pool, spanned by a single free block, requires a lock on m_mutex.
+    void remove_pool(struct tlsf_block_t *block);
+
+    create_info_t m_format;
+
+    std::unique_ptr<tlsf_control_t> m_control;
+
+    //! start-addresses of all pools
+    std::vector<uint8_t *> m_pools;
+
+    //! running counters for pools and client-allocations
+    allocation_counters_t m_counters;
+
+    mutable std::mutex m_mutex;
+};
+
+}// namespace crocore
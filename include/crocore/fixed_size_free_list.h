@@ -1,20 +1,28 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <bit>
 #include <cassert>
+#include <crocore/tagged_index_list.h>
 #include <crocore/utils.hpp>
 #include <cstdint>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 namespace crocore
 {
 
-constexpr uint32_t k_cache_line_size = 64;
-
 /// Class that allows lock free creation / destruction of objects (unless a new page of objects needs to be allocated)
-/// It contains a fixed pool of objects and also allows batching up a lot of objects to be destroyed
-/// and doing the actual free in a single atomic operation
+/// It contains a growable pool of objects and also allows batching up a lot of objects to be destroyed
+/// and doing the actual free in a single atomic operation.
+///
+/// The page table grows on demand, up to the provided maximum number of objects.
+/// Optionally, destroyed objects are kept in per-thread caches (sharded by crocore::thread_index()),
+/// which are handed back to the shared free list as batches, so threads rarely contend for its head.
 template<typename T>
 class fixed_size_free_list
 {
@@ -28,13 +36,21 @@ public:
 
     fixed_size_free_list(const fixed_size_free_list &) = delete;
 
-    inline fixed_size_free_list(uint32_t max_num_objects, uint32_t page_size);
+    /**
+     * @brief   Create a free list.
+     *
+     * @param   max_num_objects maximum number of objects (pass s_invalid_index for no limit).
+     * @param   page_size       number of objects per page, must be a power of two.
+     * @param   cache_size      number of objects cached per thread, before they are returned as a batch (default 0: disabled)
+     */
+    inline fixed_size_free_list(uint32_t max_num_objects, uint32_t page_size, uint32_t cache_size = 0);
 
     inline ~fixed_size_free_list();
 
     inline fixed_size_free_list &operator=(fixed_size_free_list other);
 
-    //! lockless construct a new object, parameters are passed on to the constructor
+    //! lockless construct a new object, parameters are passed on to the constructor.
+    //! returns s_invalid_index if out of space, after flushing all per-thread caches.
     template<typename... Parameters>
     inline uint32_t create(Parameters &&...parameters);
 
@@ -60,12 +76,18 @@ public:
     //! lockless destruct batch of objects
     inline void destroy_batch(batch_t &batch);
 
+    //! return all objects in per-thread caches to the shared free list
+    inline void flush_caches();
+
     //! access an object by index.
     inline T &get(uint32_t object_index) { return get_storage(object_index).object; }
 
     //! access an object by index.
     inline const T &get(uint32_t object_index) const { return get_storage(object_index).object; }
 
+    //! returns the number of objects, for which pages were allocated
+    [[nodiscard]] inline uint32_t capacity() const { return m_num_objects_allocated.load(std::memory_order_acquire); }
+
     inline void swap(fixed_size_free_list &lhs, fixed_size_free_list &rhs);
 
 private:
@@ -81,24 +103,42 @@ private:
 
     static_assert(alignof(storage_t) == alignof(T), "object not properly aligned");
 
+    //! per-thread cache of destroyed objects, padded to a cache-line to avoid false sharing
+    struct alignas(k_cache_line_size) cache_t
+    {
+        std::mutex mutex;
+
+        //! destroyed objects, linked via next_free_object
+        batch_t batch;
+    };
+
     /// Access the object storage given the object index
     inline const storage_t &get_storage(uint32_t object_index) const
     {
-        return m_pages[object_index >> m_page_shift][object_index & m_object_mask];
+        return m_pages.load(std::memory_order_acquire)[object_index >> m_page_shift][object_index & m_object_mask];
     }
     inline storage_t &get_storage(uint32_t object_index)
     {
-        return m_pages[object_index >> m_page_shift][object_index & m_object_mask];
+        return m_pages.load(std::memory_order_acquire)[object_index >> m_page_shift][object_index & m_object_mask];
     }
 
-    //! number of objects currently in the free list / new pages
-    CROCORE_IF_DEBUG(std::atomic<uint32_t> m_num_free_objects;)
+    //! lockless pop an object from the free list or from a new page, returns s_invalid_index if out of space
+    inline uint32_t pop_free();
+
+    //! lockless pop up to max_num_objects from the free list in a single atomic operation
+    inline batch_t pop_batch(uint32_t max_num_objects);
 
-    //! simple counter that makes the first free object pointer update with every CAS so that we don't suffer from the ABA problem
-    std::atomic<uint32_t> m_allocation_tag = 1;
+    //! lockless push a linked batch of (destructed) objects to the free list in a single atomic operation
+    inline void push_batch(const batch_t &batch);
 
-    //! index of first free object, the first 32 bits of an object are used to point to the next free object
-    std::atomic<uint64_t> m_first_free_object_and_tag = s_invalid_index;
+    //! allocate a new page and grow the page table if necessary, requires a lock on m_page_mutex
+    inline bool add_page();
+
+    //! number of live objects
+    CROCORE_IF_DEBUG(std::atomic<uint32_t> m_num_live_objects = 0;)
+
+    //! free objects, linked via next_free_object
+    tagged_index_list m_free_list;
 
     //! size (in objects) of a single page
     uint32_t m_page_size = 0;
@@ -109,17 +149,32 @@ private:
     //! mask to and an object index with to get the page number
     uint32_t m_object_mask = 0;
 
-    //! total number of pages that are usable
+    //! maximum number of pages
+    uint32_t m_max_num_pages = 0;
+
+    //! number of entries in the current page table
     uint32_t m_num_pages = 0;
 
     //! total number of objects allocated
-    uint32_t m_num_objects_allocated = 0;
+    std::atomic<uint32_t> m_num_objects_allocated = 0;
 
     //! first free object to use when the free list is empty (may need to allocate a new page)
     std::atomic<uint32_t> m_first_free_object_in_new_page = 0;
 
-    //! array of memory-pages
-    std::unique_ptr<storage_t *[]> m_pages = nullptr;
+    //! current page table, replaced by a copy of twice the size when full
+    std::atomic<storage_t **> m_pages = nullptr;
+
+    //! all page tables, previous ones are kept alive for concurrent readers
+    std::vector<std::unique_ptr<storage_t *[]>> m_page_tables;
+
+    //! number of objects cached per thread (0: disabled)
+    uint32_t m_cache_size = 0;
+
+    //! number of caches (pow2)
+    uint32_t m_num_caches = 0;
+
+    //! optional per-thread caches
+    std::unique_ptr<cache_t[]> m_caches;
 
     //! mutex used to allocate a new page if storage runs out
     std::mutex m_page_mutex;
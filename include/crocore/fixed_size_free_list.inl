@@ -8,18 +8,22 @@ inline void fixed_size_free_list<T>::swap(fixed_size_free_list &lhs, fixed_size_
     std::unique_lock<std::mutex> lock_lhs(lhs.m_page_mutex, std::adopt_lock);
     std::unique_lock<std::mutex> lock_rhs(rhs.m_page_mutex, std::adopt_lock);
 
-    CROCORE_IF_DEBUG(lhs.m_num_free_objects = rhs.m_num_free_objects.exchange(lhs.m_num_free_objects);)
-    lhs.m_allocation_tag = rhs.m_allocation_tag.exchange(lhs.m_allocation_tag);
-    lhs.m_first_free_object_and_tag = rhs.m_first_free_object_and_tag.exchange(lhs.m_first_free_object_and_tag);
+    CROCORE_IF_DEBUG(lhs.m_num_live_objects = rhs.m_num_live_objects.exchange(lhs.m_num_live_objects);)
+    lhs.m_free_list.swap(rhs.m_free_list);
     lhs.m_first_free_object_in_new_page =
             rhs.m_first_free_object_in_new_page.exchange(lhs.m_first_free_object_in_new_page);
+    lhs.m_num_objects_allocated = rhs.m_num_objects_allocated.exchange(lhs.m_num_objects_allocated);
+    lhs.m_pages = rhs.m_pages.exchange(lhs.m_pages);
 
     std::swap(lhs.m_page_size, rhs.m_page_size);
     std::swap(lhs.m_page_shift, rhs.m_page_shift);
     std::swap(lhs.m_object_mask, rhs.m_object_mask);
+    std::swap(lhs.m_max_num_pages, rhs.m_max_num_pages);
     std::swap(lhs.m_num_pages, rhs.m_num_pages);
-    std::swap(lhs.m_num_objects_allocated, rhs.m_num_objects_allocated);
-    std::swap(lhs.m_pages, rhs.m_pages);
+    std::swap(lhs.m_page_tables, rhs.m_page_tables);
+    std::swap(lhs.m_cache_size, rhs.m_cache_size);
+    std::swap(lhs.m_num_caches, rhs.m_num_caches);
+    std::swap(lhs.m_caches, rhs.m_caches);
 }
 
 template<typename T>
@@ -42,103 +46,147 @@ fixed_size_free_list<T>::~fixed_size_free_list()
     if(m_pages)
     {
         // Ensure everything is freed before the freelist is destructed
-        assert(m_num_free_objects.load(std::memory_order_relaxed) == m_num_pages * m_page_size);
+        assert(m_num_live_objects.load(std::memory_order_relaxed) == 0);
 
         // Free memory for pages
         uint32_t num_pages = m_num_objects_allocated / m_page_size;
-        for(uint32_t page = 0; page < num_pages; ++page) { crocore::aligned_free(m_pages[page]); }
+        storage_t **pages = m_pages;
+        for(uint32_t page = 0; page < num_pages; ++page) { crocore::aligned_free(pages[page]); }
     }
 }
 
 template<typename T>
-fixed_size_free_list<T>::fixed_size_free_list(uint32_t max_num_objects, uint32_t page_size)
+fixed_size_free_list<T>::fixed_size_free_list(uint32_t max_num_objects, uint32_t page_size, uint32_t cache_size)
 {
     // Check sanity
     assert(page_size > 0 && crocore::is_pow_2(page_size));
     assert(m_pages == nullptr);
 
-    // Store configuration parameters
-    m_num_pages = (max_num_objects + page_size - 1) / page_size;
+    // Store configuration parameters, the last index is reserved for s_invalid_index
+    uint64_t max_num_pages = (uint64_t(max_num_objects) + page_size - 1) / page_size;
+    m_max_num_pages = uint32_t(std::min<uint64_t>(max_num_pages, s_invalid_index / page_size));
     m_page_size = page_size;
     m_page_shift = std::countr_zero(page_size);
     m_object_mask = page_size - 1;
-    CROCORE_IF_DEBUG(m_num_free_objects = m_num_pages * page_size;)
 
-    // Allocate page table
-    m_pages.reset(new storage_t *[m_num_pages]);
+    // Allocate an initial page table, grown on demand
+    m_num_pages = std::min<uint32_t>(m_max_num_pages, 8);
+    m_page_tables.emplace_back(new storage_t *[std::max<uint32_t>(m_num_pages, 1)]);
+    m_pages = m_page_tables.back().get();
 
     // We didn't yet use any objects of any page
     m_num_objects_allocated = 0;
     m_first_free_object_in_new_page = 0;
 
-    // Start with 1 as the first tag
-    m_allocation_tag = 1;
+    // create per-thread caches
+    if(cache_size)
+    {
+        m_cache_size = cache_size;
+        m_num_caches = static_cast<uint32_t>(next_pow_2(std::max(1U, std::thread::hardware_concurrency())));
+        m_caches.reset(new cache_t[m_num_caches]);
+    }
+}
+
+template<typename T>
+bool fixed_size_free_list<T>::add_page()
+{
+    uint32_t next_page = m_num_objects_allocated / m_page_size;
+
+    // out of space
+    if(next_page == m_max_num_pages) { return false; }
+
+    // grow page table, previous tables stay valid for concurrent readers
+    if(next_page == m_num_pages)
+    {
+        uint32_t num_pages = uint32_t(std::min<uint64_t>(uint64_t(m_num_pages) * 2, m_max_num_pages));
+        auto *pages = new storage_t *[num_pages];
+        std::copy(m_pages.load(std::memory_order_relaxed), m_pages.load(std::memory_order_relaxed) + m_num_pages,
+                  pages);
+        m_page_tables.emplace_back(pages);
+        m_pages.store(pages, std::memory_order_release);
+        m_num_pages = num_pages;
+    }
 
-    // Set first free object (with tag 0)
-    m_first_free_object_and_tag = s_invalid_index;
+    m_pages.load(std::memory_order_relaxed)[next_page] = reinterpret_cast<storage_t *>(crocore::aligned_alloc(
+            m_page_size * sizeof(storage_t), std::max<size_t>(alignof(storage_t), k_cache_line_size)));
+    m_num_objects_allocated.fetch_add(m_page_size, std::memory_order_release);
+    return true;
 }
 
 template<typename T>
-template<typename... Parameters>
-uint32_t fixed_size_free_list<T>::create(Parameters &&...parameters)
+uint32_t fixed_size_free_list<T>::pop_free()
 {
-    for(;;)
+    // Get first object from the linked list
+    uint32_t first_free = m_free_list.pop([this](uint32_t object_index) {
+        return get_storage(object_index).next_free_object.load(std::memory_order_acquire);
+    });
+    if(first_free != s_invalid_index) { return first_free; }
+
+    // The free list is empty, we take an object from the page that has never been used before
+    first_free = m_first_free_object_in_new_page.fetch_add(1, std::memory_order_relaxed);
+    if(first_free >= m_num_objects_allocated.load(std::memory_order_acquire))
     {
-        // Get first object from the linked list
-        uint64_t first_free_object_and_tag = m_first_free_object_and_tag.load(std::memory_order_acquire);
-        auto first_free = uint32_t(first_free_object_and_tag);
-        if(first_free == s_invalid_index)
+        // Allocate new page
+        std::lock_guard lock(m_page_mutex);
+        while(first_free >= m_num_objects_allocated.load(std::memory_order_relaxed))
         {
-            // The free list is empty, we take an object from the page that has never been used before
-            first_free = m_first_free_object_in_new_page.fetch_add(1, std::memory_order_relaxed);
-            if(first_free >= m_num_objects_allocated)
-            {
-                // Allocate new page
-                std::lock_guard lock(m_page_mutex);
-                while(first_free >= m_num_objects_allocated)
-                {
-                    uint32_t next_page = m_num_objects_allocated / m_page_size;
-
-                    // out of space
-                    if(next_page == m_num_pages) { return s_invalid_index; }
-
-                    m_pages[next_page] = reinterpret_cast<storage_t *>(crocore::aligned_alloc(
-                            m_page_size * sizeof(storage_t), std::max<size_t>(alignof(storage_t), k_cache_line_size)));
-                    m_num_objects_allocated += m_page_size;
-                }
-            }
+            if(!add_page()) { return s_invalid_index; }
+        }
+    }
+    return first_free;
+}
 
-            // Allocation successful
-            CROCORE_IF_DEBUG(m_num_free_objects.fetch_sub(1, std::memory_order_relaxed);)
+template<typename T>
+typename fixed_size_free_list<T>::batch_t fixed_size_free_list<T>::pop_batch(uint32_t max_num_objects)
+{
+    auto batch = m_free_list.pop_batch(max_num_objects, [this](uint32_t object_index) {
+        return get_storage(object_index).next_free_object.load(std::memory_order_acquire);
+    });
+    return {batch.first, batch.last, batch.num};
+}
 
-            storage_t &storage = get_storage(first_free);
-            ::new(&storage.object) T(std::forward<Parameters>(parameters)...);
-            storage.next_free_object.store(first_free, std::memory_order_release);
-            return first_free;
-        }
-        else
-        {
-            // Load next pointer
-            uint32_t new_first_free = get_storage(first_free).next_free_object.load(std::memory_order_acquire);
+template<typename T>
+template<typename... Parameters>
+uint32_t fixed_size_free_list<T>::create(Parameters &&...parameters)
+{
+    uint32_t object_index = s_invalid_index;
+
+    if(m_caches)
+    {
+        auto &cache = m_caches[thread_index() & (m_num_caches - 1)];
+        std::unique_lock lock(cache.mutex);
 
-            // Construct a new first free object tag
-            uint64_t new_first_free_object_and_tag =
-                    uint64_t(new_first_free) +
-                    (uint64_t(m_allocation_tag.fetch_add(1, std::memory_order_relaxed)) << 32);
+        // refill with a batch from the free list
+        if(!cache.batch.m_num_objects) { cache.batch = pop_batch(std::max<uint32_t>(m_cache_size / 2, 1)); }
 
-            // Compare and swap
-            if(m_first_free_object_and_tag.compare_exchange_weak(
-                       first_free_object_and_tag, new_first_free_object_and_tag, std::memory_order_release))
+        if(cache.batch.m_num_objects)
+        {
+            object_index = cache.batch.m_first_object_index;
+            if(--cache.batch.m_num_objects)
             {
-                // Allocation successful
-                CROCORE_IF_DEBUG(m_num_free_objects.fetch_sub(1, std::memory_order_relaxed);)
-                storage_t &storage = get_storage(first_free);
-                ::new(&storage.object) T(std::forward<Parameters>(parameters)...);
-                storage.next_free_object.store(first_free, std::memory_order_release);
-                return first_free;
+                cache.batch.m_first_object_index =
+                        get_storage(object_index).next_free_object.load(std::memory_order_relaxed);
             }
+            else { cache.batch = {}; }
         }
     }
+    if(object_index == s_invalid_index) { object_index = pop_free(); }
+
+    // out of space, destroyed objects might still sit in other threads' caches
+    if(object_index == s_invalid_index && m_caches)
+    {
+        flush_caches();
+        object_index = pop_free();
+    }
+    if(object_index == s_invalid_index) { return s_invalid_index; }
+
+    // Allocation successful
+    CROCORE_IF_DEBUG(m_num_live_objects.fetch_add(1, std::memory_order_relaxed);)
+
+    storage_t &storage = get_storage(object_index);
+    ::new(&storage.object) T(std::forward<Parameters>(parameters)...);
+    storage.next_free_object.store(object_index, std::memory_order_release);
+    return object_index;
 }
 
 template<typename T>
@@ -157,6 +205,15 @@ void fixed_size_free_list<T>::add_to_batch(batch_t &batch, uint32_t object_index
     batch.m_num_objects++;
 }
 
+template<typename T>
+void fixed_size_free_list<T>::push_batch(const batch_t &batch)
+{
+    m_free_list.push_batch(batch.m_first_object_index, batch.m_last_object_index,
+                           [this](uint32_t object_index, uint32_t next) {
+                               get_storage(object_index).next_free_object.store(next, std::memory_order_release);
+                           });
+}
+
 template<typename T>
 void fixed_size_free_list<T>::destroy_batch(batch_t &batch)
 {
@@ -166,43 +223,24 @@ void fixed_size_free_list<T>::destroy_batch(batch_t &batch)
         if constexpr(!std::is_trivially_destructible<T>())
         {
             uint32_t object_idx = batch.m_first_object_index;
-            do {
+            for(uint32_t i = 0; i < batch.m_num_objects; ++i)
+            {
                 storage_t &storage = get_storage(object_idx);
-                storage.object.~Object();
+                storage.object.~T();
                 object_idx = storage.next_free_object.load(std::memory_order_relaxed);
-            } while(object_idx != s_invalid_index);
+            }
         }
 
         // add to objects free list
-        storage_t &storage = GetStorage(batch.m_last_object_index);
-        for(;;)
-        {
-            // get first object from the list
-            uint64_t first_free_object_and_tag = m_first_free_object_and_tag.load(std::memory_order_acquire);
-            auto first_free = uint32_t(first_free_object_and_tag);
-
-            // make it the next pointer of the last object in the batch that is to be freed
-            storage.next_free_object.store(first_free, std::memory_order_release);
+        push_batch(batch);
 
-            // construct a new first free object tag
-            uint64_t new_first_free_object_and_tag =
-                    uint64(batch.m_first_object_index) +
-                    (uint64_t(m_allocation_tag.fetch_add(1, std::memory_order_relaxed)) << 32);
+        // free successful
+        CROCORE_IF_DEBUG(m_num_live_objects.fetch_sub(batch.m_num_objects, std::memory_order_relaxed);)
 
-            // compare and swap
-            if(m_first_free_object_and_tag.compare_exchange_weak(
-                       first_free_object_and_tag, new_first_free_object_and_tag, std::memory_order_release))
-            {
-                // free successful
-                CROCORE_IF_DEBUG(m_num_free_objects.fetch_add(batch.m_num_objects, std::memory_order_relaxed);)
-
-                // mark batch as freed
+        // mark batch as freed
 #if not defined(NDEBUG)
-                batch.m_num_objects = s_invalid_index;
+        batch.m_num_objects = s_invalid_index;
 #endif
-                return;
-            }
-        }
     }
 }
 
@@ -214,30 +252,25 @@ void fixed_size_free_list<T>::destroy(uint32_t object_index)
     // call destructor
     storage_t &storage = get_storage(object_index);
     storage.object.~T();
+    CROCORE_IF_DEBUG(m_num_live_objects.fetch_sub(1, std::memory_order_relaxed);)
 
-    // add to object free list
-    for(;;)
+    if(m_caches)
     {
-        // Get first object from the list
-        uint64_t first_free_object_and_tag = m_first_free_object_and_tag.load(std::memory_order_acquire);
-        auto first_free = uint32_t(first_free_object_and_tag);
-
-        // make it the next pointer of the last object in the batch that is to be freed
-        storage.next_free_object.store(first_free, std::memory_order_release);
-
-        // construct a new first free object tag
-        uint64_t new_first_free_object_and_tag =
-                uint64_t(object_index) + (uint64_t(m_allocation_tag.fetch_add(1, std::memory_order_relaxed)) << 32);
+        auto &cache = m_caches[thread_index() & (m_num_caches - 1)];
+        std::unique_lock lock(cache.mutex);
+        add_to_batch(cache.batch, object_index);
 
-        // compare and swap
-        if(m_first_free_object_and_tag.compare_exchange_weak(first_free_object_and_tag, new_first_free_object_and_tag,
-                                                             std::memory_order_release))
+        // cache is full, hand back as a batch
+        if(cache.batch.m_num_objects >= m_cache_size)
         {
-            // free successful
-            CROCORE_IF_DEBUG(m_num_free_objects.fetch_add(1, std::memory_order_relaxed);)
-            return;
+            push_batch(cache.batch);
+            cache.batch = {};
         }
+        return;
     }
+
+    // add to object free list
+    push_batch({object_index, object_index, 1});
 }
 
 template<typename T>
@@ -248,4 +281,20 @@ inline void fixed_size_free_list<T>::destroy(T *object)
     destroy(index);
 }
 
+template<typename T>
+void fixed_size_free_list<T>::flush_caches()
+{
+    for(uint32_t i = 0; i < m_num_caches; ++i)
+    {
+        auto &cache = m_caches[i];
+        std::unique_lock lock(cache.mutex);
+
+        if(cache.batch.m_num_objects)
+        {
+            push_batch(cache.batch);
+            cache.batch = {};
+        }
+    }
+}
+
 }// namespace crocore
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace crocore
+{
+
+/// Head of a lock free, intrusive list (LIFO) of 32-bit indices.
+/// The first index is stored together with a tag in a single 64-bit word. The tag changes with every CAS,
+/// so we don't suffer from the ABA problem.
+///
+/// Links are owned by the client and accessed via function objects, so the list can be threaded through
+/// arbitrary storage (e.g. pages of objects or slabs). While popping, the link of an element might be read
+/// while the element is concurrently handed out by another thread, in which case the CAS fails.
+/// Links therefore need to be read and written atomically (e.g. using std::atomic_ref).
+class tagged_index_list
+{
+public:
+    //! invalid index, marks the end of the list
+    static constexpr uint32_t s_invalid_index = std::numeric_limits<uint32_t>::max();
+
+    //! a linked batch of elements, popped or pushed in a single atomic operation
+    struct batch_t
+    {
+        uint32_t first = s_invalid_index;
+        uint32_t last = s_invalid_index;
+        uint32_t num = 0;
+    };
+
+    //! returns true, if the list was empty at the time of the call
+    [[nodiscard]] inline bool empty() const
+    {
+        return uint32_t(m_first_and_tag.load(std::memory_order_acquire)) == s_invalid_index;
+    }
+
+    //! remove all elements, not thread-safe
+    inline void clear() { m_first_and_tag.store(s_invalid_index, std::memory_order_relaxed); }
+
+    /**
+     * @brief   lockless pop up to max_num elements in a single atomic operation.
+     *
+     * @param   max_num     maximum number of elements to pop.
+     * @param   load_next   function object, returning the link stored for an index: uint32_t(uint32_t)
+     * @return  the popped batch, batch_t::num is 0 if the list was empty. the link of the last element is stale.
+     */
+    template<typename LoadNextFn>
+    inline batch_t pop_batch(uint32_t max_num, LoadNextFn &&load_next)
+    {
+        for(;;)
+        {
+            uint64_t first_and_tag = m_first_and_tag.load(std::memory_order_acquire);
+            auto first = uint32_t(first_and_tag);
+            if(first == s_invalid_index) { return {}; }
+
+            // follow the links, values might be stale if the list changes concurrently, the CAS will fail then
+            batch_t batch = {first, first, 1};
+            uint32_t new_first = load_next(first);
+
+            while(batch.num < max_num && new_first != s_invalid_index)
+            {
+                batch.last = new_first;
+                batch.num++;
+                new_first = load_next(new_first);
+            }
+
+            if(m_first_and_tag.compare_exchange_weak(first_and_tag, tagged(new_first), std::memory_order_acq_rel))
+            {
+                return batch;
+            }
+        }
+    }
+
+    //! lockless pop a single element, returns s_invalid_index if the list was empty
+    template<typename LoadNextFn>
+    inline uint32_t pop(LoadNextFn &&load_next)
+    {
+        return pop_batch(1, std::forward<LoadNextFn>(load_next)).first;
+    }
+
+    /**
+     * @brief   lockless push a linked batch of elements in a single atomic operation.
+     *
+     * @param   first       index of the first element in the batch.
+     * @param   last        index of the last element in the batch, elements in between are already linked.
+     * @param   store_next  function object, storing the link for an index: void(uint32_t index, uint32_t next)
+     */
+    template<typename StoreNextFn>
+    inline void push_batch(uint32_t first, uint32_t last, StoreNextFn &&store_next)
+    {
+        for(;;)
+        {
+            uint64_t first_and_tag = m_first_and_tag.load(std::memory_order_acquire);
+
+            // make the current first element the next of the last element in the batch
+            store_next(last, uint32_t(first_and_tag));
+
+            if(m_first_and_tag.compare_exchange_weak(first_and_tag, tagged(first), std::memory_order_release))
+            {
+                return;
+            }
+        }
+    }
+
+    //! lockless push a single element
+    template<typename StoreNextFn>
+    inline void push(uint32_t index, StoreNextFn &&store_next)
+    {
+        push_batch(index, index, std::forward<StoreNextFn>(store_next));
+    }
+
+    //! exchange the contents of two lists, not thread-safe
+    inline void swap(tagged_index_list &other)
+    {
+        m_tag = other.m_tag.exchange(m_tag);
+        m_first_and_tag = other.m_first_and_tag.exchange(m_first_and_tag);
+    }
+
+private:
+    //! combine an index with a new tag
+    inline uint64_t tagged(uint32_t index)
+    {
+        return uint64_t(index) + (uint64_t(m_tag.fetch_add(1, std::memory_order_relaxed)) << 32);
+    }
+
+    //! simple counter that makes the first index update with every CAS
+    std::atomic<uint32_t> m_tag = 1;
+
+    //! first index (lower 32 bits) and tag (upper 32 bits)
+    std::atomic<uint64_t> m_first_and_tag = s_invalid_index;
+};
+
+}// namespace crocore
@@ -14,6 +14,7 @@
 #pragma once
 
 #include "crocore.hpp"
+#include <atomic>
 #include <iomanip>
 #include <memory>
 #include <numeric>
@@ -23,6 +24,9 @@
 namespace crocore
 {
 
+//! assumed size of a cache-line in bytes, used for padding/alignment
+constexpr uint32_t k_cache_line_size = 64;
+
 #ifdef NDEBUG
 #define CROCORE_IF_DEBUG(...)
 #else
@@ -176,6 +180,21 @@ inline constexpr uint64_t next_pow_2(uint64_t v)
     return v;
 }
 
+/**
+ * @brief   Returns a small, process-wide unique index for the calling thread.
+ *          Indices are handed out sequentially, starting with 0.
+ *          Useful to map threads to sharded, per-thread data-structures.
+ */
+inline uint32_t thread_index()
+{
+    static std::atomic<uint32_t> s_num_threads = 0;
+    thread_local uint32_t index = s_num_threads.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+//! round a value up to the next multiple of a power-of-two alignment
+inline constexpr size_t align_up(size_t v, size_t alignment) { return (v + alignment - 1) & ~(alignment - 1); }
+
 template<typename T>
 inline T swap_endian(T u)
 {
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace crocore::virtual_memory
+{
+
+//! page-sizes used to back a mapping
+enum class PageMode : uint32_t
+{
+    //! regular pages
+    DEFAULT = 0,
+
+    //! mapping is aligned to huge_page_size() and marked as eligible for transparent huge pages
+    HUGE_TRANSPARENT,
+
+    //! explicit huge pages (MAP_HUGETLB), falls back to HUGE_TRANSPARENT if no huge pages are reserved
+    HUGE_EXPLICIT
+};
+
+//! returns the size of a regular page in bytes.
+size_t page_size();
+
+//! returns the size of a huge page in bytes.
+size_t huge_page_size();
+
+/**
+ * @brief   Map a range of anonymous, zero-initialized memory.
+ *
+ * @param   num_bytes   the requested number of bytes, will be rounded up to a multiple of the page-size.
+ * @param   mode        the page-mode used for the mapping.
+ * @return  a pointer to the beginning of the mapping or nullptr if the mapping failed.
+ */
+void *map(size_t num_bytes, PageMode mode = PageMode::DEFAULT);
+
+/**
+ * @brief   Unmap a range of memory, previously returned by map().
+ *
+ * @param   ptr a pointer to the beginning of a mapping.
+ */
+void unmap(void *ptr);
+
+//! returns true, if ptr is the beginning of a mapping returned by map().
+bool is_mapped(const void *ptr);
+
+/**
+ * @brief   Return the physical pages backing a range of memory to the operating system,
+ *          while keeping the address-range valid (madvise).
+ *          The range must be part of a mapping returned by map(), heap-memory is not supported on all platforms.
+ *
+ *          Only pages entirely contained in the range are released. Subsequent reads return zeros,
+ *          unless lazy release was requested and the pages were not reclaimed yet.
+ *
+ * @param   ptr         pointer to the beginning of the range.
+ * @param   num_bytes   size of the range in bytes.
+ * @param   lazy        pages are only reclaimed under memory-pressure (MADV_FREE), if supported.
+ * @return  the number of bytes released.
+ */
+size_t release(void *ptr, size_t num_bytes, bool lazy = false);
+
+/**
+ * @brief   Returns a function object suitable as alloc_fn for BuddyPool or MemoryCache.
+ *          Use unmap() as corresponding dealloc_fn.
+ *
+ * @param   mode    the page-mode used for all mappings.
+ * @return  a function object, mapping memory.
+ */
+inline std::function<void *(size_t)> alloc_fn(PageMode mode)
+{
+    return [mode](size_t num_bytes) { return map(num_bytes, mode); };
+}
+
+}// namespace crocore::virtual_memory
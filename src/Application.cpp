@@ -36,6 +36,10 @@ Application::Application(const create_info_t &create_info) :
     shutdown_handler = [app = this](int){ app->running = false; };
     signal(SIGINT, signal_handler);
     m_args = create_info.arguments;
+
+    crocore::MonotonicArena::create_info_t arena_info = {};
+    arena_info.chunk_size = create_info.frame_arena_chunk_size;
+    for(auto &arena: m_frame_arenas){ arena = crocore::MonotonicArena::create(arena_info); }
 }
 
 int Application::run()
@@ -66,6 +70,10 @@ int Application::run()
         // call update callback
         update(time_delta);
 
+        // swap per-frame arenas, recycling allocations from the previous frame
+        m_frame_index = (m_frame_index + 1) % m_frame_arenas.size();
+        m_frame_arenas[m_frame_index]->reset();
+
         m_last_timestamp = time_stamp;
 
         // perform fps-timing
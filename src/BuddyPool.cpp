@@ -1,9 +1,13 @@
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstring>
 #include <cmath>
+#include <thread>
 
 #include "crocore/utils.hpp"
 #include "crocore/BuddyPool.hpp"
+#include "crocore/virtual_memory.hpp"
 
 
 //! internal namespace for binary-tree utils
@@ -22,6 +26,8 @@ inline size_t buddy(size_t index){ return index > 0 ? index - 1 + (index & 1UL)
 
 inline bool is_left(size_t index){ return index & 1; }
 
+inline size_t level(size_t index){ return std::bit_width(index + 1) - 1; }
+
 inline size_t index_offset(size_t index, size_t level, size_t max_level)
 {
     return ((index + 1) - (size_t(1UL) << level)) << (max_level - level);
@@ -42,14 +48,84 @@ enum class NodeState : uint8_t
     FULL = 3,
 };
 
+/**
+ * @brief   bitmap_tree_t is an alternative representation of a binary buddy-tree.
+ *
+ *          For each size-order a bitmap marks all free nodes of that order.
+ *          Searching a free node is a countr_zero-scan over a summary- and a word-bitmap,
+ *          splitting and merging nodes boil down to a few bit-operations.
+ */
+struct bitmap_tree_t
+{
+    //! per size-order bitmaps, bit i is set if node i of that order is free
+    std::unique_ptr<uint64_t[]> words = nullptr;
+
+    //! per size-order summaries, bit w is set if words[w] is non-zero
+    std::unique_ptr<uint64_t[]> summary = nullptr;
+
+    //! per size-order offsets into words and summary
+    std::unique_ptr<size_t[]> word_offsets = nullptr, summary_offsets = nullptr;
+
+    //! per leaf, size-order + 1 for the start of an allocation, 0 otherwise
+    std::unique_ptr<uint8_t[]> alloc_orders = nullptr;
+};
+
+/**
+ * @brief   block_guard_t guards a single toplevel block, used with create_info_t::block_locks.
+ */
+struct block_guard_t
+{
+    std::mutex mutex;
+
+    //! copy of the block's free_mask, readable without holding the mutex
+    std::atomic<uint64_t> free_mask = 0;
+};
+
 /**
  * @brief   block_t holds a block of memory along with a binary-tree for it's management.
+ *          The tree is either stored as array of NodeState values (tree) or as per-level bitmaps (bitmap).
  */
 struct block_t
 {
     uint32_t height = 0;
     std::unique_ptr<uint8_t, std::function<void(void *)>> data = nullptr;
     std::unique_ptr<NodeState[]> tree = nullptr;
+    bitmap_tree_t bitmap;
+
+    //! number of free nodes per size-order
+    std::unique_ptr<uint32_t[]> num_free = nullptr;
+
+    //! bit k is set, if a free node of size-order k exists
+    uint64_t free_mask = 0;
+
+    //! total number of free leaves (unit is a sub-block of minBlockSize)
+    size_t num_free_leaves = 0;
+
+    //! size-order of the index-bucket this block is currently stored in (tree::INDEX_MAX: none)
+    size_t index_order = tree::INDEX_MAX;
+
+    //! position within its index-bucket
+    size_t index_pos = 0;
+
+    //! stable index of this block, encoded in allocation-handles
+    uint32_t slot = 0;
+
+    //! optional per-block lock
+    std::unique_ptr<block_guard_t> guard = nullptr;
+
+    //! data is backed by a mapping from virtual_memory::map(), free pages can be released
+    bool mapped = false;
+};
+
+/**
+ * @brief   magazine_t caches blocks per size-order, it is padded to a cache-line to avoid false sharing.
+ */
+struct alignas(k_cache_line_size) magazine_t
+{
+    std::mutex mutex;
+
+    //! cached pointers, indexed by size-order
+    std::vector<std::vector<void *>> blocks;
 };
 
 //! create new binary tree
@@ -65,15 +141,140 @@ block_t buddy_create(size_t height);
  */
 size_t buddy_alloc(block_t &b, size_t size);
 
-void buddy_free(block_t &b, size_t offset);
+/**
+ * @brief   Free an existing allocation, merging it with free buddies.
+ *
+ * @param   b       a block_t object, containing a binary tree.
+ * @param   offset  the internal offset of an allocation (unit is a sub-block of minBlockSize)
+ * @return  the size-order of the resulting free node, containing the allocation,
+ *          or tree::INDEX_MAX, if no allocation starts at the provided offset.
+ */
+size_t buddy_free(block_t &b, size_t offset);
+
+/**
+ * @brief   Query the size-order of an existing allocation.
+ *
+ * @param   b       a block_t object, containing a binary tree.
+ * @param   offset  the internal offset of an allocation (unit is a sub-block of minBlockSize)
+ * @return  the size-order (log2 of the number of sub-blocks) of the allocation,
+ *          or tree::INDEX_MAX, if no allocation exists at the provided offset.
+ */
+size_t buddy_order(const block_t &b, size_t offset);
+
+size_t buddy_combine(block_t &b, size_t index);
 
-void buddy_combine(block_t &b, size_t index);
+//! adjust the number of free nodes for a size-order
+inline void buddy_count_free(block_t &b, size_t order, int32_t delta)
+{
+    b.num_free[order] += delta;
+    b.num_free_leaves += static_cast<size_t>(int64_t(delta) * (int64_t(1) << order));
+    if(b.num_free[order]){ b.free_mask |= uint64_t(1) << order; }
+    else{ b.free_mask &= ~(uint64_t(1) << order); }
+}
+
+//! return the largest size-order, for which a free node exists, or tree::INDEX_MAX if the block is full.
+inline size_t buddy_max_free_order(const block_t &b)
+{
+    return b.free_mask ? std::bit_width(b.free_mask) - 1 : tree::INDEX_MAX;
+}
 
 void buddy_mark_parent(block_t &b, size_t index);
 
+/**
+ * @brief   Resize an existing allocation in place.
+ *          Shrinking splits off the unused halves, growing merges with free buddies.
+ *
+ * @param   b           a block_t object, containing a binary tree.
+ * @param   offset      the internal offset of an allocation (unit is a sub-block of minBlockSize)
+ * @param   order       the current size-order of the allocation.
+ * @param   new_order   the requested size-order of the allocation.
+ * @return  true, if the allocation could be resized in place.
+ */
+bool buddy_resize(block_t &b, size_t offset, size_t order, size_t new_order);
+
 void buddy_collect_allocations(const block_t &b, size_t index, size_t level,
                                size_t minBlockSize, std::map<size_t, size_t> &allocations);
 
+/**
+ * @brief   Find the first allocation, starting at or after a leaf-offset.
+ *
+ * @param   b       a block_t object, containing a binary tree.
+ * @param   offset  the leaf-offset to start searching at.
+ * @param   order   returns the size-order of the allocation.
+ * @return  the leaf-offset of the allocation or tree::INDEX_MAX, if none exists.
+ */
+size_t buddy_next_allocation(const block_t &b, size_t index, size_t level, size_t left, size_t offset,
+                             size_t &order);
+
+//! create a new block, using per-level bitmaps
+block_t bitmap_create(size_t height);
+
+//! bitmap counterpart of buddy_alloc
+size_t bitmap_alloc(block_t &b, size_t size);
+
+//! bitmap counterpart of buddy_free
+size_t bitmap_free(block_t &b, size_t offset);
+
+//! bitmap counterpart of buddy_order
+size_t bitmap_order(const block_t &b, size_t offset);
+
+//! bitmap counterpart of buddy_collect_allocations
+void bitmap_collect_allocations(const block_t &b, size_t minBlockSize, std::map<size_t, size_t> &allocations);
+
+//! bitmap counterpart of buddy_resize
+bool bitmap_resize(block_t &b, size_t offset, size_t order, size_t new_order);
+
+//! bitmap counterpart of buddy_next_allocation
+size_t bitmap_next_allocation(const block_t &b, size_t offset, size_t &order);
+
+//! returns true if no allocations exist in a block
+inline bool block_empty(const block_t &b){ return b.num_free[b.height] == 1; }
+
+//! dispatch an allocation to the block's tree-representation
+inline size_t block_alloc(block_t &b, size_t size){ return b.tree ? buddy_alloc(b, size) : bitmap_alloc(b, size); }
+
+//! dispatch a de-allocation to the block's tree-representation
+inline size_t block_free(block_t &b, size_t offset)
+{
+    return b.tree ? buddy_free(b, offset) : bitmap_free(b, offset);
+}
+
+//! dispatch a de-allocation with known size-order, skipping the tree-descent
+inline size_t block_free(block_t &b, size_t offset, size_t order)
+{
+    if(!b.tree){ return bitmap_free(b, offset); }
+    assert(buddy_order(b, offset) == order);
+
+    // node-index of the allocation, derived from its level and offset
+    size_t level = b.height - order;
+    return buddy_combine(b, (size_t(1) << level) - 1 + (offset >> order));
+}
+
+//! dispatch a size-order query to the block's tree-representation
+inline size_t block_order(const block_t &b, size_t offset)
+{
+    return b.tree ? buddy_order(b, offset) : bitmap_order(b, offset);
+}
+
+//! dispatch an in-place resize to the block's tree-representation
+inline bool block_resize(block_t &b, size_t offset, size_t order, size_t new_order)
+{
+    return b.tree ? buddy_resize(b, offset, order, new_order) : bitmap_resize(b, offset, order, new_order);
+}
+
+//! dispatch searching the next allocation to the block's tree-representation
+inline size_t block_next_allocation(const block_t &b, size_t offset, size_t &order)
+{
+    return b.tree ? buddy_next_allocation(b, 0, 0, 0, offset, order) : bitmap_next_allocation(b, offset, order);
+}
+
+//! dispatch collecting all allocations to the block's tree-representation
+inline void block_collect_allocations(const block_t &b, size_t minBlockSize, std::map<size_t, size_t> &allocations)
+{
+    if(b.tree){ buddy_collect_allocations(b, 0, 0, minBlockSize, allocations); }
+    else{ bitmap_collect_allocations(b, minBlockSize, allocations); }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 block_t buddy_create(size_t height)
@@ -83,6 +284,8 @@ block_t buddy_create(size_t height)
     ret.height = static_cast<uint32_t>(height);
     ret.tree = std::unique_ptr<NodeState[]>(new NodeState[num_leaves * 2 - 1]);
     memset(ret.tree.get(), static_cast<uint8_t>(NodeState::UNUSED), num_leaves * 2 - 1);
+    ret.num_free = std::unique_ptr<uint32_t[]>(new uint32_t[height + 1]());
+    buddy_count_free(ret, height, 1);
     return ret;
 }
 
@@ -122,6 +325,7 @@ size_t buddy_alloc(block_t &b, size_t size)
             if(b.tree[index] == NodeState::UNUSED)
             {
                 b.tree[index] = NodeState::USED;
+                buddy_count_free(b, b.height - level, -1);
                 buddy_mark_parent(b, index);
 
                 return tree::index_offset(index, level, b.height);
@@ -140,6 +344,8 @@ size_t buddy_alloc(block_t &b, size_t size)
                     b.tree[index] = NodeState::SPLIT;
                     b.tree[tree::left(index)] = NodeState::UNUSED;
                     b.tree[tree::right(index)] = NodeState::UNUSED;
+                    buddy_count_free(b, b.height - level, -1);
+                    buddy_count_free(b, b.height - level - 1, 2);
                     [[fallthrough]];
                 case NodeState::SPLIT:index = tree::left(index);
                     length /= 2;
@@ -172,8 +378,10 @@ size_t buddy_alloc(block_t &b, size_t size)
     }
 }
 
-void buddy_combine(block_t &b, size_t index)
+size_t buddy_combine(block_t &b, size_t index)
 {
+    size_t order = b.height - tree::level(index);
+
     for(;;)
     {
         size_t buddy = tree::buddy(index);
@@ -181,23 +389,30 @@ void buddy_combine(block_t &b, size_t index)
         if(!buddy || b.tree[buddy] != NodeState::UNUSED)
         {
             b.tree[index] = NodeState::UNUSED;
+            buddy_count_free(b, order, 1);
 
             index = tree::parent(index);
 
-            while(tree::buddy(index) && b.tree[index] == NodeState::FULL)
+            // ancestors are not full anymore, including the root
+            while(b.tree[index] == NodeState::FULL)
             {
                 b.tree[index] = NodeState::SPLIT;
+                if(!index){ break; }
                 index = tree::parent(index);
             }
-            return;
+            return order;
         }
+
+        // merge with free buddy
+        buddy_count_free(b, order, -1);
         index = tree::parent(index);
+        order++;
     }
 }
 
-void buddy_free(block_t &b, size_t offset)
+size_t buddy_free(block_t &b, size_t offset)
 {
-    assert(offset < (size_t(1UL) << b.height));
+    if(offset >= (size_t(1UL) << b.height)){ return tree::INDEX_MAX; }
 
     size_t left = 0;
     size_t length = size_t(1UL) << b.height;
@@ -207,12 +422,10 @@ void buddy_free(block_t &b, size_t offset)
     {
         switch(b.tree[index])
         {
-            case NodeState::USED:assert(offset == left);
-                buddy_combine(b, index);
-                return;
+            // interior offsets are not allocated
+            case NodeState::USED:return offset == left ? buddy_combine(b, index) : tree::INDEX_MAX;
 
-            case NodeState::UNUSED:assert(0);
-                return;
+            case NodeState::UNUSED:return tree::INDEX_MAX;
 
             case NodeState::SPLIT:
             case NodeState::FULL:length /= 2;
@@ -228,6 +441,87 @@ void buddy_free(block_t &b, size_t offset)
     }
 }
 
+size_t buddy_order(const block_t &b, size_t offset)
+{
+    if(offset >= (size_t(1UL) << b.height)){ return tree::INDEX_MAX; }
+
+    size_t left = 0;
+    size_t level = 0;
+    size_t index = 0;
+
+    for(;;)
+    {
+        size_t length = size_t(1UL) << (b.height - level);
+
+        switch(b.tree[index])
+        {
+            case NodeState::USED:return offset == left ? b.height - level : tree::INDEX_MAX;
+
+            case NodeState::UNUSED:return tree::INDEX_MAX;
+
+            case NodeState::SPLIT:
+            case NodeState::FULL:length /= 2;
+                level++;
+
+                if(offset < left + length){ index = tree::left(index); }
+                else
+                {
+                    left += length;
+                    index = tree::right(index);
+                }
+                break;
+        }
+    }
+}
+
+bool buddy_resize(block_t &b, size_t offset, size_t order, size_t new_order)
+{
+    if(new_order > b.height){ return false; }
+
+    // node-index of the existing allocation
+    size_t index = (size_t(1) << (b.height - order)) - 1 + (offset >> order);
+    assert(b.tree[index] == NodeState::USED);
+
+    if(new_order < order)
+    {
+        // ancestors are not full anymore
+        for(size_t i = index; i && b.tree[tree::parent(i)] == NodeState::FULL; i = tree::parent(i))
+        {
+            b.tree[tree::parent(i)] = NodeState::SPLIT;
+        }
+
+        // split down, right halves become free
+        for(; order > new_order; --order)
+        {
+            b.tree[index] = NodeState::SPLIT;
+            b.tree[tree::right(index)] = NodeState::UNUSED;
+            buddy_count_free(b, order - 1, 1);
+            index = tree::left(index);
+        }
+        b.tree[index] = NodeState::USED;
+        return true;
+    }
+
+    // growing requires a left node and free buddies all the way up
+    size_t parent = index;
+
+    for(size_t o = order; o < new_order; ++o)
+    {
+        if(!tree::is_left(parent) || b.tree[tree::buddy(parent)] != NodeState::UNUSED){ return false; }
+        parent = tree::parent(parent);
+    }
+
+    // merge upward, consuming the free buddies
+    for(; order < new_order; ++order)
+    {
+        buddy_count_free(b, order, -1);
+        index = tree::parent(index);
+    }
+    b.tree[index] = NodeState::USED;
+    buddy_mark_parent(b, index);
+    return true;
+}
+
 void buddy_collect_allocations(const block_t &b, size_t index, size_t level,
                                size_t minBlockSize, std::map<size_t, size_t> &allocations)
 {
@@ -248,6 +542,239 @@ void buddy_collect_allocations(const block_t &b, size_t index, size_t level,
     }
 }
 
+size_t buddy_next_allocation(const block_t &b, size_t index, size_t level, size_t left, size_t offset,
+                             size_t &order)
+{
+    size_t length = size_t(1) << (b.height - level);
+
+    // node ends before offset
+    if(left + length <= offset){ return tree::INDEX_MAX; }
+
+    switch(b.tree[index])
+    {
+        case NodeState::USED:
+            if(left < offset){ return tree::INDEX_MAX; }
+            order = b.height - level;
+            return left;
+
+        case NodeState::UNUSED:return tree::INDEX_MAX;
+
+        case NodeState::SPLIT:
+        case NodeState::FULL:
+        {
+            size_t ret = buddy_next_allocation(b, tree::left(index), level + 1, left, offset, order);
+            if(ret != tree::INDEX_MAX){ return ret; }
+            return buddy_next_allocation(b, tree::right(index), level + 1, left + length / 2, offset, order);
+        }
+    }
+    return tree::INDEX_MAX;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+//! set/clear bit i of a size-order, keep summary in sync
+inline void bitmap_set(bitmap_tree_t &bm, size_t order, size_t i, bool value)
+{
+    uint64_t &word = bm.words[bm.word_offsets[order] + (i >> 6U)];
+    uint64_t &summary = bm.summary[bm.summary_offsets[order] + (i >> 12U)];
+    uint64_t summary_bit = uint64_t(1) << ((i >> 6U) & 63U);
+
+    if(value)
+    {
+        word |= uint64_t(1) << (i & 63U);
+        summary |= summary_bit;
+    }
+    else
+    {
+        word &= ~(uint64_t(1) << (i & 63U));
+        if(!word){ summary &= ~summary_bit; }
+    }
+}
+
+inline bool bitmap_test(const bitmap_tree_t &bm, size_t order, size_t i)
+{
+    return bm.words[bm.word_offsets[order] + (i >> 6U)] & (uint64_t(1) << (i & 63U));
+}
+
+//! find the first free node of a size-order, which is known to have free nodes
+inline size_t bitmap_find(const bitmap_tree_t &bm, size_t order)
+{
+    const uint64_t *summary = bm.summary.get() + bm.summary_offsets[order];
+    const uint64_t *words = bm.words.get() + bm.word_offsets[order];
+
+    for(size_t s = 0;; ++s)
+    {
+        if(summary[s])
+        {
+            size_t w = (s << 6U) + std::countr_zero(summary[s]);
+            return (w << 6U) + std::countr_zero(words[w]);
+        }
+    }
+}
+
+block_t bitmap_create(size_t height)
+{
+    block_t ret = {};
+    ret.height = static_cast<uint32_t>(height);
+
+    auto &bm = ret.bitmap;
+    bm.word_offsets = std::unique_ptr<size_t[]>(new size_t[height + 1]);
+    bm.summary_offsets = std::unique_ptr<size_t[]>(new size_t[height + 1]);
+
+    size_t num_words = 0, num_summary_words = 0;
+
+    for(size_t order = 0; order <= height; ++order)
+    {
+        size_t level_words = ((size_t(1) << (height - order)) + 63) / 64;
+        bm.word_offsets[order] = num_words;
+        bm.summary_offsets[order] = num_summary_words;
+        num_words += level_words;
+        num_summary_words += (level_words + 63) / 64;
+    }
+    bm.words = std::unique_ptr<uint64_t[]>(new uint64_t[num_words]());
+    bm.summary = std::unique_ptr<uint64_t[]>(new uint64_t[num_summary_words]());
+    bm.alloc_orders = std::unique_ptr<uint8_t[]>(new uint8_t[size_t(1) << height]());
+
+    // root is free
+    ret.num_free = std::unique_ptr<uint32_t[]>(new uint32_t[height + 1]());
+    bitmap_set(bm, height, 0, true);
+    buddy_count_free(ret, height, 1);
+    return ret;
+}
+
+size_t bitmap_alloc(block_t &b, size_t size)
+{
+    size_t order = size ? std::countr_zero(next_pow_2(size)) : 0;
+    if(order > b.height){ return tree::INDEX_MAX; }
+
+    // smallest size-order with a free node
+    uint64_t candidates = (b.free_mask >> order) << order;
+    if(!candidates){ return tree::INDEX_MAX; }
+    size_t current = std::countr_zero(candidates);
+
+    size_t i = bitmap_find(b.bitmap, current);
+    bitmap_set(b.bitmap, current, i, false);
+    buddy_count_free(b, current, -1);
+
+    // split down to requested order, right halves become free
+    while(current > order)
+    {
+        current--;
+        i <<= 1U;
+        bitmap_set(b.bitmap, current, i + 1, true);
+        buddy_count_free(b, current, 1);
+    }
+    size_t offset = i << order;
+    b.bitmap.alloc_orders[offset] = static_cast<uint8_t>(order + 1);
+    return offset;
+}
+
+size_t bitmap_free(block_t &b, size_t offset)
+{
+    // no allocation starts at offset
+    if(offset >= (size_t(1UL) << b.height) || !b.bitmap.alloc_orders[offset]){ return tree::INDEX_MAX; }
+
+    size_t order = b.bitmap.alloc_orders[offset] - 1;
+    b.bitmap.alloc_orders[offset] = 0;
+    size_t i = offset >> order;
+
+    // merge with free buddies
+    while(order < b.height && bitmap_test(b.bitmap, order, i ^ 1U))
+    {
+        bitmap_set(b.bitmap, order, i ^ 1U, false);
+        buddy_count_free(b, order, -1);
+        i >>= 1U;
+        order++;
+    }
+    bitmap_set(b.bitmap, order, i, true);
+    buddy_count_free(b, order, 1);
+    return order;
+}
+
+size_t bitmap_order(const block_t &b, size_t offset)
+{
+    if(offset >= (size_t(1UL) << b.height) || !b.bitmap.alloc_orders[offset]){ return tree::INDEX_MAX; }
+    return b.bitmap.alloc_orders[offset] - 1;
+}
+
+bool bitmap_resize(block_t &b, size_t offset, size_t order, size_t new_order)
+{
+    if(new_order > b.height){ return false; }
+    assert(b.bitmap.alloc_orders[offset] == order + 1);
+
+    if(new_order < order)
+    {
+        // split down, right halves become free
+        for(size_t o = order; o > new_order; --o)
+        {
+            bitmap_set(b.bitmap, o - 1, (offset >> (o - 1)) + 1, true);
+            buddy_count_free(b, o - 1, 1);
+        }
+    }
+    else
+    {
+        // growing requires an offset aligned to the new size and free buddies all the way up
+        if(offset & ((size_t(1) << new_order) - 1)){ return false; }
+
+        for(size_t o = order; o < new_order; ++o)
+        {
+            if(!bitmap_test(b.bitmap, o, (offset >> o) + 1)){ return false; }
+        }
+
+        // merge upward, consuming the free buddies
+        for(size_t o = order; o < new_order; ++o)
+        {
+            bitmap_set(b.bitmap, o, (offset >> o) + 1, false);
+            buddy_count_free(b, o, -1);
+        }
+    }
+    b.bitmap.alloc_orders[offset] = static_cast<uint8_t>(new_order + 1);
+    return true;
+}
+
+void bitmap_collect_allocations(const block_t &b, size_t minBlockSize, std::map<size_t, size_t> &allocations)
+{
+    size_t num_leaves = size_t(1) << b.height;
+
+    for(size_t offset = 0; offset < num_leaves;)
+    {
+        if(b.bitmap.alloc_orders[offset])
+        {
+            size_t order = b.bitmap.alloc_orders[offset] - 1;
+            allocations[minBlockSize << order]++;
+            offset += size_t(1) << order;
+        }
+        else{ offset++; }
+    }
+}
+
+size_t bitmap_next_allocation(const block_t &b, size_t offset, size_t &order)
+{
+    size_t num_leaves = size_t(1) << b.height;
+
+    for(; offset < num_leaves; ++offset)
+    {
+        if(b.bitmap.alloc_orders[offset])
+        {
+            order = b.bitmap.alloc_orders[offset] - 1;
+            return offset;
+        }
+    }
+    return tree::INDEX_MAX;
+}
+
+//! returns the size-order of an allocation (log2 of the number of sub-blocks)
+inline size_t size_order(size_t num_bytes, size_t min_block_size)
+{
+    return std::countr_zero(next_pow_2((num_bytes + min_block_size - 1) / min_block_size));
+}
+
+//! encode a block's slot and an offset into an allocation-handle, 0 (no handle) if the offset exceeds 32 bits
+inline uint64_t encode_handle(const block_t &b, size_t offset)
+{
+    return offset >> 32U ? 0 : (uint64_t(b.slot + 1) << 32U) | offset;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 // reason to place the default-implementation here:
@@ -260,117 +787,542 @@ BuddyPoolUPtr BuddyPool::create(create_info_t create_info)
 }
 
 BuddyPool::BuddyPool(create_info_t fmt) :
-        m_format(std::move(fmt))
+        m_format(std::move(fmt)),
+        m_offset_only(!m_format.alloc_fn || !m_format.dealloc_fn)
 {
     // enforce pow2 on all blocksizes, derive num_leaves
     m_format.block_size = next_pow_2(m_format.block_size);
     m_format.min_block_size = next_pow_2(m_format.min_block_size);
 
+    auto num_orders = static_cast<size_t>(std::log2(m_format.block_size / m_format.min_block_size)) + 1;
+    m_free_index.resize(num_orders);
+
     // create toplevel blocks
     for(size_t i = 0; i < m_format.min_num_blocks; ++i)
     {
-        m_toplevel_blocks.push_back(create_block());
+        add_block(create_block());
+    }
+
+    // create per-thread magazines
+    if(m_format.magazine_size)
+    {
+        m_num_magazines = static_cast<uint32_t>(next_pow_2(std::max(1U, std::thread::hardware_concurrency())));
+        m_magazines.reset(new magazine_t[m_num_magazines]);
+
+        for(uint32_t i = 0; i < m_num_magazines; ++i)
+        {
+            m_magazines[i].blocks.resize(num_orders);
+            for(auto &cached: m_magazines[i].blocks){ cached.reserve(m_format.magazine_size); }
+        }
     }
 }
 
 block_t BuddyPool::create_block() const
 {
     auto max_level = static_cast<size_t>(std::log2(m_format.block_size / m_format.min_block_size));
-    block_t new_block = buddy_create(max_level);
+    block_t new_block = m_format.bitmap_tree ? bitmap_create(max_level) : buddy_create(max_level);
 
     // allocate the actual memory to be managed
-    if(m_format.alloc_fn && m_format.dealloc_fn)
+    if(!m_offset_only)
     {
         new_block.data = std::unique_ptr<uint8_t, std::function<void(void *)>>(
                 (uint8_t *) m_format.alloc_fn(m_format.block_size),
                 m_format.dealloc_fn);
+        new_block.mapped = m_format.release_min_bytes && virtual_memory::is_mapped(new_block.data.get());
     }
+    if(m_format.block_locks){ new_block.guard = std::make_unique<block_guard_t>(); }
     return new_block;
 }
 
-void *BuddyPool::allocate(size_t num_bytes)
+template<typename Fn>
+size_t BuddyPool::free_shared(Fn &&find_fn, size_t order, bool validate)
 {
-    // requested numBytes is zero or too large
-    if(!num_bytes || num_bytes > m_format.block_size){ return nullptr; }
+    size_t index_offset;
+
+    // no allocation of exactly this size-order starts at the offset
+    auto invalid = [&](const block_t &b) { return validate && block_order(b, index_offset) != order; };
 
+    if(!m_format.block_locks)
+    {
+        std::unique_lock lock(m_mutex);
+        auto *b = find_fn(index_offset);
+        return b && !invalid(*b) ? free_locked(*b, index_offset, order) : 0;
+    }
+
+    size_t num_freed_bytes;
+    uint32_t slot;
+    {
+        std::shared_lock lock(m_mutex);
+        auto *b = find_fn(index_offset);
+        if(!b){ return 0; }
+
+        bool remove;
+        std::unique_lock block_lock(b->guard->mutex);
+        if(invalid(*b)){ return 0; }
+        num_freed_bytes = free_node(*b, index_offset, order, remove);
+        if(!remove){ return num_freed_bytes; }
+        slot = b->slot;
+    }
+
+    // exclusive access to remove the block, unless it was used or removed meanwhile
     std::unique_lock lock(m_mutex);
+    auto *b = m_block_slots[slot];
+
+    if(b && block_empty(*b) && m_toplevel_blocks.size() > m_format.min_num_blocks){ remove_block(*b); }
+    return num_freed_bytes;
+}
+
+void *BuddyPool::allocate(size_t num_bytes)
+{
+    // requested numBytes is zero or too large, or there is no memory to point to
+    if(!num_bytes || num_bytes > m_format.block_size || m_offset_only){ return nullptr; }
 
     // derive number of minimum blocks required
-    auto size = static_cast<size_t>(std::ceil(
-            static_cast<float>(num_bytes) / static_cast<float>(m_format.min_block_size)));
+    size_t size = (num_bytes + m_format.min_block_size - 1) / m_format.min_block_size;
 
-    // iterate toplevel blocks
-    for(auto &b: m_toplevel_blocks)
+    void *ptr = nullptr;
+
+    if(m_magazines){ ptr = allocate_cached(size); }
+    else{ allocate_shared(size, &ptr); }
+    if(ptr){ m_counters.add_used(m_format.min_block_size * next_pow_2(size)); }
+    return ptr;
+}
+
+void *BuddyPool::allocate(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment)){ return nullptr; }
+
+    // allocations are aligned to their size, relative to their toplevel block
+    void *ptr = allocate(std::max(num_bytes, alignment));
+
+    // toplevel block itself is not sufficiently aligned
+    if(reinterpret_cast<uintptr_t>(ptr) & (alignment - 1))
     {
-        // within block, try to allocate, recursively split, find proper index
-        size_t allocation_index = buddy_alloc(b, size);
+        free(ptr);
+        return nullptr;
+    }
+    return ptr;
+}
 
-        // allocation succeeded
-        if(allocation_index < tree::INDEX_MAX)
-        {
-            return b.data.get() + allocation_index * m_format.min_block_size;
-        }
+Allocator::allocation_t BuddyPool::allocate_handle(size_t num_bytes)
+{
+    // magazines do not need handles, sized frees skip all lookups there
+    if(m_magazines || m_offset_only || !num_bytes || num_bytes > m_format.block_size)
+    {
+        return {allocate(num_bytes), num_bytes, 0};
+    }
+
+    size_t size = (num_bytes + m_format.min_block_size - 1) / m_format.min_block_size;
+    Allocator::allocation_t ret = {nullptr, num_bytes, 0};
+    allocate_shared(size, &ret.ptr, &ret.handle);
+    if(ret.ptr){ m_counters.add_used(m_format.min_block_size * next_pow_2(size)); }
+    return ret;
+}
+
+BuddyPool::range_t BuddyPool::allocate_range(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment)){ return {}; }
+
+    // offsets are aligned to their size
+    num_bytes = std::max(num_bytes, alignment);
+    if(num_bytes > m_format.block_size){ return {}; }
+
+    size_t size = (num_bytes + m_format.min_block_size - 1) / m_format.min_block_size;
+    range_t range = allocate_shared(size);
+    if(range){ m_counters.add_used(range.size); }
+    return range;
+}
+
+void BuddyPool::free_range(const range_t &range)
+{
+    if(!range){ return; }
+
+    // ranges are client-provided, validate them against the format and the block's allocations
+    if(range.offset >= m_format.block_size || range.size > m_format.block_size ||
+       range.offset % m_format.min_block_size || !is_pow_2(range.size)){ return; }
+    size_t order = size_order(range.size, m_format.min_block_size);
+
+    size_t num_freed_bytes = free_shared([this, &range](size_t &index_offset) -> block_t * {
+        if(range.block >= m_block_slots.size()){ return nullptr; }
+        index_offset = range.offset / m_format.min_block_size;
+        return m_block_slots[range.block];
+    }, order, true);
+    if(num_freed_bytes){ m_counters.remove_used(num_freed_bytes); }
+}
+
+void *BuddyPool::block_data(uint32_t block) const
+{
+    std::shared_lock lock(m_mutex);
+    if(block >= m_block_slots.size() || !m_block_slots[block]){ return nullptr; }
+    return m_block_slots[block]->data.get();
+}
+
+block_t *BuddyPool::allocate_node(size_t size, bool create_blocks, size_t &index_offset)
+{
+    size_t order = std::countr_zero(next_pow_2(size));
+
+    if(m_format.block_locks)
+    {
+        // no global index, search blocks first-fit
+        if(auto *b = search_node(size, index_offset)){ return b; }
+    }
+    else if(uint64_t candidates = (m_free_index_mask >> order) << order)
+    {
+        // select a block with the smallest sufficient free node
+        auto &b = *m_free_index[std::countr_zero(candidates)].back();
+
+        // within block, allocate, recursively split, find proper index
+        index_offset = block_alloc(b, size);
+        assert(index_offset < tree::INDEX_MAX);
+        index_update(b);
+        return &b;
     }
 
     // add new toplevel block, if maxNumBlocks permits it
-    if(!m_format.max_num_blocks || m_toplevel_blocks.size() < m_format.max_num_blocks)
+    if(create_blocks && (!m_format.max_num_blocks || m_toplevel_blocks.size() < m_format.max_num_blocks))
     {
         auto new_block = create_block();
-
-        size_t allocation_index = buddy_alloc(new_block, size);
+        index_offset = block_alloc(new_block, size);
 
         // this here should always work
-        if(allocation_index < tree::INDEX_MAX)
+        if(index_offset < tree::INDEX_MAX){ return &add_block(std::move(new_block)); }
+    }
+    // no free block with sufficient size could be found or created
+    return nullptr;
+}
+
+void *BuddyPool::allocate_locked(size_t size, bool create_blocks, uint64_t *handle)
+{
+    size_t index_offset;
+    auto *b = allocate_node(size, create_blocks, index_offset);
+    if(!b){ return nullptr; }
+
+    if(handle){ *handle = encode_handle(*b, index_offset); }
+    return b->data.get() + index_offset * m_format.min_block_size;
+}
+
+block_t *BuddyPool::search_node(size_t size, size_t &index_offset)
+{
+    size_t order = std::countr_zero(next_pow_2(size));
+    auto num_slots = static_cast<uint32_t>(m_block_slots.size());
+    if(!num_slots){ return nullptr; }
+
+    // threads start at different blocks, the first pass skips busy blocks
+    uint32_t start = thread_index() % num_slots;
+    bool skipped = false;
+
+    for(bool wait: {false, true})
+    {
+        if(wait && !skipped){ break; }
+
+        for(uint32_t i = 0; i < num_slots; ++i)
         {
-            auto ptr = new_block.data.get() + allocation_index * m_format.min_block_size;
-            m_toplevel_blocks.push_back(std::move(new_block));
-            return ptr;
+            block_t *b = m_block_slots[(start + i) % num_slots];
+            if(!b || !(b->guard->free_mask.load(std::memory_order_relaxed) >> order)){ continue; }
+
+            std::unique_lock block_lock(b->guard->mutex, std::defer_lock);
+
+            if(wait){ block_lock.lock(); }
+            else if(!block_lock.try_lock())
+            {
+                skipped = true;
+                continue;
+            }
+
+            // free nodes might have been taken meanwhile
+            if(!(b->free_mask >> order)){ continue; }
+
+            index_offset = block_alloc(*b, size);
+            assert(index_offset < tree::INDEX_MAX);
+            index_update(*b);
+            return b;
         }
     }
-    // no free block with sufficient size could be found or created
     return nullptr;
 }
 
-void BuddyPool::free(void *ptr)
+BuddyPool::range_t BuddyPool::allocate_shared(size_t size, void **ptr, uint64_t *handle)
+{
+    size_t index_offset;
+
+    // location of the node, evaluated while its block is guaranteed to exist
+    auto location = [&](const block_t *b) -> range_t {
+        if(!b){ return {}; }
+        if(ptr){ *ptr = b->data.get() + index_offset * m_format.min_block_size; }
+        if(handle){ *handle = encode_handle(*b, index_offset); }
+        return {b->slot, index_offset * m_format.min_block_size, m_format.min_block_size * next_pow_2(size)};
+    };
+
+    if(m_format.block_locks)
+    {
+        std::shared_lock lock(m_mutex);
+        if(auto *b = search_node(size, index_offset)){ return location(b); }
+    }
+
+    // exclusive access, required to add a new block
+    std::unique_lock lock(m_mutex);
+    return location(allocate_node(size, true, index_offset));
+}
+
+void *BuddyPool::allocate_cached(size_t size)
 {
+    size_t order = std::countr_zero(next_pow_2(size));
+    auto &magazine = m_magazines[thread_index() & (m_num_magazines - 1)];
+    auto &cached = magazine.blocks[order];
+
+    std::unique_lock magazine_lock(magazine.mutex);
+
+    if(!cached.empty())
+    {
+        void *ptr = cached.back();
+        cached.pop_back();
+        m_num_cached_bytes -= m_format.min_block_size << order;
+        return ptr;
+    }
+
+    // refill magazine with a batch of blocks
     std::unique_lock lock(m_mutex);
+    void *ptr = allocate_locked(size, true);
 
-    // find proper toplevel block
-    auto blockIter = m_toplevel_blocks.begin();
+    // refill from existing toplevel blocks only
+    for(size_t i = 1; ptr && i < std::max<size_t>(m_format.magazine_size / 2, 1); ++i)
+    {
+        void *cached_ptr = allocate_locked(size, false);
+        if(!cached_ptr){ break; }
+        cached.push_back(cached_ptr);
+        m_num_cached_bytes += m_format.min_block_size << order;
+    }
+    return ptr;
+}
+
+void *BuddyPool::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr || m_offset_only){ return allocate(num_bytes); }
 
-    for(; blockIter != m_toplevel_blocks.end(); ++blockIter)
+    if(!num_bytes)
     {
-        auto &b = *blockIter;
+        free(ptr);
+        return nullptr;
+    }
+    if(num_bytes > m_format.block_size){ return nullptr; }
 
-        auto block_end = b.data.get() + m_format.block_size;
+    size_t size = (num_bytes + m_format.min_block_size - 1) / m_format.min_block_size;
+    size_t new_order = std::countr_zero(next_pow_2(size));
 
-        // address is inside this block
-        if(ptr >= b.data.get() && ptr < block_end)
-        {
-            auto ptr_offset = static_cast<uint8_t *>(ptr) - b.data.get();
+    std::unique_lock lock(m_mutex);
 
-            // invalid address
-            if(ptr_offset % m_format.min_block_size){ return; }
+    size_t index_offset;
+    auto *b = find_block(ptr, index_offset);
+    if(!b){ return nullptr; }
 
-            // calculate index-offset from address
-            size_t index_offset = ptr_offset / m_format.min_block_size;
+    size_t order = block_order(*b, index_offset);
+    if(order == tree::INDEX_MAX){ return nullptr; }
 
-            // recursive free / combine blocks
-            buddy_free(b, index_offset);
+    // fits already
+    if(order == new_order){ return ptr; }
 
-            // de-allocate unused blocks above minNumBlocks
-            if(m_format.dealloc_unused_blocks && b.tree[0] == NodeState::UNUSED &&
-               m_toplevel_blocks.size() > m_format.min_num_blocks)
-            {
-                m_toplevel_blocks.erase(blockIter);
-            }
-            break;
+    // shrink by splitting or grow by merging with free buddies
+    if(block_resize(*b, index_offset, order, new_order))
+    {
+        index_update(*b);
+        m_counters.resize_used(m_format.min_block_size << order, m_format.min_block_size << new_order);
+        return ptr;
+    }
+
+    // move to a new location
+    void *new_ptr = allocate_locked(size, true);
+    if(!new_ptr){ return nullptr; }
+
+    memcpy(new_ptr, ptr, m_format.min_block_size << std::min(order, new_order));
+    free_locked(ptr);
+    m_counters.resize_used(m_format.min_block_size << order, m_format.min_block_size << new_order);
+    return new_ptr;
+}
+
+void BuddyPool::free(void *ptr)
+{
+    if(m_magazines)
+    {
+        free_cached(ptr);
+        return;
+    }
+    size_t num_freed_bytes = free_shared([this, ptr](size_t &index_offset) {
+        return find_block(ptr, index_offset);
+    }, tree::INDEX_MAX);
+    if(num_freed_bytes){ m_counters.remove_used(num_freed_bytes); }
+}
+
+void BuddyPool::free(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return; }
+
+    // invalid size, fall back to a lookup
+    if(!num_bytes || num_bytes > m_format.block_size)
+    {
+        free(ptr);
+        return;
+    }
+    size_t order = size_order(num_bytes, m_format.min_block_size);
+
+    if(m_magazines)
+    {
+        // blocks are cached without any lookups, validate size and double frees in debug-builds
+#if defined(NDEBUG)
+        free_cached(ptr, order, false);
+#else
+        assert(find_order(ptr) == order);
+        free_cached(ptr, order, true);
+#endif
+        return;
+    }
+    size_t num_freed_bytes = free_shared([this, ptr](size_t &index_offset) {
+        return find_block(ptr, index_offset);
+    }, order);
+    if(num_freed_bytes){ m_counters.remove_used(num_freed_bytes); }
+}
+
+void BuddyPool::free(const allocation_t &allocation)
+{
+    if(!allocation.handle)
+    {
+        free(allocation.ptr, allocation.num_bytes);
+        return;
+    }
+    size_t order = size_order(allocation.num_bytes, m_format.min_block_size);
+
+    // decode block-slot and offset, no lookups required
+    size_t num_freed_bytes = free_shared([this, &allocation](size_t &index_offset) {
+        auto *b = m_block_slots[(allocation.handle >> 32U) - 1];
+        index_offset = allocation.handle & 0xFFFFFFFFU;
+        assert(b->data.get() + index_offset * m_format.min_block_size == allocation.ptr);
+        return b;
+    }, order);
+    if(num_freed_bytes){ m_counters.remove_used(num_freed_bytes); }
+}
+
+size_t BuddyPool::free_locked(void *ptr)
+{
+    // find proper toplevel block and index-offset
+    size_t index_offset;
+    auto *b = find_block(ptr, index_offset);
+    return b ? free_locked(*b, index_offset, tree::INDEX_MAX) : 0;
+}
+
+size_t BuddyPool::free_locked(block_t &b, size_t index_offset, size_t order)
+{
+    bool remove;
+    size_t num_freed_bytes = free_node(b, index_offset, order, remove);
+    if(remove){ remove_block(b); }
+    return num_freed_bytes;
+}
+
+size_t BuddyPool::free_node(block_t &b, size_t index_offset, size_t order, bool &remove)
+{
+    // recursive free / combine blocks
+    size_t num_free_leaves = b.num_free_leaves;
+    size_t free_order = order == tree::INDEX_MAX ? block_free(b, index_offset) : block_free(b, index_offset, order);
+
+    // not allocated, nothing to free
+    remove = false;
+    if(free_order == tree::INDEX_MAX){ return 0; }
+
+    size_t num_freed_bytes = (b.num_free_leaves - num_free_leaves) * m_format.min_block_size;
+    index_update(b);
+
+    // de-allocate unused blocks above minNumBlocks
+    remove = m_format.dealloc_unused_blocks && block_empty(b) && m_toplevel_blocks.size() > m_format.min_num_blocks;
+    if(remove){ return num_freed_bytes; }
+
+    // return pages of large free ranges to the OS
+    size_t num_free_bytes = m_format.min_block_size << free_order;
+
+    if(m_format.release_min_bytes && b.mapped && num_free_bytes >= m_format.release_min_bytes)
+    {
+        // merged buddies of at least release_min_bytes were released already when they were freed,
+        // only the freed node and smaller buddies around it remain (aligned range of release_min_bytes)
+        size_t release_order = std::max<size_t>(std::countr_zero(num_freed_bytes / m_format.min_block_size),
+                                                size_order(m_format.release_min_bytes, m_format.min_block_size));
+        size_t release_offset = index_offset & ~((size_t(1) << release_order) - 1);
+        virtual_memory::release(b.data.get() + release_offset * m_format.min_block_size,
+                                m_format.min_block_size << release_order);
+    }
+    return num_freed_bytes;
+}
+
+size_t BuddyPool::find_order(const void *ptr) const
+{
+    // concurrent with other readers
+    std::shared_lock lock(m_mutex);
+    size_t index_offset;
+    auto *b = find_block(ptr, index_offset);
+    if(!b){ return tree::INDEX_MAX; }
+
+    std::unique_lock<std::mutex> block_lock;
+    if(b->guard){ block_lock = std::unique_lock(b->guard->mutex); }
+    return block_order(*b, index_offset);
+}
+
+void BuddyPool::free_cached(void *ptr)
+{
+    // not managed by this pool or not allocated
+    size_t order = find_order(ptr);
+    if(order == tree::INDEX_MAX){ return; }
+    free_cached(ptr, order, true);
+}
+
+void BuddyPool::free_cached(void *ptr, size_t order, bool validate)
+{
+    auto &magazine = m_magazines[thread_index() & (m_num_magazines - 1)];
+    auto &cached = magazine.blocks[order];
+
+    std::unique_lock magazine_lock(magazine.mutex);
+
+    // cached blocks remain allocated in their toplevel block, so lookups cannot detect a double free.
+    // the magazine is small and hot, reject pointers it already holds
+    if(validate && std::find(cached.begin(), cached.end(), ptr) != cached.end()){ return; }
+
+    // magazine is full, flush half of it
+    if(cached.size() >= m_format.magazine_size)
+    {
+        std::unique_lock lock(m_mutex);
+
+        while(cached.size() > m_format.magazine_size / 2)
+        {
+            free_locked(cached.back());
+            cached.pop_back();
+            m_num_cached_bytes -= m_format.min_block_size << order;
         }
     }
+    cached.push_back(ptr);
+    m_num_cached_bytes += m_format.min_block_size << order;
+    m_counters.remove_used(m_format.min_block_size << order);
+}
+
+void BuddyPool::flush_magazine(magazine_t &magazine)
+{
+    for(size_t order = 0; order < magazine.blocks.size(); ++order)
+    {
+        auto &cached = magazine.blocks[order];
+        for(void *ptr: cached){ free_locked(ptr); }
+        m_num_cached_bytes -= cached.size() * (m_format.min_block_size << order);
+        cached.clear();
+    }
+}
+
+void BuddyPool::flush_magazines()
+{
+    for(uint32_t i = 0; i < m_num_magazines; ++i)
+    {
+        std::unique_lock magazine_lock(m_magazines[i].mutex);
+        std::unique_lock lock(m_mutex);
+        flush_magazine(m_magazines[i]);
+    }
 }
 
 void BuddyPool::shrink()
 {
+    flush_magazines();
+
     std::unique_lock lock(m_mutex);
 
     // iterate toplevel blocks
@@ -378,32 +1330,287 @@ void BuddyPool::shrink()
 
     while(blockIter != m_toplevel_blocks.end())
     {
-        auto &b = *blockIter;
+        auto &b = *blockIter++;
 
         // de-allocate unused blocks above minNumBlocks
-        if(b.tree[0] == NodeState::UNUSED && m_toplevel_blocks.size() > m_format.min_num_blocks)
+        if(block_empty(b) && m_toplevel_blocks.size() > m_format.min_num_blocks)
+        {
+            remove_block(b);
+        }
+    }
+}
+
+BuddyPool::defrag_result_t BuddyPool::defragment(const relocate_fn_t &relocate_fn,
+                                                 std::chrono::nanoseconds time_budget,
+                                                 float max_block_usage)
+{
+    defrag_result_t ret = {};
+    if(!relocate_fn){ return ret; }
+
+    auto deadline = std::chrono::steady_clock::now() + time_budget;
+    // attempted moves, including pinned or failed ones, so the budget also holds without progress
+    size_t num_attempts = 0;
+    auto budget_exceeded = [&num_attempts, deadline] {
+        return num_attempts && std::chrono::steady_clock::now() >= deadline;
+    };
+
+    // cached blocks would be moved behind the magazines' back.
+    // magazines stay locked for the whole call, so no blocks are cached or handed out meanwhile
+    std::vector<std::unique_lock<std::mutex>> magazine_locks;
+    for(uint32_t i = 0; i < m_num_magazines; ++i){ magazine_locks.emplace_back(m_magazines[i].mutex); }
+
+    std::unique_lock lock(m_mutex);
+    for(uint32_t i = 0; i < m_num_magazines; ++i){ flush_magazine(m_magazines[i]); }
+
+    for(;;)
+    {
+        if(budget_exceeded()){ return ret; }
+
+        // block from a previous call was removed meanwhile
+        if(m_defrag_slot != s_invalid_block &&
+           (m_defrag_slot >= m_block_slots.size() || !m_block_slots[m_defrag_slot]))
+        {
+            m_defrag_slot = s_invalid_block;
+        }
+
+        // select the sparsest block, not visited during this pass
+        if(m_defrag_slot == s_invalid_block)
+        {
+            block_t *sparsest = nullptr;
+            size_t num_free_leaves = 0;
+
+            for(auto &b: m_toplevel_blocks)
+            {
+                num_free_leaves += b.num_free_leaves;
+                size_t num_used_leaves = (size_t(1) << b.height) - b.num_free_leaves;
+
+                if(!num_used_leaves || float(num_used_leaves) >= max_block_usage * float(size_t(1) << b.height) ||
+                   std::find(m_defrag_visited.begin(), m_defrag_visited.end(), b.slot) != m_defrag_visited.end())
+                {
+                    continue;
+                }
+                if(!sparsest || b.num_free_leaves > sparsest->num_free_leaves){ sparsest = &b; }
+            }
+
+            // remaining blocks cannot take all allocations of the sparsest block
+            if(sparsest && num_free_leaves - sparsest->num_free_leaves < (size_t(1) << sparsest->height) -
+                                                                          sparsest->num_free_leaves)
+            {
+                sparsest = nullptr;
+            }
+
+            // pass completed
+            if(!sparsest)
+            {
+                m_defrag_visited.clear();
+                ret.done = true;
+                return ret;
+            }
+            m_defrag_slot = sparsest->slot;
+            m_defrag_offset = 0;
+            m_defrag_visited.push_back(sparsest->slot);
+        }
+
+        // keep allocations out of the evacuated block
+        auto &src = *m_block_slots[m_defrag_slot];
+        index_remove(src);
+
+        size_t order = 0;
+
+        while((m_defrag_offset = block_next_allocation(src, m_defrag_offset, order)) != tree::INDEX_MAX)
+        {
+            if(budget_exceeded())
+            {
+                index_update(src);
+                return ret;
+            }
+
+            num_attempts++;
+
+            // no space left in other blocks
+            size_t dst_offset;
+            auto *dst = allocate_node(size_t(1) << order, false, dst_offset);
+            if(!dst){ break; }
+
+            size_t num_bytes = m_format.min_block_size << order;
+            relocation_t relocation = {};
+            relocation.src = {src.slot, m_defrag_offset * m_format.min_block_size, num_bytes};
+            relocation.dst = {dst->slot, dst_offset * m_format.min_block_size, num_bytes};
+
+            if(!m_offset_only)
+            {
+                relocation.src_ptr = src.data.get() + relocation.src.offset;
+                relocation.dst_ptr = dst->data.get() + relocation.dst.offset;
+            }
+
+            if(relocate_fn(relocation))
+            {
+                block_free(src, m_defrag_offset, order);
+                ret.num_moves++;
+                ret.num_bytes_moved += num_bytes;
+            }
+            else
+            {
+                // pinned allocation, undo
+                block_free(*dst, dst_offset, order);
+                index_update(*dst);
+            }
+            m_defrag_offset += size_t(1) << order;
+        }
+        m_defrag_slot = s_invalid_block;
+
+        // release the emptied block
+        if(block_empty(src) && m_toplevel_blocks.size() > m_format.min_num_blocks)
         {
-            blockIter = m_toplevel_blocks.erase(blockIter);
+            remove_block(src);
+            ret.num_blocks_released++;
         }
-        else{ ++blockIter; }
+        else{ index_update(src); }
+    }
+}
+
+block_t &BuddyPool::add_block(block_t &&b)
+{
+    auto it = m_toplevel_blocks.insert(m_toplevel_blocks.end(), std::move(b));
+
+    // keep address-index sorted
+    const uint8_t *address = it->data.get();
+    auto index_it = std::upper_bound(m_address_index.begin(), m_address_index.end(), address,
+                                     [](const uint8_t *lhs, const auto &rhs) { return lhs < rhs.first; });
+    m_address_index.insert(index_it, {address, it});
+    m_counters.add_internal(m_format.block_size);
+
+    // assign a stable slot, re-using those of removed blocks
+    if(!m_free_slots.empty())
+    {
+        it->slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        m_block_slots[it->slot] = &*it;
+    }
+    else
+    {
+        it->slot = static_cast<uint32_t>(m_block_slots.size());
+        m_block_slots.push_back(&*it);
     }
+
+    index_update(*it);
+    return *it;
+}
+
+void BuddyPool::remove_block(block_t &b)
+{
+    index_remove(b);
+
+    auto [first, last] = std::equal_range(m_address_index.begin(), m_address_index.end(),
+                                          std::make_pair(static_cast<const uint8_t *>(b.data.get()),
+                                                         m_toplevel_blocks.end()),
+                                          [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+
+    for(auto index_it = first; index_it != last; ++index_it)
+    {
+        if(&*index_it->second == &b)
+        {
+            m_counters.remove_internal(m_format.block_size);
+            m_block_slots[b.slot] = nullptr;
+            m_free_slots.push_back(b.slot);
+            m_toplevel_blocks.erase(index_it->second);
+            m_address_index.erase(index_it);
+            return;
+        }
+    }
+}
+
+block_t *BuddyPool::find_block(const void *ptr) const
+{
+    auto address = static_cast<const uint8_t *>(ptr);
+
+    // first block starting after address
+    auto index_it = std::upper_bound(m_address_index.begin(), m_address_index.end(), address,
+                                     [](const uint8_t *lhs, const auto &rhs) { return lhs < rhs.first; });
+    if(index_it == m_address_index.begin()){ return nullptr; }
+    --index_it;
+
+    // address is inside this block
+    if(address < index_it->first + m_format.block_size){ return &*index_it->second; }
+    return nullptr;
+}
+
+block_t *BuddyPool::find_block(const void *ptr, size_t &index_offset) const
+{
+    auto *b = find_block(ptr);
+    if(!b){ return nullptr; }
+
+    auto ptr_offset = static_cast<const uint8_t *>(ptr) - b->data.get();
+
+    // invalid address
+    if(ptr_offset % m_format.min_block_size){ return nullptr; }
+
+    // calculate index-offset from address
+    index_offset = ptr_offset / m_format.min_block_size;
+    return b;
+}
+
+void BuddyPool::index_update(block_t &b)
+{
+    // no global index, publish free size-orders for searches without the block's lock
+    if(b.guard)
+    {
+        b.guard->free_mask.store(b.free_mask, std::memory_order_relaxed);
+        return;
+    }
+    size_t order = buddy_max_free_order(b);
+    if(order == b.index_order){ return; }
+
+    index_remove(b);
+
+    if(order != tree::INDEX_MAX)
+    {
+        auto &bucket = m_free_index[order];
+        b.index_order = order;
+        b.index_pos = bucket.size();
+        bucket.push_back(&b);
+        m_free_index_mask |= uint64_t(1) << order;
+    }
+}
+
+void BuddyPool::index_remove(block_t &b)
+{
+    if(b.guard)
+    {
+        b.guard->free_mask.store(0, std::memory_order_relaxed);
+        return;
+    }
+    if(b.index_order == tree::INDEX_MAX){ return; }
+
+    // swap-remove from bucket
+    auto &bucket = m_free_index[b.index_order];
+    bucket[b.index_pos] = bucket.back();
+    bucket[b.index_pos]->index_pos = b.index_pos;
+    bucket.pop_back();
+
+    if(bucket.empty()){ m_free_index_mask &= ~(uint64_t(1) << b.index_order); }
+    b.index_order = tree::INDEX_MAX;
 }
 
 Allocator::state_t BuddyPool::state() const
 {
     std::shared_lock lock(m_mutex);
+    Allocator::state_t ret = m_counters.state();
 
-    auto pool = pool_state();
-
-    Allocator::state_t ret = {};
+    // blocks cached in magazines are neither in use nor available to other threads
+    size_t num_unavailable_bytes = ret.num_bytes_used + m_num_cached_bytes;
+    size_t num_free_bytes = ret.num_bytes_allocated > num_unavailable_bytes ?
+                            ret.num_bytes_allocated - num_unavailable_bytes : 0;
 
-    ret.num_allocations = pool.num_blocks;
-    ret.num_bytes_allocated = m_format.block_size * m_toplevel_blocks.size();
+    // largest free node across all toplevel blocks
+    uint64_t free_mask = m_free_index_mask;
 
-    for(const auto &[block_size, numAllocations]: pool.allocations)
+    if(m_format.block_locks)
     {
-        ret.num_bytes_used += block_size * numAllocations;
+        for(const auto &b: m_toplevel_blocks){ free_mask |= b.guard->free_mask.load(std::memory_order_relaxed); }
     }
+    size_t max_free_bytes = free_mask ? m_format.min_block_size << (std::bit_width(free_mask) - 1) : 0;
+    ret.fragmentation = fragmentation(num_free_bytes, max_free_bytes);
     return ret;
 }
 
@@ -418,7 +1625,9 @@ BuddyPool::pool_state_t BuddyPool::pool_state() const
 
     for(const auto &b: m_toplevel_blocks)
     {
-        buddy_collect_allocations(b, 0, 0, m_format.min_block_size, ret.allocations);
+        std::unique_lock<std::mutex> block_lock;
+        if(b.guard){ block_lock = std::unique_lock(b.guard->mutex); }
+        block_collect_allocations(b, m_format.min_block_size, ret.allocations);
     }
     return ret;
 }
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "crocore/EpochReclaimer.hpp"
+
+namespace crocore
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+EpochReclaimer::guard_t::~guard_t()
+{
+    if(m_participant) { m_participant->unpin(); }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+EpochReclaimer::participant_t::participant_t(EpochReclaimer *reclaimer, uint32_t slot_index)
+    : m_reclaimer(reclaimer), m_slot_index(slot_index)
+{
+    m_retired.reserve(reclaimer->m_create_info.batch_size);
+}
+
+EpochReclaimer::participant_t::participant_t(participant_t &&other) noexcept : participant_t()
+{
+    swap(*this, other);
+}
+
+EpochReclaimer::participant_t &EpochReclaimer::participant_t::operator=(participant_t other)
+{
+    swap(*this, other);
+    return *this;
+}
+
+void swap(EpochReclaimer::participant_t &lhs, EpochReclaimer::participant_t &rhs) noexcept
+{
+    std::swap(lhs.m_reclaimer, rhs.m_reclaimer);
+    std::swap(lhs.m_slot_index, rhs.m_slot_index);
+    std::swap(lhs.m_pin_count, rhs.m_pin_count);
+    std::swap(lhs.m_retired, rhs.m_retired);
+}
+
+EpochReclaimer::participant_t::~participant_t()
+{
+    if(!m_reclaimer) { return; }
+
+    // destroying a pinned participant is a usage-error
+    assert(!m_pin_count);
+
+    collect();
+
+    // hand over remaining objects, they will be reclaimed by someone else
+    if(!m_retired.empty())
+    {
+        std::unique_lock lock(m_reclaimer->m_orphan_mutex);
+        m_reclaimer->m_orphans.insert(m_reclaimer->m_orphans.end(), m_retired.begin(), m_retired.end());
+    }
+
+    auto &slot = m_reclaimer->m_slots[m_slot_index];
+    slot.state.store(0, std::memory_order_release);
+    slot.in_use.store(false, std::memory_order_release);
+}
+
+EpochReclaimer::guard_t EpochReclaimer::participant_t::pin()
+{
+    assert(m_reclaimer);
+
+    if(!m_pin_count++)
+    {
+        auto &state = m_reclaimer->m_slots[m_slot_index].state;
+        uint64_t epoch = m_reclaimer->m_global_epoch.load(std::memory_order_acquire);
+
+        for(;;)
+        {
+            // announce the observed epoch. the seq_cst read-modify-write acts as a full barrier,
+            // subsequent loads of protected data cannot be reordered before the announcement
+            state.exchange((epoch << 1) | 1, std::memory_order_seq_cst);
+
+            // epoch advanced meanwhile, re-announce to not hold back reclamation
+            uint64_t current = m_reclaimer->m_global_epoch.load(std::memory_order_seq_cst);
+            if(current == epoch) { break; }
+            epoch = current;
+        }
+    }
+    return guard_t(this);
+}
+
+void EpochReclaimer::participant_t::unpin()
+{
+    assert(m_pin_count);
+    if(!--m_pin_count) { m_reclaimer->m_slots[m_slot_index].state.store(0, std::memory_order_release); }
+}
+
+void EpochReclaimer::participant_t::retire(void *ptr, deleter_fn_t deleter, void *user_data)
+{
+    assert(m_reclaimer && deleter);
+    if(!ptr) { return; }
+
+    m_retired.push_back({ptr, deleter, user_data, m_reclaimer->m_global_epoch.load(std::memory_order_acquire)});
+
+    // batch is full -> attempt to reclaim
+    if(m_retired.size() >= m_reclaimer->m_create_info.batch_size) { collect(); }
+}
+
+size_t EpochReclaimer::participant_t::collect()
+{
+    assert(m_reclaimer);
+    m_reclaimer->try_advance();
+    return reclaim(m_retired, m_reclaimer->epoch());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+EpochReclaimerUPtr EpochReclaimer::create(const create_info_t &create_info)
+{
+    return EpochReclaimerUPtr(new EpochReclaimer(create_info));
+}
+
+EpochReclaimer::EpochReclaimer(const create_info_t &create_info)
+    : m_create_info(create_info), m_slots(new slot_t[std::max<uint32_t>(create_info.max_num_threads, 1)])
+{
+    m_create_info.max_num_threads = std::max<uint32_t>(create_info.max_num_threads, 1);
+    m_create_info.batch_size = std::max<uint32_t>(create_info.batch_size, 1);
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+    // no participants left -> everything can go
+    for(auto &r: m_orphans) { r.deleter(r.ptr, r.user_data); }
+}
+
+EpochReclaimer::participant_t EpochReclaimer::register_thread()
+{
+    for(uint32_t i = 0; i < m_create_info.max_num_threads; ++i)
+    {
+        bool expected = false;
+
+        if(!m_slots[i].in_use.load(std::memory_order_relaxed) &&
+           m_slots[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            return {this, i};
+        }
+    }
+    throw std::runtime_error("EpochReclaimer: max_num_threads exceeded");
+}
+
+bool EpochReclaimer::try_advance()
+{
+    uint64_t epoch = m_global_epoch.load(std::memory_order_seq_cst);
+
+    for(uint32_t i = 0; i < m_create_info.max_num_threads; ++i)
+    {
+        uint64_t state = m_slots[i].state.load(std::memory_order_seq_cst);
+
+        // a pinned participant has not yet observed the current epoch
+        if((state & 1) && (state >> 1) != epoch) { return false; }
+    }
+    return m_global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+}
+
+size_t EpochReclaimer::collect_orphans()
+{
+    try_advance();
+
+    std::unique_lock lock(m_orphan_mutex);
+    return reclaim(m_orphans, epoch());
+}
+
+size_t EpochReclaimer::reclaim(std::vector<participant_t::retired_t> &retired, uint64_t epoch)
+{
+    // reclaim all objects that aged long enough, keep the rest in order
+    auto it = std::stable_partition(retired.begin(), retired.end(), [epoch](const participant_t::retired_t &r) {
+        return r.epoch + s_grace_epochs > epoch;
+    });
+    for(auto reclaim_it = it; reclaim_it != retired.end(); ++reclaim_it)
+    {
+        reclaim_it->deleter(reclaim_it->ptr, reclaim_it->user_data);
+    }
+
+    auto num_reclaimed = static_cast<size_t>(retired.end() - it);
+    retired.erase(it, retired.end());
+    return num_reclaimed;
+}
+
+}// namespace crocore
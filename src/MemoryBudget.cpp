@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include "crocore/MemoryBudget.hpp"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace crocore
+{
+
+//! read a single unsigned value from a file (e.g. below /proc or /sys), returns 0 on failure or for "max"
+static size_t read_value(const char *path)
+{
+    std::ifstream stream(path);
+    std::string value;
+    if(!(stream >> value) || value == "max"){ return 0; }
+
+    try{ return std::stoull(value); }
+    catch(std::exception &){ return 0; }
+}
+
+MemoryBudgetUPtr MemoryBudget::create(create_info_t create_info)
+{
+    return MemoryBudgetUPtr(new MemoryBudget(std::move(create_info)));
+}
+
+const MemoryBudgetPtr &MemoryBudget::global()
+{
+    static MemoryBudgetPtr s_budget = [] {
+        create_info_t create_info = {};
+        create_info.use_cgroup_limit = true;
+        return MemoryBudgetPtr(create(create_info));
+    }();
+    return s_budget;
+}
+
+MemoryBudget::MemoryBudget(create_info_t create_info) : m_format(std::move(create_info))
+{
+    size_t budget = m_format.budget;
+    if(!budget && m_format.use_cgroup_limit){ budget = cgroup_limit(); }
+    m_budget = budget;
+}
+
+uint64_t MemoryBudget::add(const AllocatorPtr &allocator, int32_t priority, std::function<void()> trim_fn)
+{
+    std::unique_lock lock(m_mutex);
+
+    entry_t entry = {};
+    entry.id = m_next_id++;
+    entry.allocator = allocator;
+    entry.priority = priority;
+    entry.trim_fn = std::move(trim_fn);
+
+    // keep sorted by priority, in order of registration for equal priorities
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), priority,
+                               [](int32_t lhs, const entry_t &rhs) { return lhs < rhs.priority; });
+    m_entries.insert(it, std::move(entry));
+    return m_next_id - 1;
+}
+
+void MemoryBudget::remove(uint64_t id)
+{
+    std::unique_lock lock(m_mutex);
+    std::erase_if(m_entries, [id](const entry_t &entry) { return entry.id == id; });
+}
+
+MemoryPressure MemoryBudget::pressure_level(size_t usage) const
+{
+    size_t budget = m_budget.load(std::memory_order_relaxed);
+    if(!budget){ return MemoryPressure::NONE; }
+
+    double fraction = static_cast<double>(usage) / static_cast<double>(budget);
+    if(fraction >= m_format.critical_threshold){ return MemoryPressure::CRITICAL; }
+    if(fraction >= m_format.high_threshold){ return MemoryPressure::HIGH; }
+    if(fraction >= m_format.moderate_threshold){ return MemoryPressure::MODERATE; }
+    return MemoryPressure::NONE;
+}
+
+size_t MemoryBudget::usage() const
+{
+    switch(m_format.usage_source)
+    {
+        case MemoryUsageSource::PROCESS_RSS:return process_rss();
+        case MemoryUsageSource::CGROUP:return cgroup_usage();
+        case MemoryUsageSource::ALLOCATORS:break;
+    }
+
+    std::unique_lock lock(m_mutex);
+    size_t ret = 0;
+
+    for(const auto &entry: m_entries)
+    {
+        if(auto allocator = entry.allocator.lock()){ ret += allocator->state().num_bytes_allocated; }
+    }
+    return ret;
+}
+
+MemoryPressure MemoryBudget::update()
+{
+    std::unique_lock update_lock(m_update_mutex);
+    MemoryPressure previous = m_pressure.load(std::memory_order_relaxed);
+    MemoryPressure pressure = pressure_level(usage());
+
+    if(pressure != MemoryPressure::NONE)
+    {
+        // collect live allocators, no lock is held while releasing memory
+        std::vector<std::pair<AllocatorPtr, std::function<void()>>> allocators;
+        {
+            std::unique_lock lock(m_mutex);
+            std::erase_if(m_entries, [](const entry_t &entry) { return entry.allocator.expired(); });
+            for(const auto &entry: m_entries){ allocators.emplace_back(entry.allocator.lock(), entry.trim_fn); }
+        }
+
+        // release memory in order of priority, until pressure is relieved
+        for(const auto &[allocator, trim_fn]: allocators)
+        {
+            if(pressure == MemoryPressure::NONE){ break; }
+            if(!allocator){ continue; }
+
+            if(pressure >= MemoryPressure::HIGH){ allocator->shrink(); }
+            else if(trim_fn){ trim_fn(); }
+            else{ continue; }
+
+            pressure = pressure_level(usage());
+        }
+    }
+    m_pressure.store(pressure, std::memory_order_relaxed);
+
+    if(pressure != previous && m_format.pressure_fn){ m_format.pressure_fn(pressure); }
+    return pressure;
+}
+
+size_t MemoryBudget::process_rss()
+{
+#if !defined(_WIN32)
+    // second field: resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t num_pages = 0, num_resident_pages = 0;
+
+    if(statm >> num_pages >> num_resident_pages)
+    {
+        return num_resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+size_t MemoryBudget::cgroup_limit()
+{
+    // cgroup v2, "max" for unlimited
+    if(size_t limit = read_value("/sys/fs/cgroup/memory.max")){ return limit; }
+
+    // cgroup v1, unlimited is reported as a huge, page-aligned value
+    size_t limit = read_value("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+    return limit < (size_t(1) << 60U) ? limit : 0;
+}
+
+size_t MemoryBudget::cgroup_usage()
+{
+    if(size_t usage = read_value("/sys/fs/cgroup/memory.current")){ return usage; }
+    return read_value("/sys/fs/cgroup/memory/memory.usage_in_bytes");
+}
+
+}// namespace crocore
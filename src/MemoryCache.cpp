@@ -2,12 +2,195 @@
 //  Copyright (c) 2020 uniqFEED Ltd. All rights reserved.
 //=============================================================================================
 
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <utility>
 #include <crocore/MemoryCache.hpp>
+#include <crocore/utils.hpp>
+#include <crocore/virtual_memory.hpp>
 
 
 namespace crocore
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+//! number of size-classes per power of two
+constexpr uint32_t k_class_steps = 4;
+
+constexpr uint32_t k_num_size_classes = 64 * k_class_steps;
+
+//! magic values, stored in the header of used and free chunks
+constexpr uint32_t k_chunk_used = 0xC40C0DE5, k_chunk_free = 0xF4EEC0DE;
+
+/**
+ * @brief   chunk_header_t is placed at the start of each chunk in size-class mode.
+ *          The offset between chunk-start and client-pointer is also stored right before the client-pointer.
+ */
+struct alignas(std::max_align_t) chunk_header_t
+{
+    //! links within a shard's free- or used-list
+    chunk_header_t *prev = nullptr, *next = nullptr;
+
+    //! links within a shard's list of free chunks, in order of release
+    chunk_header_t *lru_prev = nullptr, *lru_next = nullptr;
+
+    //! point in time, when the chunk was freed
+    std::chrono::steady_clock::time_point idle_since;
+
+    //! size of the chunk in bytes, including the header
+    size_t num_bytes = 0;
+
+    //! alignment requested for the client-pointer
+    size_t alignment = 1;
+
+    uint32_t size_class = 0;
+    uint32_t shard = 0;
+
+    //! k_chunk_used or k_chunk_free, detects foreign pointers and double frees
+    uint32_t magic = k_chunk_free;
+
+    //! chunk is backed by a mapping from virtual_memory::map(), free pages can be released
+    bool mapped = false;
+
+    //! offset from chunk-start to client-pointer
+    size_t offset = 0;
+};
+static_assert(sizeof(chunk_header_t) % alignof(std::max_align_t) == 0);
+
+/**
+ * @brief   cache_shard_t groups free- and used-chunks, guarded by a lock.
+ *          It is padded to a cache-line to avoid false sharing.
+ */
+struct alignas(k_cache_line_size) cache_shard_t
+{
+    std::mutex mutex;
+
+    //! intrusive lists of free chunks, indexed by size-class
+    chunk_header_t *free_lists[k_num_size_classes] = {};
+
+    //! intrusive list of used chunks
+    chunk_header_t *used_list = nullptr;
+
+    //! intrusive list of free chunks, most recently freed first
+    chunk_header_t *lru_head = nullptr, *lru_tail = nullptr;
+
+    //! point in time (ticks), when lru_tail was freed. read without a lock to find the globally oldest chunk
+    std::atomic<std::chrono::steady_clock::rep> lru_tail_since =
+            std::numeric_limits<std::chrono::steady_clock::rep>::max();
+
+    //! largest size-class + 1 with a non-empty free-list, 0 if no free chunks exist.
+    //! written with a lock on the shard, read without to skip shards that cannot serve an allocation.
+    std::atomic<uint32_t> max_free_class = 0;
+
+    size_t num_free_chunks = 0, num_free_bytes = 0;
+    size_t num_used_chunks = 0, num_used_bytes = 0;
+};
+
+//! returns the smallest size-class, holding at least num_bytes (num_bytes > 8)
+inline uint32_t size_class(size_t num_bytes)
+{
+    // num_bytes is in (2^(k-1), 2^k], which is split into k_class_steps equal steps
+    auto k = static_cast<uint32_t>(std::bit_width(num_bytes - 1));
+    size_t step = (align_up(num_bytes, size_t(1) << (k - 3)) >> (k - 3)) - k_class_steps;
+    return (k - 1) * k_class_steps + static_cast<uint32_t>(step) - 1;
+}
+
+//! returns the size in bytes for a size-class
+inline size_t class_size(uint32_t size_class)
+{
+    return size_t(k_class_steps + size_class % k_class_steps + 1) << (size_class / k_class_steps - 2);
+}
+
+inline void list_push(chunk_header_t *&head, chunk_header_t *chunk)
+{
+    chunk->prev = nullptr;
+    chunk->next = head;
+    if(head){ head->prev = chunk; }
+    head = chunk;
+}
+
+inline void list_remove(chunk_header_t *&head, chunk_header_t *chunk)
+{
+    if(chunk->prev){ chunk->prev->next = chunk->next; }
+    else{ head = chunk->next; }
+    if(chunk->next){ chunk->next->prev = chunk->prev; }
+}
+
+//! lower a shard's largest free size-class, after a chunk of a size-class was removed
+inline void shard_update_max_free_class(cache_shard_t &shard, uint32_t size_class)
+{
+    uint32_t max_free_class = shard.max_free_class.load(std::memory_order_relaxed);
+    if(shard.free_lists[size_class] || size_class + 1 != max_free_class){ return; }
+    while(max_free_class && !shard.free_lists[max_free_class - 1]){ max_free_class--; }
+    shard.max_free_class.store(max_free_class, std::memory_order_relaxed);
+}
+
+//! publish the age of a shard's least recently freed chunk
+inline void lru_update_since(cache_shard_t &shard)
+{
+    shard.lru_tail_since.store(shard.lru_tail ? shard.lru_tail->idle_since.time_since_epoch().count() :
+                               std::numeric_limits<std::chrono::steady_clock::rep>::max(), std::memory_order_relaxed);
+}
+
+inline void lru_push(cache_shard_t &shard, chunk_header_t *chunk)
+{
+    chunk->lru_prev = nullptr;
+    chunk->lru_next = shard.lru_head;
+    if(shard.lru_head){ shard.lru_head->lru_prev = chunk; }
+    else
+    {
+        shard.lru_tail = chunk;
+        lru_update_since(shard);
+    }
+    shard.lru_head = chunk;
+}
+
+inline void lru_remove(cache_shard_t &shard, chunk_header_t *chunk)
+{
+    if(chunk->lru_prev){ chunk->lru_prev->lru_next = chunk->lru_next; }
+    else{ shard.lru_head = chunk->lru_next; }
+    if(chunk->lru_next){ chunk->lru_next->lru_prev = chunk->lru_prev; }
+    else
+    {
+        shard.lru_tail = chunk->lru_prev;
+        lru_update_since(shard);
+    }
+}
+
+//! returns the header of a chunk, containing a client-pointer, or nullptr if ptr is not a used chunk.
+//! detection is best-effort, ptr is dereferenced and must be readable (see MemoryCache::free)
+inline chunk_header_t *chunk_header(void *ptr)
+{
+    size_t offset = *(static_cast<size_t *>(ptr) - 1);
+    if(offset < sizeof(chunk_header_t) || offset > reinterpret_cast<uintptr_t>(ptr)){ return nullptr; }
+
+    auto *chunk = reinterpret_cast<chunk_header_t *>(static_cast<uint8_t *>(ptr) - offset);
+    return chunk->magic == k_chunk_used && chunk->offset == offset ? chunk : nullptr;
+}
+
+//! mark a chunk as used and return its client-pointer, requires a lock on the shard
+inline void *use_chunk(cache_shard_t &shard, chunk_header_t *chunk, size_t alignment)
+{
+    list_push(shard.used_list, chunk);
+    shard.num_used_chunks++;
+    shard.num_used_bytes += chunk->num_bytes;
+
+    auto *base = reinterpret_cast<uint8_t *>(chunk);
+    auto *ptr = reinterpret_cast<uint8_t *>(align_up(reinterpret_cast<uintptr_t>(base + sizeof(chunk_header_t)),
+                                                     alignment));
+    chunk->alignment = alignment;
+    chunk->magic = k_chunk_used;
+    chunk->offset = ptr - base;
+    *(reinterpret_cast<size_t *>(ptr) - 1) = chunk->offset;
+    return ptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
 MemoryCachePtr MemoryCache::create(create_info_t fmt)
 {
     return crocore::MemoryCachePtr(new MemoryCache(std::move(fmt)));
@@ -16,55 +199,90 @@ MemoryCachePtr MemoryCache::create(create_info_t fmt)
 MemoryCache::MemoryCache(create_info_t fmt) :
         _format(std::move(fmt))
 {
-
+    if(_format.size_classes)
+    {
+        _num_shards = static_cast<uint32_t>(next_pow_2(std::max(1U, std::thread::hardware_concurrency())));
+        _shards.reset(new cache_shard_t[_num_shards]);
+    }
 }
 
 MemoryCache::~MemoryCache()
 {
+    for(uint32_t i = 0; i < _num_shards && _format.dealloc_fn; ++i)
+    {
+        auto &shard = _shards[i];
+        for(auto *head: shard.free_lists)
+        {
+            while(head){ _format.dealloc_fn(std::exchange(head, head->next)); }
+        }
+        while(shard.used_list){ _format.dealloc_fn(std::exchange(shard.used_list, shard.used_list->next)); }
+    }
+
     // use std::try_to_lock to avoid a possible exception
     std::unique_lock lock(_mutex, std::try_to_lock);
 
     if(_format.dealloc_fn)
     {
-        for(auto &it: _freeChunks){ _format.dealloc_fn(it.second); }
-        for(auto &it: _usedChunks){ _format.dealloc_fn(it.first); }
+        for(auto &it: _freeChunks){ _format.dealloc_fn(it.second.base); }
+        for(auto &it: _usedChunks){ _format.dealloc_fn(it.second.base); }
     }
 }
 
 void *MemoryCache::allocate(size_t num_bytes)
 {
-    if(!num_bytes){ return nullptr; }
+    return allocate(num_bytes, 1);
+}
+
+void *MemoryCache::allocate(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment)){ return nullptr; }
+    if(_shards){ return allocate_sized(num_bytes, alignment); }
 
     num_bytes = std::max(num_bytes, _format.min_size);
 
+    // alloc_fn guarantees alignof(std::max_align_t), larger alignments might require padding
+    size_t max_padding = alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+
     std::unique_lock lock(_mutex);
 
     // upper bound for the accepted size of a recycled chunk
-    auto max_num_bytes = static_cast<size_t>(static_cast<float>(num_bytes) * std::max(_format.size_tolerance, 1.f));
-
-    // search for a lower bound (equal or greater)
-    auto it = _freeChunks.lower_bound(num_bytes);
+    auto max_num_bytes = static_cast<size_t>(static_cast<float>(num_bytes + max_padding) *
+                                             std::max(_format.size_tolerance, 1.f));
 
-    if(it != _freeChunks.end() && it->first <= max_num_bytes)
+    // search for a lower bound (equal or greater), accept the first chunk that fits including alignment
+    for(auto it = _freeChunks.lower_bound(num_bytes); it != _freeChunks.end() && it->first <= max_num_bytes; ++it)
     {
-        void *ptr = it->second;
-        _usedChunks[ptr] = it->first;
-        _freeChunks.erase(it);
-        return ptr;
+        auto base = reinterpret_cast<uintptr_t>(it->second.base);
+        auto aligned = align_up(base, alignment);
+
+        if(aligned + num_bytes <= base + it->first)
+        {
+            void *ptr = reinterpret_cast<void *>(aligned);
+            _usedChunks[ptr] = {it->second.base, it->first, alignment};
+            _counters.add_used(it->first);
+            erase_free_chunk(it);
+            return ptr;
+        }
     }
 
     // only allocate if we can also de-allocate
     if(_format.alloc_fn && _format.dealloc_fn)
     {
-        void *ptr = _format.alloc_fn(num_bytes);
+        size_t chunk_size = num_bytes + max_padding;
+        if(under_pressure()){ shrink(); }
+        void *base = _format.alloc_fn(chunk_size);
 
-        if(!ptr)
+        if(!base)
         {
             shrink();
-            ptr = _format.alloc_fn(num_bytes);
+            base = _format.alloc_fn(chunk_size);
         }
+        if(!base){ return nullptr; }
 
-        if(ptr){ _usedChunks[ptr] = num_bytes; }
+        void *ptr = reinterpret_cast<void *>(align_up(reinterpret_cast<uintptr_t>(base), alignment));
+        _usedChunks[ptr] = {base, chunk_size, alignment};
+        _counters.add_internal(chunk_size);
+        _counters.add_used(chunk_size);
         return ptr;
     }
 
@@ -75,6 +293,7 @@ void *MemoryCache::allocate(size_t num_bytes)
 void MemoryCache::free(void *ptr)
 {
     if(!ptr){ return; }
+    if(_shards){ return free_sized(ptr); }
 
     std::unique_lock lock(_mutex);
 
@@ -83,38 +302,368 @@ void MemoryCache::free(void *ptr)
 
     if(it != _usedChunks.end())
     {
-        _freeChunks.insert(std::make_pair(it->second, it->first));
+        const auto &chunk = it->second;
+
+        // keep the chunk, but return its pages to the OS
+        if(_format.release_min_bytes && chunk.num_bytes >= _format.release_min_bytes &&
+           virtual_memory::is_mapped(chunk.base))
+        {
+            virtual_memory::release(chunk.base, chunk.num_bytes);
+        }
+        _counters.remove_used(chunk.num_bytes);
+        insert_free_chunk(chunk.num_bytes, chunk.base);
         _usedChunks.erase(it);
     }
 }
 
+void *MemoryCache::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return allocate(num_bytes); }
+
+    if(!num_bytes)
+    {
+        free(ptr);
+        return nullptr;
+    }
+    if(_shards){ return reallocate_sized(ptr, num_bytes); }
+
+    std::unique_lock lock(_mutex);
+
+    auto it = _usedChunks.find(ptr);
+    if(it == _usedChunks.end()){ return nullptr; }
+    chunk_t chunk = it->second;
+
+    // usable bytes, starting at ptr
+    size_t num_bytes_available = static_cast<uint8_t *>(chunk.base) + chunk.num_bytes - static_cast<uint8_t *>(ptr);
+    size_t num_bytes_requested = std::max(num_bytes, _format.min_size);
+
+    // current chunk is large enough and not too large
+    auto max_num_bytes = static_cast<size_t>(static_cast<float>(num_bytes_requested) *
+                                             std::max(_format.size_tolerance, 1.f));
+
+    if(num_bytes_requested <= num_bytes_available && chunk.num_bytes <= max_num_bytes){ return ptr; }
+
+    // move to a different chunk
+    void *new_ptr = allocate(num_bytes, chunk.alignment);
+    if(!new_ptr){ return nullptr; }
+
+    memcpy(new_ptr, ptr, std::min(num_bytes, num_bytes_available));
+    free(ptr);
+    return new_ptr;
+}
+
 void MemoryCache::shrink()
 {
+    if(_shards){ return shrink_sized(); }
+
     std::unique_lock lock(_mutex);
 
     // free memory chunks and clear map
     for(auto &it: _freeChunks)
     {
-        if(_format.dealloc_fn){ _format.dealloc_fn(it.second); }
+        if(_format.dealloc_fn){ _format.dealloc_fn(it.second.base); }
+        _counters.remove_internal(it.first);
     }
     _freeChunks.clear();
+    _lruChunks.clear();
+    _numIdleBytes = 0;
 }
 
-Allocator::state_t MemoryCache::state() const
+size_t MemoryCache::trim(size_t max_num_chunks)
 {
+    if(_shards){ return trim_sized(max_num_chunks); }
+
     std::unique_lock lock(_mutex);
+    auto now = std::chrono::steady_clock::now();
+    size_t num_evicted = 0;
 
-    Allocator::state_t ret = {};
-    ret.num_allocations = _freeChunks.size() + _usedChunks.size();
+    // evict least recently freed chunks first
+    while(num_evicted < max_num_chunks && !_lruChunks.empty() &&
+          exceeds_idle_limits(_lruChunks.begin()->second.second, now))
+    {
+        auto it = _lruChunks.begin()->second.first;
+        _format.dealloc_fn(it->second.base);
+        _counters.remove_internal(it->first);
+        erase_free_chunk(it);
+        num_evicted++;
+    }
+    return num_evicted;
+}
 
-    // collect currently used chunks
-    for(const auto &[ptr, numBytes]: _usedChunks){ ret.num_bytes_used += numBytes; }
+void MemoryCache::insert_free_chunk(size_t num_bytes, void *base)
+{
+    auto it = _freeChunks.insert(std::make_pair(num_bytes, idle_chunk_t{base, _seq}));
+    _lruChunks.emplace_hint(_lruChunks.end(), _seq++, std::make_pair(it, std::chrono::steady_clock::now()));
+    _numIdleBytes += num_bytes;
 
-    ret.num_bytes_allocated = ret.num_bytes_used;
+    // evict least recently freed chunks
+    while(_format.max_idle_bytes && _numIdleBytes > _format.max_idle_bytes)
+    {
+        auto lru_it = _lruChunks.begin()->second.first;
+        _format.dealloc_fn(lru_it->second.base);
+        _counters.remove_internal(lru_it->first);
+        erase_free_chunk(lru_it);
+    }
+}
 
-    // collect idle/free chunks
-    for(const auto &[numBytes, ptr]: _freeChunks){ ret.num_bytes_allocated += numBytes; }
+void MemoryCache::erase_free_chunk(free_ptr_map_t::iterator it)
+{
+    _numIdleBytes -= it->first;
+    _lruChunks.erase(it->second.seq);
+    _freeChunks.erase(it);
+}
+
+bool MemoryCache::exceeds_idle_limits(std::chrono::steady_clock::time_point idle_since,
+                                      std::chrono::steady_clock::time_point now) const
+{
+    return (_format.max_idle_bytes && _numIdleBytes > _format.max_idle_bytes) ||
+           (_format.max_idle_duration.count() && now - idle_since > _format.max_idle_duration);
+}
+
+Allocator::state_t MemoryCache::state() const
+{
+    Allocator::state_t ret = _counters.state();
 
+    // largest free chunk
+    size_t max_free_bytes = 0;
+
+    if(_shards)
+    {
+        for(uint32_t i = 0; i < _num_shards; ++i)
+        {
+            auto &shard = _shards[i];
+            std::unique_lock lock(shard.mutex);
+            uint32_t max_free_class = shard.max_free_class.load(std::memory_order_relaxed);
+            if(max_free_class){ max_free_bytes = std::max(max_free_bytes, class_size(max_free_class - 1)); }
+        }
+    }
+    else
+    {
+        std::unique_lock lock(_mutex);
+        if(!_freeChunks.empty()){ max_free_bytes = _freeChunks.rbegin()->first; }
+    }
+    ret.fragmentation = fragmentation(_numIdleBytes, max_free_bytes);
     return ret;
 }
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+//! returns the range of acceptable size-classes for an allocation
+static std::pair<uint32_t, uint32_t> class_range(size_t num_bytes, size_t alignment, float size_tolerance)
+{
+    // alloc_fn guarantees alignof(std::max_align_t), larger alignments might require padding
+    size_t max_padding = alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+    size_t num_required = num_bytes + sizeof(chunk_header_t) + max_padding;
+    uint32_t first_class = size_class(num_required);
+
+    // largest size-class within size_tolerance
+    auto max_num_bytes = static_cast<size_t>(static_cast<float>(num_required) * std::max(size_tolerance, 1.f));
+    uint32_t last_class = size_class(max_num_bytes);
+    if(class_size(last_class) > max_num_bytes){ last_class--; }
+    return {first_class, std::max(first_class, last_class)};
+}
+
+chunk_header_t *MemoryCache::pop_chunk(cache_shard_t &shard, uint32_t first_class, uint32_t last_class)
+{
+    for(uint32_t c = first_class; c <= last_class; ++c)
+    {
+        if(auto *chunk = shard.free_lists[c])
+        {
+            list_remove(shard.free_lists[c], chunk);
+            lru_remove(shard, chunk);
+            shard_update_max_free_class(shard, c);
+            shard.num_free_chunks--;
+            shard.num_free_bytes -= chunk->num_bytes;
+            _numIdleBytes -= chunk->num_bytes;
+            return chunk;
+        }
+    }
+    return nullptr;
+}
+
+void MemoryCache::evict_chunk(cache_shard_t &shard, chunk_header_t *chunk)
+{
+    list_remove(shard.free_lists[chunk->size_class], chunk);
+    lru_remove(shard, chunk);
+    shard_update_max_free_class(shard, chunk->size_class);
+    shard.num_free_chunks--;
+    shard.num_free_bytes -= chunk->num_bytes;
+    _numIdleBytes -= chunk->num_bytes;
+    _counters.remove_internal(chunk->num_bytes);
+    _format.dealloc_fn(chunk);
+}
+
+void *MemoryCache::allocate_sized(size_t num_bytes, size_t alignment)
+{
+    auto [first_class, last_class] = class_range(std::max(num_bytes, _format.min_size), alignment,
+                                                 _format.size_tolerance);
+    uint32_t shard_index = thread_index() & (_num_shards - 1);
+
+    // search the calling thread's shard first, then all others.
+    // shards without a sufficiently large free chunk are skipped without locking them,
+    // a stale read only results in allocating a new chunk
+    for(uint32_t i = 0; i < _num_shards; ++i)
+    {
+        auto &shard = _shards[(shard_index + i) & (_num_shards - 1)];
+        if(shard.max_free_class.load(std::memory_order_relaxed) <= first_class){ continue; }
+        std::unique_lock lock(shard.mutex);
+
+        if(auto *chunk = pop_chunk(shard, first_class, last_class))
+        {
+            _counters.add_used(chunk->num_bytes);
+            return use_chunk(shard, chunk, alignment);
+        }
+    }
+
+    // only allocate if we can also de-allocate
+    if(!_format.alloc_fn || !_format.dealloc_fn){ return nullptr; }
+
+    size_t chunk_size = class_size(first_class);
+    if(under_pressure()){ shrink_sized(); }
+    void *base = _format.alloc_fn(chunk_size);
+
+    if(!base)
+    {
+        shrink_sized();
+        base = _format.alloc_fn(chunk_size);
+    }
+    if(!base){ return nullptr; }
+
+    auto *chunk = new(base) chunk_header_t;
+    chunk->num_bytes = chunk_size;
+    chunk->size_class = first_class;
+    chunk->shard = shard_index;
+    chunk->mapped = _format.release_min_bytes && virtual_memory::is_mapped(base);
+    _counters.add_internal(chunk_size);
+    _counters.add_used(chunk_size);
+
+    auto &shard = _shards[shard_index];
+    std::unique_lock lock(shard.mutex);
+    return use_chunk(shard, chunk, alignment);
+}
+
+void MemoryCache::free_sized(void *ptr)
+{
+    // not allocated by a size-class cache or freed already
+    auto *chunk = chunk_header(ptr);
+    if(!chunk){ return; }
+
+    auto &shard = _shards[chunk->shard];
+
+    std::unique_lock lock(shard.mutex);
+    chunk->magic = k_chunk_free;
+    list_remove(shard.used_list, chunk);
+    shard.num_used_chunks--;
+    shard.num_used_bytes -= chunk->num_bytes;
+    _counters.remove_used(chunk->num_bytes);
+
+    // keep the chunk, but return its pages to the OS (except for the header)
+    if(_format.release_min_bytes && chunk->mapped && chunk->num_bytes >= _format.release_min_bytes)
+    {
+        virtual_memory::release(chunk + 1, chunk->num_bytes - sizeof(chunk_header_t));
+    }
+    list_push(shard.free_lists[chunk->size_class], chunk);
+    shard.max_free_class.store(std::max(shard.max_free_class.load(std::memory_order_relaxed), chunk->size_class + 1),
+                               std::memory_order_relaxed);
+    shard.num_free_chunks++;
+    shard.num_free_bytes += chunk->num_bytes;
+    _numIdleBytes += chunk->num_bytes;
+
+    // timestamps are only required for eviction
+    if(_format.max_idle_duration.count() || _format.max_idle_bytes)
+    {
+        chunk->idle_since = std::chrono::steady_clock::now();
+    }
+    lru_push(shard, chunk);
+    lock.unlock();
+
+    if(_format.max_idle_bytes){ evict_idle_bytes_sized(); }
+}
+
+void MemoryCache::evict_idle_bytes_sized()
+{
+    while(_numIdleBytes > _format.max_idle_bytes)
+    {
+        // shard holding the least recently freed chunk, across all shards
+        cache_shard_t *oldest = nullptr;
+        auto oldest_since = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+
+        for(uint32_t i = 0; i < _num_shards; ++i)
+        {
+            auto since = _shards[i].lru_tail_since.load(std::memory_order_relaxed);
+            if(since < oldest_since)
+            {
+                oldest = &_shards[i];
+                oldest_since = since;
+            }
+        }
+        if(!oldest){ return; }
+
+        // shard might have changed meanwhile, evict its current tail
+        std::unique_lock lock(oldest->mutex);
+        if(oldest->lru_tail && _numIdleBytes > _format.max_idle_bytes){ evict_chunk(*oldest, oldest->lru_tail); }
+    }
+}
+
+void *MemoryCache::reallocate_sized(void *ptr, size_t num_bytes)
+{
+    auto *chunk = chunk_header(ptr);
+    if(!chunk){ return nullptr; }
+    size_t alignment = chunk->alignment;
+    size_t num_bytes_available = reinterpret_cast<uint8_t *>(chunk) + chunk->num_bytes - static_cast<uint8_t *>(ptr);
+
+    // current chunk is large enough and not too large
+    size_t num_bytes_requested = std::max(num_bytes, _format.min_size);
+    auto [first_class, last_class] = class_range(num_bytes_requested, alignment, _format.size_tolerance);
+    if(num_bytes_requested <= num_bytes_available && chunk->size_class <= last_class){ return ptr; }
+
+    // move to a different chunk
+    void *new_ptr = allocate_sized(num_bytes, alignment);
+    if(!new_ptr){ return nullptr; }
+
+    memcpy(new_ptr, ptr, std::min(num_bytes, num_bytes_available));
+    free_sized(ptr);
+    return new_ptr;
+}
+
+void MemoryCache::shrink_sized()
+{
+    for(uint32_t i = 0; i < _num_shards; ++i)
+    {
+        auto &shard = _shards[i];
+        std::unique_lock lock(shard.mutex);
+
+        for(auto *&head: shard.free_lists)
+        {
+            while(head){ _format.dealloc_fn(std::exchange(head, head->next)); }
+        }
+        _numIdleBytes -= shard.num_free_bytes;
+        _counters.num_allocations -= shard.num_free_chunks;
+        _counters.num_bytes_allocated -= shard.num_free_bytes;
+        shard.lru_head = shard.lru_tail = nullptr;
+        lru_update_since(shard);
+        shard.max_free_class.store(0, std::memory_order_relaxed);
+        shard.num_free_chunks = shard.num_free_bytes = 0;
+    }
+}
+
+size_t MemoryCache::trim_sized(size_t max_num_chunks)
+{
+    auto now = std::chrono::steady_clock::now();
+    size_t num_evicted = 0;
+
+    for(uint32_t i = 0; i < _num_shards && num_evicted < max_num_chunks; ++i)
+    {
+        auto &shard = _shards[i];
+        std::unique_lock lock(shard.mutex);
+
+        while(num_evicted < max_num_chunks && shard.lru_tail && exceeds_idle_limits(shard.lru_tail->idle_since, now))
+        {
+            evict_chunk(shard, shard.lru_tail);
+            num_evicted++;
+        }
+    }
+    return num_evicted;
+}
+
 }
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "crocore/MonotonicArena.hpp"
+#include "crocore/utils.hpp"
+
+namespace crocore
+{
+
+//! header at the beginning of each chunk
+struct alignas(std::max_align_t) MonotonicArena::chunk_t
+{
+    chunk_t *next = nullptr;
+
+    //! total size in bytes, including this header
+    size_t num_bytes = 0;
+
+    uint8_t *begin(){ return reinterpret_cast<uint8_t *>(this) + sizeof(chunk_t); }
+
+    uint8_t *end(){ return reinterpret_cast<uint8_t *>(this) + num_bytes; }
+};
+
+static inline uint8_t *align_ptr(uint8_t *ptr, size_t alignment)
+{
+    return reinterpret_cast<uint8_t *>(align_up(reinterpret_cast<uintptr_t>(ptr), alignment));
+}
+
+MonotonicArenaUPtr MonotonicArena::create(create_info_t create_info)
+{
+    return MonotonicArenaUPtr(new MonotonicArena(std::move(create_info)));
+}
+
+MonotonicArena::MonotonicArena(create_info_t create_info) : m_format(std::move(create_info))
+{
+    m_format.chunk_size = std::max(m_format.chunk_size, 2 * sizeof(chunk_t));
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    for(chunk_t *chunk = m_first; chunk && m_format.dealloc_fn;)
+    {
+        chunk_t *next = chunk->next;
+        m_format.dealloc_fn(chunk);
+        chunk = next;
+    }
+}
+
+void *MonotonicArena::allocate(size_t num_bytes)
+{
+    return allocate(num_bytes, alignof(std::max_align_t));
+}
+
+void *MonotonicArena::allocate(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment)){ return nullptr; }
+
+    uint8_t *ptr = m_current ? align_ptr(m_ptr, alignment) : nullptr;
+
+    // current chunk exhausted
+    if(!ptr || ptr > m_end || num_bytes > static_cast<size_t>(m_end - ptr))
+    {
+        if(!next_chunk(num_bytes, alignment)){ return nullptr; }
+        ptr = align_ptr(m_ptr, alignment);
+    }
+    m_last = ptr;
+    m_ptr = ptr + num_bytes;
+    return ptr;
+}
+
+bool MonotonicArena::next_chunk(size_t num_bytes, size_t alignment)
+{
+    // header, payload and worst-case padding
+    size_t num_required_bytes = sizeof(chunk_t) + num_bytes;
+    if(alignment > alignof(chunk_t)){ num_required_bytes += alignment; }
+    if(num_required_bytes < num_bytes){ return false; }
+
+    // re-use the next chunk in chain, if large enough
+    chunk_t *chunk = m_current ? m_current->next : m_first;
+
+    if(!chunk || chunk->num_bytes < num_required_bytes)
+    {
+        if(!m_format.alloc_fn){ return false; }
+
+        size_t chunk_size = std::max(m_format.chunk_size, num_required_bytes);
+        void *data = m_format.alloc_fn(chunk_size);
+        if(!data){ return false; }
+
+        // insert after current chunk, skipped chunks stay in chain
+        chunk = new(data) chunk_t{};
+        chunk->num_bytes = chunk_size;
+
+        if(m_current)
+        {
+            chunk->next = m_current->next;
+            m_current->next = chunk;
+        }
+        else
+        {
+            chunk->next = m_first;
+            m_first = chunk;
+        }
+        m_num_chunks++;
+        m_num_bytes_allocated += chunk_size;
+    }
+
+    if(m_current){ m_num_bytes_used_before += m_ptr - m_current->begin(); }
+    m_current = chunk;
+    m_ptr = chunk->begin();
+    m_end = chunk->end();
+    m_last = nullptr;
+    return true;
+}
+
+void *MonotonicArena::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return allocate(num_bytes); }
+
+    if(!num_bytes)
+    {
+        free(ptr);
+        return nullptr;
+    }
+
+    // resize the most recent allocation in place
+    if(ptr == m_last && num_bytes <= static_cast<size_t>(m_end - m_last))
+    {
+        m_ptr = m_last + num_bytes;
+        return ptr;
+    }
+
+    // sizes of other allocations are unknown, copy up to the end of their chunk (or the bump-pointer)
+    auto *src = static_cast<uint8_t *>(ptr);
+    size_t num_bytes_available = 0;
+
+    for(chunk_t *chunk = m_first; chunk; chunk = chunk->next)
+    {
+        uint8_t *end = chunk == m_current ? m_ptr : chunk->end();
+
+        if(src >= chunk->begin() && src < end)
+        {
+            num_bytes_available = end - src;
+            break;
+        }
+        if(chunk == m_current){ break; }
+    }
+
+    // not allocated from this arena
+    if(!num_bytes_available){ return nullptr; }
+
+    // keep the original alignment, approximated by the address' alignment.
+    // alignments do not exceed sizes, so the new size bounds the padding
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    size_t alignment = std::min<size_t>(address & (~address + 1),
+                                        std::max<size_t>(alignof(std::max_align_t), std::bit_floor(num_bytes)));
+
+    void *new_ptr = allocate(num_bytes, alignment);
+    if(new_ptr){ memcpy(new_ptr, ptr, std::min(num_bytes, num_bytes_available)); }
+    return new_ptr;
+}
+
+void MonotonicArena::free(void *ptr)
+{
+    // rewind most recent allocation
+    if(ptr && ptr == m_last)
+    {
+        m_ptr = m_last;
+        m_last = nullptr;
+    }
+}
+
+void MonotonicArena::shrink()
+{
+    if(!m_current || !m_format.dealloc_fn){ return; }
+
+    // chunks behind the current one are unused
+    for(chunk_t *chunk = m_current->next; chunk;)
+    {
+        chunk_t *next = chunk->next;
+        m_num_chunks--;
+        m_num_bytes_allocated -= chunk->num_bytes;
+        m_format.dealloc_fn(chunk);
+        chunk = next;
+    }
+    m_current->next = nullptr;
+}
+
+Allocator::state_t MonotonicArena::state() const
+{
+    Allocator::state_t ret = {};
+    ret.num_allocations = m_num_chunks;
+    ret.num_bytes_allocated = m_num_bytes_allocated;
+    ret.num_bytes_used = m_num_bytes_used_before + (m_current ? m_ptr - m_current->begin() : 0);
+    return ret;
+}
+
+void MonotonicArena::reset()
+{
+    m_current = m_first;
+    m_ptr = m_current ? m_current->begin() : nullptr;
+    m_end = m_current ? m_current->end() : nullptr;
+    m_last = nullptr;
+    m_num_bytes_used_before = 0;
+}
+
+}// namespace crocore
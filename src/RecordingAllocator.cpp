@@ -0,0 +1,188 @@
+#include <bit>
+#include <cstring>
+
+#include "crocore/filesystem.hpp"
+#include "crocore/utils.hpp"
+#include "crocore/RecordingAllocator.hpp"
+
+namespace crocore
+{
+
+//! file-header for binary traces
+struct trace_header_t
+{
+    char magic[8] = {'C', 'R', 'O', 'T', 'R', 'A', 'C', 'E'};
+    uint32_t version = 1;
+    uint32_t event_size = sizeof(trace_event_t);
+    uint64_t num_events = 0;
+};
+
+RecordingAllocatorUPtr RecordingAllocator::create(create_info_t create_info)
+{
+    if(!create_info.allocator){ return nullptr; }
+    return RecordingAllocatorUPtr(new RecordingAllocator(std::move(create_info)));
+}
+
+RecordingAllocator::RecordingAllocator(create_info_t create_info) : m_allocator(std::move(create_info.allocator))
+{
+    m_events.reserve(create_info.num_reserved_events);
+}
+
+void *RecordingAllocator::allocate(size_t num_bytes)
+{
+    void *ptr = m_allocator->allocate(num_bytes);
+
+    if(ptr)
+    {
+        std::unique_lock lock(m_mutex);
+        record_allocation(ptr, num_bytes, 0);
+    }
+    return ptr;
+}
+
+void *RecordingAllocator::allocate(size_t num_bytes, size_t alignment)
+{
+    void *ptr = m_allocator->allocate(num_bytes, alignment);
+
+    if(ptr)
+    {
+        std::unique_lock lock(m_mutex);
+        record_allocation(ptr, num_bytes, alignment);
+    }
+    return ptr;
+}
+
+void RecordingAllocator::record_allocation(void *ptr, size_t num_bytes, size_t alignment)
+{
+    uint64_t id = m_next_id++;
+    m_ids[ptr] = id;
+
+    trace_event_t event = {};
+    event.id = id;
+    event.num_bytes = num_bytes;
+    event.thread = thread_index();
+    event.op = TraceOp::ALLOCATE;
+    event.alignment_log2 = alignment ? static_cast<uint8_t>(std::countr_zero(alignment)) : 0;
+    m_events.push_back(event);
+}
+
+void *RecordingAllocator::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return allocate(num_bytes); }
+
+    if(!num_bytes)
+    {
+        free(ptr);
+        return nullptr;
+    }
+
+    // keep the lock, the old address might be re-used concurrently
+    std::unique_lock lock(m_mutex);
+
+    void *new_ptr = m_allocator->reallocate(ptr, num_bytes);
+    if(!new_ptr){ return nullptr; }
+
+    auto it = m_ids.find(ptr);
+
+    // allocation was not recorded
+    if(it == m_ids.end()){ return new_ptr; }
+
+    trace_event_t event = {};
+    event.id = it->second;
+    event.num_bytes = num_bytes;
+    event.thread = thread_index();
+    event.op = TraceOp::REALLOCATE;
+    m_events.push_back(event);
+
+    if(new_ptr != ptr)
+    {
+        m_ids.erase(it);
+        m_ids[new_ptr] = event.id;
+    }
+    return new_ptr;
+}
+
+void RecordingAllocator::free(void *ptr)
+{
+    if(!ptr){ return; }
+
+    // record before forwarding, the address might be re-used right away
+    {
+        std::unique_lock lock(m_mutex);
+        auto it = m_ids.find(ptr);
+
+        if(it != m_ids.end())
+        {
+            trace_event_t event = {};
+            event.id = it->second;
+            event.thread = thread_index();
+            event.op = TraceOp::FREE;
+            m_events.push_back(event);
+            m_ids.erase(it);
+        }
+    }
+    m_allocator->free(ptr);
+}
+
+void RecordingAllocator::shrink()
+{
+    m_allocator->shrink();
+}
+
+Allocator::state_t RecordingAllocator::state() const
+{
+    return m_allocator->state();
+}
+
+std::vector<trace_event_t> RecordingAllocator::trace() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_events;
+}
+
+void RecordingAllocator::clear()
+{
+    std::unique_lock lock(m_mutex);
+    m_events.clear();
+}
+
+bool RecordingAllocator::save(const std::filesystem::path &path) const
+{
+    std::unique_lock lock(m_mutex);
+
+    trace_header_t header = {};
+    header.num_events = m_events.size();
+
+    std::vector<uint8_t> data(sizeof(trace_header_t) + m_events.size() * sizeof(trace_event_t));
+    memcpy(data.data(), &header, sizeof(trace_header_t));
+    if(!m_events.empty())
+    {
+        memcpy(data.data() + sizeof(trace_header_t), m_events.data(), m_events.size() * sizeof(trace_event_t));
+    }
+    return fs::write_file(path, data);
+}
+
+std::vector<trace_event_t> RecordingAllocator::load(const std::filesystem::path &path)
+{
+    std::vector<uint8_t> data;
+
+    try{ data = fs::read_binary_file(path); }
+    catch(std::exception &){ return {}; }
+
+    trace_header_t header = {}, expected = {};
+    if(data.size() < sizeof(trace_header_t)){ return {}; }
+    memcpy(&header, data.data(), sizeof(trace_header_t));
+
+    if(memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+       header.event_size != expected.event_size ||
+       (data.size() - sizeof(trace_header_t)) / sizeof(trace_event_t) < header.num_events)
+    {
+        return {};
+    }
+
+    std::vector<trace_event_t> ret(header.num_events);
+    if(!ret.empty()){ memcpy(ret.data(), data.data() + sizeof(trace_header_t), ret.size() * sizeof(trace_event_t)); }
+    return ret;
+}
+
+}// namespace crocore
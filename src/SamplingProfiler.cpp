@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "crocore/filesystem.hpp"
+#include "crocore/SamplingProfiler.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define CROCORE_HAS_BACKTRACE
+#endif
+
+#if __has_include(<dlfcn.h>) && __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#define CROCORE_HAS_DLADDR
+#endif
+
+#if defined(_MSC_VER)
+#define CROCORE_NOINLINE __declspec(noinline)
+#else
+#define CROCORE_NOINLINE __attribute__((noinline))
+#endif
+
+namespace crocore
+{
+
+//! frames of on_allocate() and the public entry-point, omitted from call-stacks
+constexpr uint32_t k_num_skipped_frames = 2;
+
+//! capture up to max_depth return-addresses of the calling thread, innermost first. returns the number of frames
+static inline uint32_t capture_stack(void **frames, uint32_t max_depth)
+{
+#if defined(_WIN32)
+    return CaptureStackBackTrace(0, max_depth, frames, nullptr);
+#elif defined(CROCORE_HAS_BACKTRACE)
+    return static_cast<uint32_t>(std::max(backtrace(frames, static_cast<int>(max_depth)), 0));
+#else
+    (void) frames;
+    (void) max_depth;
+    return 0;
+#endif
+}
+
+//! returns a (demangled) function-name for a return-address, or its hex-representation if unknown
+static std::string symbol_name(void *address)
+{
+#if defined(CROCORE_HAS_DLADDR)
+    Dl_info info = {};
+
+    if(dladdr(address, &info) && info.dli_sname)
+    {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string ret = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+
+        // semicolons separate frames in collapsed stacks
+        std::replace(ret.begin(), ret.end(), ';', ':');
+        return ret;
+    }
+#endif
+    std::stringstream ss;
+    ss << address;
+    return ss.str();
+}
+
+//! FNV-1a hash over return-addresses
+static inline size_t hash_stack(void *const *frames, uint32_t num_frames)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(uint32_t i = 0; i < num_frames; ++i)
+    {
+        hash ^= reinterpret_cast<uintptr_t>(frames[i]);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+SamplingProfilerUPtr SamplingProfiler::create(create_info_t create_info)
+{
+    if(!create_info.allocator){ return nullptr; }
+    return SamplingProfilerUPtr(new SamplingProfiler(std::move(create_info)));
+}
+
+SamplingProfiler::SamplingProfiler(create_info_t create_info) :
+        m_allocator(std::move(create_info.allocator)),
+        m_format(std::move(create_info)),
+        m_filter(new std::atomic<uint32_t>[s_filter_size]()),
+        m_rng(m_format.seed)
+{
+    m_format.sample_interval = std::max<size_t>(m_format.sample_interval, 1);
+    m_num_counters = static_cast<uint32_t>(next_pow_2(std::max(1U, std::thread::hardware_concurrency())));
+    m_counters.reset(new counter_t[m_num_counters]);
+    for(uint32_t i = 0; i < m_num_counters; ++i){ m_counters[i].num_bytes_until_sample = next_interval(); }
+}
+
+int64_t SamplingProfiler::next_interval()
+{
+    if(m_format.sample_interval == 1){ return 1; }
+
+    // exponentially distributed intervals sample each byte with equal probability
+    std::exponential_distribution<double> distribution(1.0 / static_cast<double>(m_format.sample_interval));
+    return std::max<int64_t>(static_cast<int64_t>(distribution(m_rng)), 1);
+}
+
+CROCORE_NOINLINE void SamplingProfiler::on_allocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr || !num_bytes){ return; }
+
+    auto &counter = m_counters[thread_index() & (m_num_counters - 1)].num_bytes_until_sample;
+    int64_t num_bytes_until_sample = counter.fetch_sub(static_cast<int64_t>(num_bytes), std::memory_order_relaxed);
+
+    // fast path, no interval crossed (or another thread is about to take the sample)
+    if(num_bytes_until_sample <= 0 || num_bytes_until_sample > static_cast<int64_t>(num_bytes)){ return; }
+
+    std::vector<void *> frames(m_format.max_stack_depth + k_num_skipped_frames);
+    uint32_t num_frames = capture_stack(frames.data(), static_cast<uint32_t>(frames.size()));
+    uint32_t first_frame = std::min(num_frames, k_num_skipped_frames);
+    num_frames -= first_frame;
+
+    // weight by inverse sampling-probability
+    double probability = 1.0 - std::exp(-static_cast<double>(num_bytes) / static_cast<double>(m_format.sample_interval));
+    double num_allocations = m_format.sample_interval == 1 ? 1.0 : 1.0 / probability;
+
+    sample_t sample = {};
+    sample.num_allocations = static_cast<size_t>(std::round(num_allocations));
+    sample.num_bytes = static_cast<size_t>(std::round(num_allocations * static_cast<double>(num_bytes)));
+
+    std::unique_lock lock(m_mutex);
+    counter.store(next_interval(), std::memory_order_relaxed);
+
+    // find or create the call-site
+    size_t hash = hash_stack(frames.data() + first_frame, num_frames);
+    auto [first, last] = m_call_site_indices.equal_range(hash);
+    auto it = std::find_if(first, last, [&](const auto &pair) {
+        const auto &site_frames = m_call_sites[pair.second].frames;
+        return std::equal(site_frames.begin(), site_frames.end(), frames.begin() + first_frame,
+                          frames.begin() + first_frame + num_frames);
+    });
+
+    if(it != last){ sample.call_site = it->second; }
+    else
+    {
+        sample.call_site = static_cast<uint32_t>(m_call_sites.size());
+        call_site_t call_site = {};
+        call_site.frames.assign(frames.begin() + first_frame, frames.begin() + first_frame + num_frames);
+        m_call_sites.push_back(std::move(call_site));
+        m_call_site_indices.emplace(hash, sample.call_site);
+    }
+
+    auto &call_site = m_call_sites[sample.call_site];
+    call_site.num_live_allocations += sample.num_allocations;
+    call_site.num_live_bytes += sample.num_bytes;
+    call_site.num_allocations += sample.num_allocations;
+    call_site.num_bytes += sample.num_bytes;
+
+    m_samples[ptr] = sample;
+    m_filter[filter_index(ptr)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SamplingProfiler::on_free(void *ptr)
+{
+    // fast path, address was not sampled
+    if(!ptr || !m_filter[filter_index(ptr)].load(std::memory_order_relaxed)){ return; }
+
+    std::unique_lock lock(m_mutex);
+    auto it = m_samples.find(ptr);
+    if(it == m_samples.end()){ return; }
+
+    auto &call_site = m_call_sites[it->second.call_site];
+    call_site.num_live_allocations -= it->second.num_allocations;
+    call_site.num_live_bytes -= it->second.num_bytes;
+    m_filter[filter_index(ptr)].fetch_sub(1, std::memory_order_relaxed);
+    m_samples.erase(it);
+}
+
+void *SamplingProfiler::allocate(size_t num_bytes)
+{
+    void *ptr = m_allocator->allocate(num_bytes);
+    on_allocate(ptr, num_bytes);
+    return ptr;
+}
+
+void *SamplingProfiler::allocate(size_t num_bytes, size_t alignment)
+{
+    void *ptr = m_allocator->allocate(num_bytes, alignment);
+    on_allocate(ptr, num_bytes);
+    return ptr;
+}
+
+Allocator::allocation_t SamplingProfiler::allocate_handle(size_t num_bytes)
+{
+    auto allocation = m_allocator->allocate_handle(num_bytes);
+    on_allocate(allocation.ptr, num_bytes);
+    return allocation;
+}
+
+void *SamplingProfiler::reallocate(void *ptr, size_t num_bytes)
+{
+    // a failed reallocation drops the sample of the original allocation
+    on_free(ptr);
+    void *new_ptr = m_allocator->reallocate(ptr, num_bytes);
+    on_allocate(new_ptr, num_bytes);
+    return new_ptr;
+}
+
+void SamplingProfiler::free(void *ptr)
+{
+    // before forwarding, the address might be re-used right away
+    on_free(ptr);
+    m_allocator->free(ptr);
+}
+
+void SamplingProfiler::free(void *ptr, size_t num_bytes)
+{
+    on_free(ptr);
+    m_allocator->free(ptr, num_bytes);
+}
+
+void SamplingProfiler::free(const allocation_t &allocation)
+{
+    on_free(allocation.ptr);
+    m_allocator->free(allocation);
+}
+
+void SamplingProfiler::shrink()
+{
+    m_allocator->shrink();
+}
+
+Allocator::state_t SamplingProfiler::state() const
+{
+    return m_allocator->state();
+}
+
+std::vector<SamplingProfiler::call_site_t> SamplingProfiler::call_sites() const
+{
+    std::vector<call_site_t> ret;
+    {
+        std::unique_lock lock(m_mutex);
+        ret = m_call_sites;
+    }
+    std::stable_sort(ret.begin(), ret.end(), [](const call_site_t &lhs, const call_site_t &rhs) {
+        return lhs.num_live_bytes > rhs.num_live_bytes;
+    });
+    return ret;
+}
+
+void SamplingProfiler::clear()
+{
+    std::unique_lock lock(m_mutex);
+    m_call_sites.clear();
+    m_call_site_indices.clear();
+    m_samples.clear();
+    for(size_t i = 0; i < s_filter_size; ++i){ m_filter[i] = 0; }
+}
+
+std::string SamplingProfiler::profile(ProfileFormat format) const
+{
+    auto sites = call_sites();
+    std::stringstream ss;
+
+    if(format == ProfileFormat::COLLAPSED)
+    {
+        // root first, one line per call-site with live bytes
+        for(const auto &site: sites)
+        {
+            if(!site.num_live_bytes){ continue; }
+
+            for(auto it = site.frames.rbegin(); it != site.frames.rend(); ++it)
+            {
+                if(it != site.frames.rbegin()){ ss << ';'; }
+                ss << symbol_name(*it);
+            }
+            if(site.frames.empty()){ ss << "[unknown]"; }
+            ss << ' ' << site.num_live_bytes << '\n';
+        }
+        return ss.str();
+    }
+
+    // pprof legacy heap-profile, sizes are already un-sampled
+    call_site_t total = {};
+
+    for(const auto &site: sites)
+    {
+        total.num_live_allocations += site.num_live_allocations;
+        total.num_live_bytes += site.num_live_bytes;
+        total.num_allocations += site.num_allocations;
+        total.num_bytes += site.num_bytes;
+    }
+
+    auto write_counts = [&ss](const call_site_t &site) {
+        ss << site.num_live_allocations << ": " << site.num_live_bytes << " [" << site.num_allocations << ": "
+           << site.num_bytes << "] @";
+    };
+    ss << "heap profile: ";
+    write_counts(total);
+    ss << " heap\n";
+
+    for(const auto &site: sites)
+    {
+        write_counts(site);
+        for(void *frame: site.frames){ ss << ' ' << frame; }
+        ss << '\n';
+    }
+
+    // memory-mappings, required to symbolize addresses
+    ss << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    if(maps){ ss << maps.rdbuf(); }
+    return ss.str();
+}
+
+bool SamplingProfiler::save(const std::filesystem::path &path, ProfileFormat format) const
+{
+    return fs::write_file(path, profile(format));
+}
+
+}// namespace crocore
@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "crocore/SlabAllocator.hpp"
+#include "crocore/tagged_index_list.h"
+
+namespace crocore
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+//! invalid object-index
+constexpr uint32_t k_invalid_index = std::numeric_limits<uint32_t>::max();
+
+//! marks a released slab in slab_t::num_used
+constexpr uint32_t k_dead_bit = 1U << 31U;
+
+//! reserved space at the start of each slab, holding a pointer to its slab_t record
+constexpr size_t k_slab_header_size = k_cache_line_size;
+
+/**
+ * @brief   slab_t is the record for a slab of equally sized objects.
+ *
+ *          Free objects are linked by storing the index of the next free object in their first four bytes.
+ *          Allocating threads first reserve an object by incrementing num_used, which prevents the slab from
+ *          being released, so the object-memory stays valid while popping from the free-list.
+ */
+struct slab_t
+{
+    //! number of used objects plus pending reservations, k_dead_bit marks a released slab
+    std::atomic<uint32_t> num_used = 0;
+
+    //! free objects, linked via their first four bytes
+    tagged_index_list free_list;
+
+    //! objects with an index above were never used
+    std::atomic<uint32_t> first_unused_object = 0;
+
+    uint32_t class_index = 0;
+    uint32_t object_size = 0;
+    uint32_t num_objects = 0;
+
+    //! position within its size-class's list of slabs
+    uint32_t list_index = 0;
+
+    uint8_t *data = nullptr;
+};
+
+static inline uint8_t *slab_object(const slab_t &slab, uint32_t index)
+{
+    return slab.data + k_slab_header_size + size_t(index) * slab.object_size;
+}
+
+//! the link to the next free object is stored in the first four bytes of a free object
+static inline std::atomic_ref<uint32_t> slab_link(const slab_t &slab, uint32_t index)
+{
+    return std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t *>(slab_object(slab, index)));
+}
+
+//! pop an object from a slab, requires a reservation
+static void *slab_pop(slab_t &slab)
+{
+    // the object might have been handed out concurrently, in which case the CAS fails
+    uint32_t first_free = slab.free_list.pop([&slab](uint32_t index) {
+        return slab_link(slab, index).load(std::memory_order_relaxed);
+    });
+    if(first_free != k_invalid_index){ return slab_object(slab, first_free); }
+
+    // free-list is empty, take an object that has never been used before
+    uint32_t unused = slab.first_unused_object.load(std::memory_order_relaxed);
+
+    while(unused < slab.num_objects)
+    {
+        if(slab.first_unused_object.compare_exchange_weak(unused, unused + 1, std::memory_order_relaxed))
+        {
+            return slab_object(slab, unused);
+        }
+    }
+    return nullptr;
+}
+
+//! push an object to a slab's free-list
+static void slab_push(slab_t &slab, void *ptr)
+{
+    auto object_index = static_cast<uint32_t>((static_cast<uint8_t *>(ptr) - slab.data - k_slab_header_size) /
+                                              slab.object_size);
+
+    slab.free_list.push(object_index, [&slab](uint32_t index, uint32_t next) {
+        slab_link(slab, index).store(next, std::memory_order_relaxed);
+    });
+}
+
+//! returns the slab_t record for a pointer
+static inline slab_t *slab_record(const void *ptr, size_t slab_size)
+{
+    auto base = reinterpret_cast<uintptr_t>(ptr) & ~(slab_size - 1);
+    return *reinterpret_cast<slab_t **>(base);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+SlabAllocatorUPtr SlabAllocator::create(create_info_t create_info)
+{
+    return SlabAllocatorUPtr(new SlabAllocator(std::move(create_info)));
+}
+
+SlabAllocator::SlabAllocator(create_info_t create_info) : m_format(std::move(create_info))
+{
+    m_format.slab_size = next_pow_2(std::max<size_t>(m_format.slab_size, 4 * k_slab_header_size));
+
+    size_t max_object_size = (m_format.slab_size - k_slab_header_size) / 2;
+    if(!m_format.max_object_size){ m_format.max_object_size = m_format.slab_size / 8; }
+    m_format.max_object_size = std::clamp<size_t>(m_format.max_object_size, 16, max_object_size);
+
+    // multiples of 16 up to 128 bytes, then four size-classes per power of two
+    std::vector<uint32_t> class_sizes;
+
+    for(size_t size = 16; size <= m_format.max_object_size;)
+    {
+        class_sizes.push_back(static_cast<uint32_t>(size));
+        size += size < 128 ? 16 : size_t(1) << (std::bit_width(size) - 3);
+    }
+    if(class_sizes.back() < m_format.max_object_size)
+    {
+        class_sizes.push_back(static_cast<uint32_t>(align_up(m_format.max_object_size, 16)));
+    }
+
+    m_num_classes = static_cast<uint32_t>(class_sizes.size());
+    m_classes.reset(new size_class_t[m_num_classes]);
+    for(uint32_t i = 0; i < m_num_classes; ++i){ m_classes[i].object_size = class_sizes[i]; }
+
+    m_class_lookup.resize(class_sizes.back() / 16 + 1);
+    for(uint32_t i = 0, c = 0; i < m_class_lookup.size(); ++i)
+    {
+        while(class_sizes[c] < i * 16){ c++; }
+        m_class_lookup[i] = static_cast<uint8_t>(c);
+    }
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    for(uint32_t i = 0; i < m_num_classes && m_format.dealloc_fn; ++i)
+    {
+        for(auto *slab: m_classes[i].slabs){ m_format.dealloc_fn(slab->data); }
+    }
+}
+
+size_t SlabAllocator::object_size(size_t num_bytes) const
+{
+    if(num_bytes > m_format.max_object_size){ return 0; }
+    return m_classes[m_class_lookup[(num_bytes + 15) / 16]].object_size;
+}
+
+void *SlabAllocator::allocate(size_t num_bytes)
+{
+    if(!num_bytes || num_bytes > m_format.max_object_size){ return nullptr; }
+    return allocate_class(m_class_lookup[(num_bytes + 15) / 16]);
+}
+
+void *SlabAllocator::allocate(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment) || alignment > k_slab_header_size){ return nullptr; }
+    if(num_bytes > m_format.max_object_size){ return nullptr; }
+
+    // objects are aligned to the largest power of two, dividing their size
+    for(uint32_t c = m_class_lookup[(num_bytes + 15) / 16]; c < m_num_classes; ++c)
+    {
+        if(!(m_classes[c].object_size & (alignment - 1))){ return allocate_class(c); }
+    }
+    return nullptr;
+}
+
+void *SlabAllocator::allocate_class(uint32_t class_index)
+{
+    auto &size_class = m_classes[class_index];
+
+    for(;;)
+    {
+        slab_t *slab = size_class.active.load(std::memory_order_acquire);
+
+        if(slab)
+        {
+            // reserve an object, fails for released slabs
+            uint32_t num_used = slab->num_used.fetch_add(1, std::memory_order_acq_rel);
+
+            if(!(num_used & k_dead_bit) && slab->class_index == class_index)
+            {
+                if(void *ptr = slab_pop(*slab)){ return ptr; }
+            }
+
+            // slab is full or was released, undo reservation
+            if(slab->num_used.fetch_sub(1, std::memory_order_acq_rel) == 1){ try_release(slab); }
+        }
+
+        std::unique_lock lock(m_mutex);
+        if(!refill(class_index, slab)){ return nullptr; }
+    }
+}
+
+bool SlabAllocator::refill(uint32_t class_index, slab_t *observed)
+{
+    auto &size_class = m_classes[class_index];
+    slab_t *active = size_class.active.load(std::memory_order_acquire);
+
+    // another thread already switched slabs
+    if(active != observed){ return true; }
+
+    // pick the slab with the most free objects, if at least a quarter is free
+    slab_t *best = nullptr;
+    uint32_t best_num_free = 0;
+
+    for(auto *slab: size_class.slabs)
+    {
+        uint32_t num_used = slab->num_used.load(std::memory_order_relaxed);
+        uint32_t num_free = num_used < slab->num_objects ? slab->num_objects - num_used : 0;
+
+        if(slab != active && num_free > best_num_free)
+        {
+            best = slab;
+            best_num_free = num_free;
+        }
+    }
+    if(!best || best_num_free < best->num_objects / 4){ best = create_slab(class_index); }
+    if(!best){ return false; }
+
+    size_class.active.store(best, std::memory_order_release);
+
+    // previously active slab might have become empty in the meantime
+    uint32_t expected = 0;
+    if(active && m_format.dealloc_empty_slabs &&
+       active->num_used.compare_exchange_strong(expected, k_dead_bit, std::memory_order_acq_rel))
+    {
+        release_slab(active);
+    }
+    return true;
+}
+
+slab_t *SlabAllocator::create_slab(uint32_t class_index)
+{
+    if(!m_format.alloc_fn || !m_format.dealloc_fn){ return nullptr; }
+
+    auto *data = static_cast<uint8_t *>(m_format.alloc_fn(m_format.slab_size));
+    if(!data){ return nullptr; }
+
+    // slabs are required to be aligned to their size
+    if(reinterpret_cast<uintptr_t>(data) & (m_format.slab_size - 1))
+    {
+        m_format.dealloc_fn(data);
+        return nullptr;
+    }
+
+    // re-use a record or create a new one
+    slab_t *slab;
+
+    if(!m_free_records.empty())
+    {
+        slab = m_free_records.back();
+        m_free_records.pop_back();
+    }
+    else
+    {
+        slab = m_slab_records.emplace_back(new slab_t).get();
+        slab->num_used.store(k_dead_bit, std::memory_order_relaxed);
+    }
+
+    auto &size_class = m_classes[class_index];
+    slab->class_index = class_index;
+    slab->object_size = size_class.object_size;
+    slab->num_objects = static_cast<uint32_t>((m_format.slab_size - k_slab_header_size) / size_class.object_size);
+    slab->data = data;
+    slab->free_list.clear();
+    slab->first_unused_object.store(0, std::memory_order_relaxed);
+    slab->list_index = static_cast<uint32_t>(size_class.slabs.size());
+    size_class.slabs.push_back(slab);
+    *reinterpret_cast<slab_t **>(data) = slab;
+
+    // revive record, preserving pending (failing) reservations of other threads
+    slab->num_used.fetch_and(~k_dead_bit, std::memory_order_release);
+    return slab;
+}
+
+void SlabAllocator::try_release(slab_t *slab)
+{
+    if(!m_format.dealloc_empty_slabs){ return; }
+
+    std::unique_lock lock(m_mutex);
+
+    // active slabs are kept
+    if(slab == m_classes[slab->class_index].active.load(std::memory_order_relaxed)){ return; }
+
+    // fails, if the slab is in use again or was already released
+    uint32_t expected = 0;
+    if(slab->num_used.compare_exchange_strong(expected, k_dead_bit, std::memory_order_acq_rel)){ release_slab(slab); }
+}
+
+void SlabAllocator::release_slab(slab_t *slab)
+{
+    // swap-remove from size-class
+    auto &slabs = m_classes[slab->class_index].slabs;
+    slabs[slab->list_index] = slabs.back();
+    slabs[slab->list_index]->list_index = slab->list_index;
+    slabs.pop_back();
+
+    m_format.dealloc_fn(slab->data);
+    slab->data = nullptr;
+    m_free_records.push_back(slab);
+}
+
+void *SlabAllocator::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return allocate(num_bytes); }
+
+    if(!num_bytes)
+    {
+        free(ptr);
+        return nullptr;
+    }
+    if(num_bytes > m_format.max_object_size){ return nullptr; }
+
+    // same size-class
+    auto *slab = slab_record(ptr, m_format.slab_size);
+    if(m_class_lookup[(num_bytes + 15) / 16] == slab->class_index){ return ptr; }
+
+    void *new_ptr = allocate(num_bytes);
+    if(!new_ptr){ return nullptr; }
+
+    memcpy(new_ptr, ptr, std::min<size_t>(num_bytes, slab->object_size));
+    free(ptr);
+    return new_ptr;
+}
+
+void SlabAllocator::free(void *ptr)
+{
+    if(!ptr){ return; }
+
+    auto *slab = slab_record(ptr, m_format.slab_size);
+    assert(!(slab->num_used.load(std::memory_order_relaxed) & k_dead_bit));
+
+    slab_push(*slab, ptr);
+
+    // last object was returned
+    if(slab->num_used.fetch_sub(1, std::memory_order_acq_rel) == 1){ try_release(slab); }
+}
+
+void SlabAllocator::shrink()
+{
+    std::unique_lock lock(m_mutex);
+
+    for(uint32_t i = 0; i < m_num_classes; ++i)
+    {
+        auto &size_class = m_classes[i];
+
+        // iterate backwards, releasing swaps with the back
+        for(size_t j = size_class.slabs.size(); j-- > 0;)
+        {
+            auto *slab = size_class.slabs[j];
+            uint32_t expected = 0;
+
+            if(slab->num_used.compare_exchange_strong(expected, k_dead_bit, std::memory_order_acq_rel))
+            {
+                if(slab == size_class.active.load(std::memory_order_relaxed))
+                {
+                    size_class.active.store(nullptr, std::memory_order_release);
+                }
+                release_slab(slab);
+            }
+        }
+    }
+}
+
+Allocator::state_t SlabAllocator::state() const
+{
+    std::unique_lock lock(m_mutex);
+
+    Allocator::state_t ret = {};
+
+    for(uint32_t i = 0; i < m_num_classes; ++i)
+    {
+        for(const auto *slab: m_classes[i].slabs)
+        {
+            uint32_t num_used = slab->num_used.load(std::memory_order_relaxed) & ~k_dead_bit;
+            ret.num_allocations++;
+            ret.num_bytes_allocated += m_format.slab_size;
+            ret.num_bytes_used += size_t(num_used) * slab->object_size;
+        }
+    }
+    return ret;
+}
+
+}// namespace crocore
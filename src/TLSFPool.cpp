@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include "crocore/TLSFPool.hpp"
+
+namespace crocore
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+//! log2 of the size-granularity and alignment of blocks
+constexpr uint32_t k_align_log2 = 4;
+
+constexpr size_t k_block_alignment = size_t(1) << k_align_log2;
+
+//! log2 of the number of second-level lists per first-level
+constexpr uint32_t k_sl_log2 = 5;
+
+constexpr uint32_t k_sl_count = 1U << k_sl_log2;
+
+//! blocks smaller than k_small_block_size are kept in linear lists of first-level 0
+constexpr uint32_t k_fl_shift = k_sl_log2 + k_align_log2;
+
+constexpr size_t k_small_block_size = size_t(1) << k_fl_shift;
+
+constexpr uint32_t k_fl_count = 64 - k_fl_shift + 1;
+
+//! flags, stored in the lower bits of tlsf_block_t::size
+constexpr size_t k_block_free = 1, k_prev_free = 2, k_flags = k_block_free | k_prev_free;
+
+/**
+ * @brief   tlsf_block_t is the header of a block, followed by its payload.
+ *          Physically adjacent blocks are linked by their sizes (forward) and prev_physical (backward),
+ *          the latter only valid if the previous block is free.
+ */
+struct tlsf_block_t
+{
+    //! previous physical block, only valid if it is free (k_prev_free)
+    tlsf_block_t *prev_physical;
+
+    //! size of the block in bytes including its header, flags in the lower bits
+    size_t size;
+
+    //! links within a free-list, only valid while the block is free (overlapping the payload otherwise)
+    tlsf_block_t *next_free, *prev_free;
+};
+
+//! used blocks only occupy prev_physical and size
+constexpr size_t k_block_header_size = offsetof(tlsf_block_t, next_free);
+static_assert(k_block_header_size == k_block_alignment);
+
+//! a free block must hold a complete header
+constexpr size_t k_min_block_size = sizeof(tlsf_block_t);
+
+/**
+ * @brief   tlsf_control_t groups the segregated free-lists and their bitmaps.
+ */
+struct tlsf_control_t
+{
+    //! bit fl is set, if any second-level list of first-level fl is non-empty
+    uint64_t fl_bitmap = 0;
+
+    //! per first-level, bit sl is set if free_lists[fl][sl] is non-empty
+    uint32_t sl_bitmaps[k_fl_count] = {};
+
+    tlsf_block_t *free_lists[k_fl_count][k_sl_count] = {};
+
+    //! total number of bytes in free blocks
+    size_t num_free_bytes = 0;
+};
+
+inline size_t block_size(const tlsf_block_t *b){ return b->size & ~k_flags; }
+
+inline bool block_is_free(const tlsf_block_t *b){ return b->size & k_block_free; }
+
+inline bool block_prev_free(const tlsf_block_t *b){ return b->size & k_prev_free; }
+
+inline void block_set_size(tlsf_block_t *b, size_t size){ b->size = size | (b->size & k_flags); }
+
+inline tlsf_block_t *block_next(const tlsf_block_t *b)
+{
+    return reinterpret_cast<tlsf_block_t *>(reinterpret_cast<uintptr_t>(b) + block_size(b));
+}
+
+inline void *block_payload(tlsf_block_t *b){ return reinterpret_cast<uint8_t *>(b) + k_block_header_size; }
+
+inline tlsf_block_t *payload_block(void *ptr)
+{
+    return reinterpret_cast<tlsf_block_t *>(static_cast<uint8_t *>(ptr) - k_block_header_size);
+}
+
+//! returns the block-size (including header) required for an allocation
+inline size_t block_size_for(size_t num_bytes)
+{
+    return std::max(align_up(num_bytes + k_block_header_size, k_block_alignment), k_min_block_size);
+}
+
+//! map a block-size to its first- and second-level index
+inline void mapping_insert(size_t size, uint32_t &fl, uint32_t &sl)
+{
+    if(size < k_small_block_size)
+    {
+        fl = 0;
+        sl = static_cast<uint32_t>(size >> k_align_log2);
+    }
+    else
+    {
+        auto f = static_cast<uint32_t>(std::bit_width(size) - 1);
+        sl = static_cast<uint32_t>(size >> (f - k_sl_log2)) ^ k_sl_count;
+        fl = f - k_fl_shift + 1;
+    }
+}
+
+//! round a size up to the next list-boundary, so that all blocks in the resulting list are large enough
+inline size_t mapping_round(size_t size)
+{
+    if(size < k_small_block_size){ return size; }
+    return size + (size_t(1) << (std::bit_width(size) - 1 - k_sl_log2)) - 1;
+}
+
+//! round a size down to the lower bound of its list
+inline size_t mapping_floor(size_t size)
+{
+    if(size < k_small_block_size){ return size & ~(k_block_alignment - 1); }
+    return size & ~((size_t(1) << (std::bit_width(size) - 1 - k_sl_log2)) - 1);
+}
+
+//! find a non-empty list, holding blocks of at least the size mapped to (fl, sl), using two bit-scans.
+inline tlsf_block_t *find_suitable(const tlsf_control_t &c, uint32_t fl, uint32_t sl)
+{
+    uint32_t sl_map = c.sl_bitmaps[fl] & (~0U << sl);
+
+    if(!sl_map)
+    {
+        // next larger first-level
+        uint64_t fl_map = fl + 1 < 64 ? c.fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+        if(!fl_map){ return nullptr; }
+
+        fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+        sl_map = c.sl_bitmaps[fl];
+    }
+    return c.free_lists[fl][std::countr_zero(sl_map)];
+}
+
+inline void insert_free(tlsf_control_t &c, tlsf_block_t *b)
+{
+    uint32_t fl, sl;
+    mapping_insert(block_size(b), fl, sl);
+
+    auto &head = c.free_lists[fl][sl];
+    b->prev_free = nullptr;
+    b->next_free = head;
+    if(head){ head->prev_free = b; }
+    head = b;
+
+    c.fl_bitmap |= uint64_t(1) << fl;
+    c.sl_bitmaps[fl] |= 1U << sl;
+    c.num_free_bytes += block_size(b);
+}
+
+inline void remove_free(tlsf_control_t &c, tlsf_block_t *b)
+{
+    uint32_t fl, sl;
+    mapping_insert(block_size(b), fl, sl);
+
+    auto &head = c.free_lists[fl][sl];
+    if(b->prev_free){ b->prev_free->next_free = b->next_free; }
+    else{ head = b->next_free; }
+    if(b->next_free){ b->next_free->prev_free = b->prev_free; }
+
+    if(!head)
+    {
+        c.sl_bitmaps[fl] &= ~(1U << sl);
+        if(!c.sl_bitmaps[fl]){ c.fl_bitmap &= ~(uint64_t(1) << fl); }
+    }
+    c.num_free_bytes -= block_size(b);
+}
+
+//! mark a block as free and link it to its physical successor
+inline void mark_free(tlsf_block_t *b)
+{
+    b->size |= k_block_free;
+    auto *next = block_next(b);
+    next->prev_physical = b;
+    next->size |= k_prev_free;
+}
+
+//! mark a block as used
+inline void mark_used(tlsf_block_t *b)
+{
+    b->size &= ~k_block_free;
+    block_next(b)->size &= ~k_prev_free;
+}
+
+/**
+ * @brief   Shrink a used block to size bytes, the remainder becomes a free block, merged with a free successor.
+ *          Nothing happens, if the remainder is too small to form a block.
+ */
+inline void trim_used(tlsf_control_t &c, tlsf_block_t *b, size_t size)
+{
+    size_t remainder = block_size(b) - size;
+    auto *next = block_next(b);
+
+    if(block_is_free(next))
+    {
+        remove_free(c, next);
+        remainder += block_size(next);
+    }
+    else if(remainder < k_min_block_size){ return; }
+
+    block_set_size(b, size);
+    auto *rest = block_next(b);
+    rest->size = remainder;
+    mark_free(rest);
+    insert_free(c, rest);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+TLSFPoolUPtr TLSFPool::create(create_info_t create_info)
+{
+    return TLSFPoolUPtr(new TLSFPool(std::move(create_info)));
+}
+
+TLSFPool::TLSFPool(create_info_t create_info) :
+        m_format(std::move(create_info)),
+        m_control(std::make_unique<tlsf_control_t>())
+{
+    // a pool holds at least one minimal block and a sentinel-header
+    m_format.pool_size = std::max(align_up(m_format.pool_size, k_block_alignment),
+                                  k_min_block_size + k_block_header_size);
+
+    std::unique_lock lock(m_mutex);
+    for(size_t i = 0; i < m_format.min_num_pools; ++i){ add_pool(); }
+}
+
+TLSFPool::~TLSFPool()
+{
+    if(m_format.dealloc_fn)
+    {
+        for(auto *pool: m_pools){ m_format.dealloc_fn(pool); }
+    }
+}
+
+size_t TLSFPool::max_allocation_size() const
+{
+    // largest block, guaranteed to be found in a pool's list, excluding its header
+    return mapping_floor(m_format.pool_size - k_block_header_size) - k_block_header_size;
+}
+
+void *TLSFPool::allocate(size_t num_bytes)
+{
+    if(!num_bytes || num_bytes > max_allocation_size()){ return nullptr; }
+
+    tlsf_block_t *b;
+    {
+        std::unique_lock lock(m_mutex);
+        b = allocate_block(block_size_for(num_bytes));
+    }
+    if(!b){ return nullptr; }
+
+    m_counters.add_used(block_size(b) - k_block_header_size);
+    return block_payload(b);
+}
+
+void *TLSFPool::allocate(size_t num_bytes, size_t alignment)
+{
+    if(!num_bytes || !alignment || !is_pow_2(alignment)){ return nullptr; }
+    if(alignment <= k_block_alignment){ return allocate(num_bytes); }
+
+    // reject early, the padded size below could overflow otherwise
+    if(num_bytes > max_allocation_size() || alignment > max_allocation_size()){ return nullptr; }
+
+    // over-allocate, so a leading gap can always form a free block
+    size_t size = block_size_for(num_bytes);
+    size_t padded_size = size + alignment + k_min_block_size;
+    if(padded_size - k_block_header_size > max_allocation_size()){ return nullptr; }
+
+    std::unique_lock lock(m_mutex);
+
+    auto *b = allocate_block(padded_size);
+    if(!b){ return nullptr; }
+
+    auto payload = reinterpret_cast<uintptr_t>(block_payload(b));
+    size_t gap = align_up(payload, alignment) - payload;
+    if(gap && gap < k_min_block_size){ gap = align_up(payload + k_min_block_size, alignment) - payload; }
+
+    // split off the leading gap as a free block
+    if(gap)
+    {
+        auto *aligned_block = reinterpret_cast<tlsf_block_t *>(reinterpret_cast<uint8_t *>(b) + gap);
+        aligned_block->size = block_size(b) - gap;
+        block_set_size(b, gap);
+        mark_free(b);
+        insert_free(*m_control, b);
+        b = aligned_block;
+    }
+
+    // return the trailing excess
+    trim_used(*m_control, b, size);
+    lock.unlock();
+
+    m_counters.add_used(block_size(b) - k_block_header_size);
+    return block_payload(b);
+}
+
+void *TLSFPool::reallocate(void *ptr, size_t num_bytes)
+{
+    if(!ptr){ return allocate(num_bytes); }
+
+    if(!num_bytes)
+    {
+        free(ptr);
+        return nullptr;
+    }
+    if(num_bytes > max_allocation_size()){ return nullptr; }
+
+    size_t size = block_size_for(num_bytes);
+
+    std::unique_lock lock(m_mutex);
+    auto *b = payload_block(ptr);
+    assert(!block_is_free(b));
+    size_t current_size = block_size(b);
+
+    // shrink in place
+    if(size <= current_size)
+    {
+        trim_used(*m_control, b, size);
+        m_counters.resize_used(current_size - k_block_header_size, block_size(b) - k_block_header_size);
+        return ptr;
+    }
+
+    // grow in place, merging with a free successor
+    auto *next = block_next(b);
+
+    if(block_is_free(next) && current_size + block_size(next) >= size)
+    {
+        remove_free(*m_control, next);
+        block_set_size(b, current_size + block_size(next));
+        mark_used(b);
+        trim_used(*m_control, b, size);
+        m_counters.resize_used(current_size - k_block_header_size, block_size(b) - k_block_header_size);
+        return ptr;
+    }
+
+    // move to a new location
+    auto *new_block = allocate_block(size);
+    if(!new_block){ return nullptr; }
+
+    memcpy(block_payload(new_block), ptr, current_size - k_block_header_size);
+    free_block(b);
+    m_counters.resize_used(current_size - k_block_header_size, block_size(new_block) - k_block_header_size);
+    return block_payload(new_block);
+}
+
+void TLSFPool::free(void *ptr)
+{
+    if(!ptr){ return; }
+
+    // the size-word is shared with a neighbour's flags, only read it under the lock
+    std::unique_lock lock(m_mutex);
+    auto *b = payload_block(ptr);
+    assert(!block_is_free(b));
+    m_counters.remove_used(block_size(b) - k_block_header_size);
+    free_block(b);
+}
+
+void TLSFPool::free_block(tlsf_block_t *b)
+{
+    // merge with free predecessor
+    if(block_prev_free(b))
+    {
+        auto *prev = b->prev_physical;
+        remove_free(*m_control, prev);
+        block_set_size(prev, block_size(prev) + block_size(b));
+        b = prev;
+    }
+
+    // merge with free successor
+    auto *next = block_next(b);
+
+    if(block_is_free(next))
+    {
+        remove_free(*m_control, next);
+        block_set_size(b, block_size(b) + block_size(next));
+    }
+    mark_free(b);
+
+    // block spans an entire pool
+    if(m_format.dealloc_unused_pools && block_size(b) == m_format.pool_size - k_block_header_size &&
+       m_pools.size() > m_format.min_num_pools)
+    {
+        remove_pool(b);
+        return;
+    }
+    insert_free(*m_control, b);
+}
+
+tlsf_block_t *TLSFPool::allocate_block(size_t size)
+{
+    uint32_t fl, sl;
+    mapping_insert(mapping_round(size), fl, sl);
+
+    auto *b = find_suitable(*m_control, fl, sl);
+
+    // add a new pool, if permitted
+    if(!b && add_pool()){ b = find_suitable(*m_control, fl, sl); }
+    if(!b){ return nullptr; }
+
+    remove_free(*m_control, b);
+
+    // split off the remainder
+    size_t remainder = block_size(b) - size;
+
+    if(remainder >= k_min_block_size)
+    {
+        block_set_size(b, size);
+        auto *rest = block_next(b);
+        rest->size = remainder;
+        mark_free(rest);
+        insert_free(*m_control, rest);
+    }
+    mark_used(b);
+    return b;
+}
+
+bool TLSFPool::add_pool()
+{
+    if(!m_format.alloc_fn || !m_format.dealloc_fn){ return false; }
+    if(m_format.max_num_pools && m_pools.size() >= m_format.max_num_pools){ return false; }
+
+    auto *base = static_cast<uint8_t *>(m_format.alloc_fn(m_format.pool_size));
+    if(!base){ return false; }
+    assert(!(reinterpret_cast<uintptr_t>(base) & (k_block_alignment - 1)));
+
+    // one free block, followed by a used sentinel-header of size 0
+    size_t size = m_format.pool_size - k_block_header_size;
+    auto *b = reinterpret_cast<tlsf_block_t *>(base);
+    b->prev_physical = nullptr;
+    b->size = size;
+
+    auto *sentinel = reinterpret_cast<tlsf_block_t *>(base + size);
+    sentinel->size = 0;
+    mark_free(b);
+    insert_free(*m_control, b);
+
+    m_pools.push_back(base);
+    m_counters.add_internal(m_format.pool_size);
+    return true;
+}
+
+void TLSFPool::remove_pool(tlsf_block_t *b)
+{
+    auto it = std::find(m_pools.begin(), m_pools.end(), reinterpret_cast<uint8_t *>(b));
+    assert(it != m_pools.end());
+
+    m_pools.erase(it);
+    m_counters.remove_internal(m_format.pool_size);
+    m_format.dealloc_fn(b);
+}
+
+void TLSFPool::shrink()
+{
+    std::unique_lock lock(m_mutex);
+
+    for(size_t i = m_pools.size(); i-- > 0 && m_pools.size() > m_format.min_num_pools;)
+    {
+        auto *b = reinterpret_cast<tlsf_block_t *>(m_pools[i]);
+
+        if(block_is_free(b) && block_size(b) == m_format.pool_size - k_block_header_size)
+        {
+            remove_free(*m_control, b);
+            remove_pool(b);
+        }
+    }
+}
+
+Allocator::state_t TLSFPool::state() const
+{
+    std::unique_lock lock(m_mutex);
+    Allocator::state_t ret = m_counters.state();
+
+    // largest free block, found in the highest non-empty list
+    size_t max_free_bytes = 0;
+
+    if(m_control->fl_bitmap)
+    {
+        auto fl = static_cast<uint32_t>(std::bit_width(m_control->fl_bitmap) - 1);
+        auto sl = static_cast<uint32_t>(std::bit_width(m_control->sl_bitmaps[fl]) - 1);
+
+        for(auto *b = m_control->free_lists[fl][sl]; b; b = b->next_free)
+        {
+            max_free_bytes = std::max(max_free_bytes, block_size(b));
+        }
+    }
+    ret.fragmentation = fragmentation(m_control->num_free_bytes, max_free_bytes);
+    return ret;
+}
+
+}// namespace crocore
@@ -0,0 +1,198 @@
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "crocore/utils.hpp"
+#include "crocore/virtual_memory.hpp"
+
+namespace crocore::virtual_memory
+{
+
+/////////// implementation internal /////////////
+
+//! sizes of all active mappings, required for unmapping
+struct mapping_registry_t
+{
+    std::mutex mutex;
+    std::unordered_map<void *, size_t> mappings;
+};
+
+static mapping_registry_t &registry()
+{
+    static mapping_registry_t s_registry;
+    return s_registry;
+}
+
+#if !defined(_WIN32)
+
+//! map anonymous memory, aligned to a power of two
+static void *map_aligned(size_t num_bytes, size_t alignment)
+{
+    // over-allocate, trim head and tail afterwards
+    size_t num_padded_bytes = num_bytes + alignment - page_size();
+    void *base = mmap(nullptr, num_padded_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){ return nullptr; }
+
+    auto address = reinterpret_cast<uintptr_t>(base);
+    auto aligned = align_up(address, alignment);
+    size_t num_tail_bytes = address + num_padded_bytes - (aligned + num_bytes);
+
+    if(aligned > address){ munmap(base, aligned - address); }
+    if(num_tail_bytes){ munmap(reinterpret_cast<void *>(aligned + num_bytes), num_tail_bytes); }
+    return reinterpret_cast<void *>(aligned);
+}
+
+#endif
+
+/////////////////////////////////////////////////
+
+size_t page_size()
+{
+#if defined(_WIN32)
+    static size_t s_page_size = [] {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<size_t>(info.dwPageSize);
+    }();
+#else
+    static size_t s_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return s_page_size;
+}
+
+size_t huge_page_size()
+{
+    static size_t s_huge_page_size = [] {
+        size_t ret = 2U << 20U;
+#if defined(_WIN32)
+        if(size_t large_page_size = GetLargePageMinimum()){ ret = large_page_size; }
+#else
+        // e.g. "Hugepagesize:       2048 kB"
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        size_t value;
+
+        while(meminfo >> key)
+        {
+            if(key == "Hugepagesize:" && meminfo >> value){ ret = value << 10U; break; }
+            meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+#endif
+        return ret;
+    }();
+    return s_huge_page_size;
+}
+
+void *map(size_t num_bytes, PageMode mode)
+{
+    if(!num_bytes){ return nullptr; }
+
+    num_bytes = align_up(num_bytes, page_size());
+    void *ptr = nullptr;
+
+#if defined(_WIN32)
+    // large pages require special privileges, use regular pages
+    (void)mode;
+    ptr = VirtualAlloc(nullptr, num_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+    if(mode == PageMode::HUGE_EXPLICIT)
+    {
+        size_t num_huge_bytes = align_up(num_bytes, huge_page_size());
+        ptr = mmap(nullptr, num_huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if(ptr != MAP_FAILED){ num_bytes = num_huge_bytes; }
+        else{ ptr = nullptr; }
+    }
+#endif
+    // no (explicit) huge pages available
+    if(!ptr)
+    {
+        bool huge = mode != PageMode::DEFAULT;
+        ptr = map_aligned(num_bytes, huge ? huge_page_size() : page_size());
+
+#if defined(MADV_HUGEPAGE)
+        if(ptr && huge){ madvise(ptr, num_bytes, MADV_HUGEPAGE); }
+#endif
+    }
+#endif
+
+    if(ptr)
+    {
+        auto &r = registry();
+        std::unique_lock lock(r.mutex);
+        r.mappings[ptr] = num_bytes;
+    }
+    return ptr;
+}
+
+void unmap(void *ptr)
+{
+    if(!ptr){ return; }
+
+    size_t num_bytes = 0;
+    {
+        auto &r = registry();
+        std::unique_lock lock(r.mutex);
+        auto it = r.mappings.find(ptr);
+        if(it == r.mappings.end()){ return; }
+        num_bytes = it->second;
+        r.mappings.erase(it);
+    }
+
+#if defined(_WIN32)
+    (void)num_bytes;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, num_bytes);
+#endif
+}
+
+bool is_mapped(const void *ptr)
+{
+    auto &r = registry();
+    std::unique_lock lock(r.mutex);
+    return r.mappings.count(const_cast<void *>(ptr));
+}
+
+size_t release(void *ptr, size_t num_bytes, bool lazy)
+{
+    // only release pages entirely contained in the range
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    auto first = align_up(address, page_size());
+    auto last = (address + num_bytes) & ~(page_size() - 1);
+    if(!ptr || last <= first){ return 0; }
+
+    auto *range = reinterpret_cast<void *>(first);
+    size_t range_size = last - first;
+
+#if defined(_WIN32)
+    if(lazy){ VirtualAlloc(range, range_size, MEM_RESET, PAGE_READWRITE); }
+    else
+    {
+        VirtualFree(range, range_size, MEM_DECOMMIT);
+        VirtualAlloc(range, range_size, MEM_COMMIT, PAGE_READWRITE);
+    }
+#else
+    int advice = MADV_DONTNEED;
+#if defined(MADV_FREE)
+    if(lazy){ advice = MADV_FREE; }
+#else
+    (void)lazy;
+#endif
+    if(madvise(range, range_size, advice)){ return 0; }
+#endif
+    return range_size;
+}
+
+}// namespace crocore::virtual_memory
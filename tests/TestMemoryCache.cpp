@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <crocore/MemoryCache.hpp>
+#include <cstring>
+#include <thread>
 #include <unordered_map>
 
 TEST(MemoryCache, Constructors)
@@ -118,3 +120,298 @@ TEST(MemoryCache, BaseClassPointer)
     // flag should have been set -> virtual destruction worked + no leak
     ASSERT_TRUE(flag);
 }
+
+TEST(MemoryCache, AlignedAllocations)
+{
+    crocore::MemoryCache::create_info_t create_info;
+    create_info.min_size = 1U << 12U;
+    create_info.size_tolerance = 2.f;
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    for(size_t alignment = 1; alignment <= (1U << 16U); alignment <<= 1)
+    {
+        void *ptr = cache->allocate(1000, alignment);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+
+        // aligned pointers are accepted by free
+        cache->free(ptr);
+    }
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+
+    // alignment must be a power of two
+    ASSERT_EQ(cache->allocate(100, 0), nullptr);
+    ASSERT_EQ(cache->allocate(100, 48), nullptr);
+
+    // previously padded chunks are re-used for smaller alignments
+    cache->shrink();
+    void *ptr1 = cache->allocate(1U << 12U, 1U << 12U);
+    cache->free(ptr1);
+    void *ptr2 = cache->allocate(1U << 12U, 64);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr2) % 64, 0);
+    ASSERT_EQ(cache->state().num_allocations, 1);
+    cache->free(ptr2);
+}
+
+TEST(MemoryCache, Reallocate)
+{
+    crocore::MemoryCache::create_info_t create_info;
+    create_info.min_size = 1U << 12U;
+    create_info.size_tolerance = 2.f;
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    constexpr size_t num_bytes_1Mb = 1U << 20U;
+
+    auto ptr = static_cast<uint8_t *>(cache->reallocate(nullptr, num_bytes_1Mb));
+    ASSERT_NE(ptr, nullptr);
+    memset(ptr, 0x2A, num_bytes_1Mb);
+
+    // chunk is re-used within size_tolerance
+    ASSERT_EQ(cache->reallocate(ptr, num_bytes_1Mb / 2), ptr);
+    ASSERT_EQ(cache->state().num_allocations, 1);
+
+    // chunk is too large, move to a smaller one
+    auto smaller = static_cast<uint8_t *>(cache->reallocate(ptr, num_bytes_1Mb / 4));
+    ASSERT_NE(smaller, ptr);
+    ASSERT_EQ(smaller[num_bytes_1Mb / 4 - 1], 0x2A);
+
+    // chunk is too small, the previous one fits again
+    ASSERT_EQ(cache->reallocate(smaller, num_bytes_1Mb), ptr);
+    ASSERT_EQ(ptr[0], 0x2A);
+    ASSERT_EQ(cache->state().num_allocations, 2);
+    ASSERT_EQ(cache->state().num_bytes_used, num_bytes_1Mb);
+
+    // alignment is preserved
+    auto aligned = cache->allocate(100, 1U << 12U);
+    aligned = cache->reallocate(aligned, num_bytes_1Mb * 4);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned) % (1U << 12U), 0);
+
+    // size zero frees
+    ASSERT_EQ(cache->reallocate(aligned, 0), nullptr);
+    ASSERT_EQ(cache->reallocate(ptr, 0), nullptr);
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+}
+
+TEST(MemoryCache, SizeClasses)
+{
+    crocore::MemoryCache::create_info_t create_info;
+    create_info.min_size = 1U << 12U;
+    create_info.size_tolerance = 2.f;
+    create_info.size_classes = true;
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    constexpr size_t num_bytes_1Mb = 1U << 20U;
+
+    auto ptr1 = static_cast<uint8_t *>(cache->allocate(num_bytes_1Mb));
+    ASSERT_NE(ptr1, nullptr);
+    memset(ptr1, 0xFF, num_bytes_1Mb);
+
+    // chunk-sizes are rounded to size-classes (1.25MB), including a header
+    auto state = cache->state();
+    ASSERT_EQ(state.num_allocations, 1);
+    ASSERT_GE(state.num_bytes_used, num_bytes_1Mb);
+    ASSERT_LE(state.num_bytes_used, num_bytes_1Mb + num_bytes_1Mb / 4);
+    cache->free(ptr1);
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+
+    // too small to re-use the chunk within size_tolerance
+    auto ptr2 = cache->allocate(num_bytes_1Mb / 4);
+    ASSERT_NE(ptr2, ptr1);
+
+    // re-used within size_tolerance
+    auto ptr3 = cache->allocate(num_bytes_1Mb * 3 / 4);
+    ASSERT_EQ(ptr3, ptr1);
+    ASSERT_EQ(cache->state().num_allocations, 2);
+
+    // alignment
+    for(size_t alignment = 1; alignment <= (1U << 16U); alignment <<= 1)
+    {
+        void *ptr = cache->allocate(1000, alignment);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+        cache->free(ptr);
+    }
+
+    // reallocate
+    ASSERT_EQ(cache->reallocate(ptr3, num_bytes_1Mb), ptr3);
+    auto ptr4 = static_cast<uint8_t *>(cache->reallocate(ptr3, 4 * num_bytes_1Mb));
+    ASSERT_NE(ptr4, ptr3);
+    ASSERT_EQ(ptr4[num_bytes_1Mb - 1], 0xFF);
+
+    cache->free(ptr2);
+    cache->free(ptr4);
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+
+    // double frees and foreign pointers are ignored
+    state = cache->state();
+    cache->free(ptr4);
+    alignas(std::max_align_t) uint8_t foreign[256] = {};
+    cache->free(foreign + 64);
+    ASSERT_EQ(cache->reallocate(foreign + 64, 128), nullptr);
+    ASSERT_EQ(cache->state().num_allocations, state.num_allocations);
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+
+    // frees unused chunks
+    cache->shrink();
+    ASSERT_EQ(cache->state().num_allocations, 0);
+    ASSERT_EQ(cache->state().num_bytes_allocated, 0);
+
+    // outstanding allocations are released by the destructor
+    ASSERT_NE(cache->allocate(42), nullptr);
+}
+
+TEST(MemoryCache, SizeClassesConcurrent)
+{
+    crocore::MemoryCache::create_info_t create_info;
+    create_info.min_size = 64;
+    create_info.size_classes = true;
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    constexpr uint32_t num_threads = 4;
+    constexpr uint32_t num_iterations = 10000;
+    std::vector<std::thread> threads;
+
+    for(uint32_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&cache, t] {
+            std::vector<std::pair<uint8_t *, size_t>> allocations;
+
+            for(uint32_t i = 0; i < num_iterations; ++i)
+            {
+                if(allocations.empty() || (i * 7 + t) % 3)
+                {
+                    size_t num_bytes = 1 + (i * 31 + t * 17) % 1024;
+                    auto ptr = static_cast<uint8_t *>(cache->allocate(num_bytes));
+                    ASSERT_NE(ptr, nullptr);
+                    memset(ptr, static_cast<uint8_t>(t), num_bytes);
+                    allocations.emplace_back(ptr, num_bytes);
+                }
+                else
+                {
+                    auto [ptr, num_bytes] = allocations.back();
+                    allocations.pop_back();
+                    for(size_t k = 0; k < num_bytes; ++k){ ASSERT_EQ(ptr[k], static_cast<uint8_t>(t)); }
+                    cache->free(ptr);
+                }
+            }
+            for(auto [ptr, num_bytes]: allocations){ cache->free(ptr); }
+        });
+    }
+    for(auto &t: threads){ t.join(); }
+    ASSERT_EQ(cache->state().num_bytes_used, 0);
+}
+
+TEST(MemoryCache, IdleLimits)
+{
+    constexpr size_t num_bytes_1Mb = 1U << 20U;
+
+    for(bool size_classes: {false, true})
+    {
+        crocore::MemoryCache::create_info_t create_info;
+        create_info.size_classes = size_classes;
+        create_info.size_tolerance = 1.f;
+        create_info.max_idle_bytes = 13 * num_bytes_1Mb / 2;
+        create_info.max_idle_duration = std::chrono::milliseconds(50);
+        auto cache = crocore::MemoryCache::create(create_info);
+
+        // distinct sizes, freed in order
+        std::vector<void *> pointers;
+        for(size_t i = 1; i <= 4; ++i){ pointers.push_back(cache->allocate(i * num_bytes_1Mb)); }
+        for(void *ptr: pointers){ cache->free(ptr); }
+
+        // least recently freed chunks were evicted to stay below 6.5MB
+        auto state = cache->state();
+        ASSERT_EQ(state.num_allocations, 1);
+        ASSERT_LE(state.num_bytes_allocated, create_info.max_idle_bytes);
+        ASSERT_EQ(cache->allocate(4 * num_bytes_1Mb), pointers[3]);
+        ASSERT_EQ(cache->trim(), 0);
+
+        // chunks still warm
+        cache->free(pointers[3]);
+        ASSERT_EQ(cache->trim(), 0);
+        ASSERT_EQ(cache->state().num_allocations, 1);
+
+        // aged chunks are evicted by trim()
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        void *ptr = cache->allocate(num_bytes_1Mb);
+        cache->free(ptr);
+        ASSERT_EQ(cache->trim(), 1);
+
+        // recently freed chunk was kept
+        ASSERT_EQ(cache->state().num_allocations, 1);
+        ASSERT_EQ(cache->allocate(num_bytes_1Mb), ptr);
+        cache->free(ptr);
+
+        // least recently freed chunk is evicted, also if it was freed by a different thread (shard)
+        void *old = cache->allocate(4 * num_bytes_1Mb);
+        void *recent = cache->allocate(4 * num_bytes_1Mb);
+        std::thread([&cache, old] { cache->free(old); }).join();
+        cache->free(recent);
+        ASSERT_EQ(cache->state().num_allocations, 1);
+        ASSERT_EQ(cache->allocate(4 * num_bytes_1Mb), recent);
+        cache->free(recent);
+    }
+}
+
+TEST(MemoryCache, IncrementalTrim)
+{
+    crocore::MemoryCache::create_info_t create_info;
+    create_info.min_size = 64;
+    create_info.max_idle_duration = std::chrono::milliseconds(1);
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    std::vector<void *> pointers;
+    for(size_t i = 0; i < 10; ++i){ pointers.push_back(cache->allocate(64 << i)); }
+    for(void *ptr: pointers){ cache->free(ptr); }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // bounded amount of work per call
+    ASSERT_EQ(cache->trim(4), 4);
+    ASSERT_EQ(cache->trim(4), 4);
+    ASSERT_EQ(cache->trim(4), 2);
+    ASSERT_EQ(cache->state().num_allocations, 0);
+}
+
+TEST(MemoryCache, RunningCounters)
+{
+    for(bool size_classes: {false, true})
+    {
+        crocore::MemoryCache::create_info_t create_info = {};
+        create_info.min_size = 64;
+        create_info.size_classes = size_classes;
+        auto cache = crocore::MemoryCache::create(create_info);
+
+        std::vector<void *> ptrs;
+        for(size_t i = 0; i < 100; ++i){ ptrs.push_back(cache->allocate(1024 + 100 * i)); }
+
+        auto state = cache->state();
+        ASSERT_EQ(state.num_live_allocations, 100);
+        ASSERT_EQ(state.num_allocations, 100);
+        ASSERT_EQ(state.num_bytes_used, state.num_bytes_allocated);
+        ASSERT_EQ(state.max_bytes_used, state.num_bytes_used);
+        ASSERT_EQ(state.max_bytes_allocated, state.num_bytes_allocated);
+        ASSERT_EQ(state.fragmentation, 0.f);
+        size_t max_bytes = state.num_bytes_used;
+
+        // free all but one chunk, chunks are kept
+        for(size_t i = 0; i < 99; ++i){ cache->free(ptrs[i]); }
+
+        state = cache->state();
+        ASSERT_EQ(state.num_live_allocations, 1);
+        ASSERT_EQ(state.num_allocations, 100);
+        ASSERT_LT(state.num_bytes_used, state.num_bytes_allocated);
+        ASSERT_EQ(state.max_bytes_used, max_bytes);
+        ASSERT_GT(state.fragmentation, 0.9f);
+
+        cache->shrink();
+        state = cache->state();
+        ASSERT_EQ(state.num_allocations, 1);
+        ASSERT_EQ(state.num_bytes_allocated, state.num_bytes_used);
+        ASSERT_EQ(state.max_bytes_allocated, max_bytes);
+        ASSERT_EQ(state.fragmentation, 0.f);
+
+        cache->free(ptrs.back());
+        ASSERT_EQ(cache->state().num_bytes_used, 0);
+        ASSERT_EQ(cache->state().num_live_allocations, 0);
+    }
+}
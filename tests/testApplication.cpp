@@ -20,15 +20,27 @@ public:
 
     uint32_t num_poll_events = 0;
 
+    bool frame_arena_valid = true;
+
 private:
 
     void setup() override { setup_complete = true; }
 
     void update(double time_delta) override
     {
+        // allocations from previous frame remain valid
+        if(m_last_frame_data && *m_last_frame_data != num_updates){ frame_arena_valid = false; }
+
+        // arena was reset, one frame ago
+        if(frame_arena()->state().num_bytes_used){ frame_arena_valid = false; }
+
+        m_last_frame_data = new(frame_arena()) uint32_t(num_updates + 1);
+
         if(++num_updates >= num_runs){ running = false; }
     }
 
+    uint32_t *m_last_frame_data = nullptr;
+
     void teardown() override
     {
         teardown_complete = true;
@@ -50,4 +62,5 @@ TEST(testApplication, basic)
     ASSERT_TRUE(app->background_task_complete);
     ASSERT_EQ(app->num_poll_events, app->num_updates);
     ASSERT_EQ(num_runs, app->num_updates);
+    ASSERT_TRUE(app->frame_arena_valid);
 }
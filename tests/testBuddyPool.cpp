@@ -1,7 +1,13 @@
 #include <gtest/gtest.h>
 
 #include "crocore/BuddyPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 static inline bool is_pow_2(size_t v)
 {
@@ -230,4 +236,871 @@ TEST(BuddyPool, BaseclassInterface)
     auto* dackel = new (allocator) poo_dackel_t();
     dackel->~poo_dackel_t();
     allocator->free(dackel);
-}
\ No newline at end of file
+}
+
+TEST(BuddyPool, Magazines)
+{
+    constexpr size_t numBytes_16Mb = 1U << 24U;
+    constexpr size_t num_threads = 4;
+    constexpr size_t num_allocations = 1000;
+
+    crocore::BuddyPool::create_info_t fmt;
+    fmt.block_size = numBytes_16Mb;
+    fmt.min_block_size = 64;
+    fmt.magazine_size = 32;
+
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    // freed blocks are cached and handed out again
+    void *ptr1 = pool->allocate(100);
+    ASSERT_NE(ptr1, nullptr);
+    pool->free(ptr1);
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+    void *ptr2 = pool->allocate(128);
+    ASSERT_EQ(ptr1, ptr2);
+    ASSERT_EQ(pool->state().num_bytes_used, 128);
+    pool->free(ptr2);
+
+    // double free is ignored, the block is cached only once
+    pool->free(ptr2);
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+    ptr1 = pool->allocate(128);
+    ptr2 = pool->allocate(128);
+    ASSERT_NE(ptr1, ptr2);
+    pool->free(ptr1);
+    pool->free(ptr2);
+
+    auto worker_fn = [&pool](uint32_t seed) {
+        std::vector<std::pair<uint8_t *, size_t>> allocations;
+
+        for(uint32_t i = 0; i < num_allocations; ++i)
+        {
+            size_t num_bytes = 1 + (seed * 7919 + i * 104729) % 8192;
+            auto ptr = static_cast<uint8_t *>(pool->allocate(num_bytes));
+            ASSERT_NE(ptr, nullptr);
+            memset(ptr, static_cast<int>(seed), num_bytes);
+            allocations.emplace_back(ptr, num_bytes);
+
+            // free every other allocation right away
+            if(i % 2)
+            {
+                auto [p, n] = allocations.back();
+                for(size_t k = 0; k < n; ++k){ ASSERT_EQ(p[k], static_cast<uint8_t>(seed)); }
+                pool->free(p);
+                allocations.pop_back();
+            }
+        }
+        for(auto [p, n]: allocations)
+        {
+            for(size_t k = 0; k < n; ++k){ ASSERT_EQ(p[k], static_cast<uint8_t>(seed)); }
+            pool->free(p);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < num_threads; ++i){ threads.emplace_back(worker_fn, i + 1); }
+    for(auto &t: threads){ t.join(); }
+
+    // cached blocks do not count as used
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+
+    // flush magazines and release all toplevel blocks
+    pool->shrink();
+    auto pool_state = pool->pool_state();
+    ASSERT_EQ(pool_state.allocations.size(), 0);
+    ASSERT_EQ(pool_state.num_blocks, 0);
+}
+
+TEST(BuddyPool, FreeIndex)
+{
+    constexpr size_t block_size = 1U << 16U;
+    constexpr size_t min_block_size = 256;
+    constexpr size_t num_blocks = 64;
+
+    crocore::BuddyPool::create_info_t fmt;
+    fmt.block_size = block_size;
+    fmt.min_block_size = min_block_size;
+    fmt.dealloc_unused_blocks = false;
+
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    // completely fill a number of toplevel blocks with minimum-sized allocations
+    std::vector<void *> pointers;
+    for(size_t i = 0; i < num_blocks * block_size / min_block_size; ++i)
+    {
+        pointers.push_back(pool->allocate(min_block_size));
+        ASSERT_NE(pointers.back(), nullptr);
+    }
+    ASSERT_EQ(pool->pool_state().num_blocks, num_blocks);
+
+    // punch a hole into a full block, the freed space is found again without adding a block
+    void *ptr = pointers[pointers.size() / 2 + 3];
+    pool->free(ptr);
+    ASSERT_EQ(pool->allocate(min_block_size), ptr);
+    ASSERT_EQ(pool->pool_state().num_blocks, num_blocks);
+
+    // free two neighbours -> merged node can serve a larger allocation
+    void *ptr_left = pointers[pointers.size() / 4];
+    void *ptr_right = pointers[pointers.size() / 4 + 1];
+    pool->free(ptr_left);
+    pool->free(ptr_right);
+    ASSERT_EQ(pool->allocate(2 * min_block_size), ptr_left);
+
+    // larger allocations go to new blocks
+    void *ptr_large = pool->allocate(4 * min_block_size);
+    ASSERT_NE(ptr_large, nullptr);
+    ASSERT_EQ(pool->pool_state().num_blocks, num_blocks + 1);
+}
+
+TEST(BuddyPool, AddressLookup)
+{
+    constexpr size_t block_size = 1U << 16U;
+    constexpr size_t num_blocks = 200;
+
+    crocore::BuddyPool::create_info_t fmt;
+    fmt.block_size = block_size;
+    fmt.min_block_size = 1024;
+
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    // each allocation occupies an entire toplevel block
+    std::vector<void *> pointers;
+    for(size_t i = 0; i < num_blocks; ++i){ pointers.push_back(pool->allocate(block_size)); }
+    ASSERT_EQ(pool->pool_state().num_blocks, num_blocks);
+
+    // addresses not managed by the pool, or not aligned to min_block_size, are ignored
+    int not_managed = 0;
+    pool->free(&not_managed);
+    pool->free(static_cast<uint8_t *>(pointers.front()) + 1);
+    ASSERT_EQ(pool->pool_state().num_blocks, num_blocks);
+
+    // interior pointers and double frees are ignored, for both tree-representations
+    for(bool bitmap_tree: {false, true})
+    {
+        fmt.bitmap_tree = bitmap_tree;
+        fmt.min_num_blocks = 1;
+        auto small_pool = crocore::BuddyPool::create(fmt);
+        auto *ptr = static_cast<uint8_t *>(small_pool->allocate(4 * fmt.min_block_size));
+        void *other = small_pool->allocate(fmt.min_block_size);
+
+        small_pool->free(ptr + fmt.min_block_size);
+        ASSERT_EQ(small_pool->state().num_bytes_used, 5 * fmt.min_block_size);
+        small_pool->free(ptr);
+        small_pool->free(ptr);
+        ASSERT_EQ(small_pool->state().num_bytes_used, fmt.min_block_size);
+        ASSERT_EQ(small_pool->pool_state().allocations.size(), 1);
+        small_pool->free(other);
+    }
+
+    // free in shuffled order, unused blocks are de-allocated right away
+    std::mt19937 rng(42);
+    std::shuffle(pointers.begin(), pointers.end(), rng);
+
+    for(size_t i = 0; i < num_blocks; ++i)
+    {
+        pool->free(pointers[i]);
+        ASSERT_EQ(pool->pool_state().num_blocks, num_blocks - i - 1);
+    }
+}
+
+TEST(BuddyPool, BitmapTree)
+{
+    constexpr size_t block_size = 1U << 20U;
+    constexpr size_t num_iterations = 20000;
+
+    crocore::BuddyPool::create_info_t fmt;
+    fmt.block_size = block_size;
+    fmt.min_block_size = 16;
+    fmt.bitmap_tree = true;
+
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    fmt.bitmap_tree = false;
+    auto reference_pool = crocore::BuddyPool::create(fmt);
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<uint8_t *, size_t>> allocations;
+    std::vector<void *> reference_allocations;
+
+    for(uint32_t i = 0; i < num_iterations; ++i)
+    {
+        // allocate with higher probability than free
+        if(allocations.empty() || rng() % 5 < 3)
+        {
+            size_t num_bytes = 1 + rng() % 4096;
+            auto ptr = static_cast<uint8_t *>(pool->allocate(num_bytes));
+            ASSERT_NE(ptr, nullptr);
+            memset(ptr, static_cast<int>(num_bytes & 0xFF), num_bytes);
+            allocations.emplace_back(ptr, num_bytes);
+            reference_allocations.push_back(reference_pool->allocate(num_bytes));
+        }
+        else
+        {
+            size_t index = rng() % allocations.size();
+            auto [ptr, num_bytes] = allocations[index];
+
+            // check for overlapping allocations
+            for(size_t k = 0; k < num_bytes; ++k){ ASSERT_EQ(ptr[k], static_cast<uint8_t>(num_bytes & 0xFF)); }
+
+            pool->free(ptr);
+            reference_pool->free(reference_allocations[index]);
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+            reference_allocations[index] = reference_allocations.back();
+            reference_allocations.pop_back();
+        }
+    }
+
+    // both representations agree on the set of allocations
+    ASSERT_EQ(pool->pool_state().allocations, reference_pool->pool_state().allocations);
+    ASSERT_EQ(pool->state().num_bytes_used, reference_pool->state().num_bytes_used);
+
+    for(auto [ptr, num_bytes]: allocations){ pool->free(ptr); }
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+    ASSERT_EQ(pool->pool_state().num_blocks, 0);
+}
+
+TEST(BuddyPool, AlignedAllocations)
+{
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 16U;
+    fmt.min_block_size = 64;
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    // default alloc_fn provides toplevel blocks aligned to s_block_alignment
+    for(size_t alignment = 1; alignment <= crocore::BuddyPool::s_block_alignment; alignment <<= 1)
+    {
+        void *ptr = pool->allocate(100, alignment);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+        pool->free(ptr);
+    }
+
+    // alignment must be a power of two
+    ASSERT_EQ(pool->allocate(100, 0), nullptr);
+    ASSERT_EQ(pool->allocate(100, 48), nullptr);
+
+    // alignment beyond block_size cannot be satisfied
+    ASSERT_EQ(pool->allocate(100, fmt.block_size << 1), nullptr);
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+}
+
+TEST(BuddyPool, Reallocate)
+{
+    for(bool bitmap_tree: {false, true})
+    {
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = 1U << 16U;
+        fmt.min_block_size = 64;
+        fmt.bitmap_tree = bitmap_tree;
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        // behaves like allocate/free
+        auto ptr = static_cast<uint8_t *>(pool->reallocate(nullptr, 64));
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, 0x2A, 64);
+
+        // grow in place, buddies are free
+        ASSERT_EQ(pool->reallocate(ptr, 128), ptr);
+        ASSERT_EQ(pool->reallocate(ptr, 4096), ptr);
+        ASSERT_EQ(pool->state().num_bytes_used, 4096);
+        ASSERT_EQ(ptr[63], 0x2A);
+
+        // shrink in place, split-off halves can be used again
+        ASSERT_EQ(pool->reallocate(ptr, 100), ptr);
+        ASSERT_EQ(pool->state().num_bytes_used, 128);
+        auto blocker = static_cast<uint8_t *>(pool->allocate(128));
+        ASSERT_EQ(blocker, ptr + 128);
+        ASSERT_EQ(pool->pool_state().num_blocks, 1);
+
+        // buddy is in use -> move
+        auto moved = static_cast<uint8_t *>(pool->reallocate(ptr, 256));
+        ASSERT_NE(moved, nullptr);
+        ASSERT_NE(moved, ptr);
+        ASSERT_EQ(moved[0], 0x2A);
+        ASSERT_EQ(moved[63], 0x2A);
+        ASSERT_EQ(pool->state().num_bytes_used, 256 + 128);
+
+        // too large
+        ASSERT_EQ(pool->reallocate(moved, fmt.block_size + 1), nullptr);
+
+        // size zero frees
+        ASSERT_EQ(pool->reallocate(moved, 0), nullptr);
+        pool->free(blocker);
+        ASSERT_EQ(pool->state().num_bytes_used, 0);
+        ASSERT_EQ(pool->pool_state().num_blocks, 0);
+    }
+}
+
+TEST(BuddyPool, ReallocateRandom)
+{
+    std::mt19937 rng(42);
+
+    for(bool bitmap_tree: {false, true})
+    {
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = 1U << 16U;
+        fmt.min_block_size = 64;
+        fmt.bitmap_tree = bitmap_tree;
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        std::vector<std::pair<uint8_t *, size_t>> allocations(32);
+
+        for(uint32_t i = 0; i < 5000; ++i)
+        {
+            auto &[ptr, num_bytes] = allocations[rng() % allocations.size()];
+            size_t new_num_bytes = 1 + rng() % 2048;
+
+            ptr = static_cast<uint8_t *>(pool->reallocate(ptr, new_num_bytes));
+            ASSERT_NE(ptr, nullptr);
+
+            // contents were preserved
+            for(size_t k = 0; k < std::min(num_bytes, new_num_bytes); ++k)
+            {
+                ASSERT_EQ(ptr[k], static_cast<uint8_t>(num_bytes));
+            }
+            num_bytes = new_num_bytes;
+            memset(ptr, static_cast<uint8_t>(num_bytes), num_bytes);
+        }
+
+        // no overlapping allocations
+        for(auto [ptr, num_bytes]: allocations)
+        {
+            for(size_t k = 0; k < num_bytes; ++k){ ASSERT_EQ(ptr[k], static_cast<uint8_t>(num_bytes)); }
+        }
+
+        for(auto [ptr, num_bytes]: allocations){ pool->free(ptr); }
+        ASSERT_EQ(pool->state().num_bytes_used, 0);
+    }
+}
+
+TEST(BuddyPool, RunningCounters)
+{
+    constexpr size_t block_size = 1U << 16U;
+
+    for(size_t magazine_size: {0, 8})
+    {
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = block_size;
+        fmt.min_block_size = 64;
+        fmt.magazine_size = magazine_size;
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        std::mt19937 rnd(0);
+        std::vector<void *> ptrs;
+        size_t max_bytes_used = 0, max_num_blocks = 0;
+
+        for(uint32_t i = 0; i < 2000; ++i)
+        {
+            if(!ptrs.empty() && rnd() % 3 == 0)
+            {
+                size_t index = rnd() % ptrs.size();
+                pool->free(ptrs[index]);
+                ptrs[index] = ptrs.back();
+                ptrs.pop_back();
+            }
+            else if(!ptrs.empty() && rnd() % 5 == 0)
+            {
+                size_t index = rnd() % ptrs.size();
+                void *ptr = pool->reallocate(ptrs[index], 1 + rnd() % 4096);
+                if(ptr){ ptrs[index] = ptr; }
+            }
+            else{ ptrs.push_back(pool->allocate(1 + rnd() % 4096)); }
+
+            // running counters match the slow path
+            auto state = pool->state();
+            auto pool_state = pool->pool_state();
+            size_t num_bytes_used = 0;
+            for(const auto &[num_bytes, count]: pool_state.allocations){ num_bytes_used += num_bytes * count; }
+
+            ASSERT_EQ(state.num_allocations, pool_state.num_blocks);
+            ASSERT_EQ(state.num_bytes_allocated, pool_state.num_blocks * block_size);
+            ASSERT_EQ(state.num_live_allocations, ptrs.size());
+            ASSERT_LE(state.num_bytes_used, num_bytes_used);
+            if(!magazine_size){ ASSERT_EQ(state.num_bytes_used, num_bytes_used); }
+
+            max_bytes_used = std::max(max_bytes_used, state.num_bytes_used);
+            max_num_blocks = std::max(max_num_blocks, pool_state.num_blocks);
+            ASSERT_EQ(state.max_bytes_used, max_bytes_used);
+            ASSERT_EQ(state.max_bytes_allocated, max_num_blocks * block_size);
+            ASSERT_GE(state.fragmentation, 0.f);
+            ASSERT_LE(state.fragmentation, 1.f);
+        }
+        for(void *ptr: ptrs){ pool->free(ptr); }
+        pool->shrink();
+
+        auto state = pool->state();
+        ASSERT_EQ(state.num_bytes_used, 0);
+        ASSERT_EQ(state.num_live_allocations, 0);
+        ASSERT_EQ(state.num_allocations, 0);
+        ASSERT_EQ(state.fragmentation, 0.f);
+    }
+
+    // fragmentation: two free ranges of equal size
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1024;
+    fmt.min_block_size = 256;
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    void *ptrs[4];
+    for(auto &ptr: ptrs){ ptr = pool->allocate(256); }
+    ASSERT_EQ(pool->state().fragmentation, 0.f);
+
+    pool->free(ptrs[0]);
+    pool->free(ptrs[2]);
+    ASSERT_FLOAT_EQ(pool->state().fragmentation, 0.5f);
+
+    // 512 bytes merged, 256 bytes separate
+    pool->free(ptrs[1]);
+    ASSERT_FLOAT_EQ(pool->state().fragmentation, 1.f / 3.f);
+    pool->free(ptrs[3]);
+    ASSERT_EQ(pool->state().fragmentation, 0.f);
+}
+
+TEST(BuddyPool, SizedFree)
+{
+    constexpr size_t block_size = 1U << 16U;
+
+    for(bool bitmap_tree: {false, true})
+    {
+        for(size_t magazine_size: {0, 8})
+        {
+            crocore::BuddyPool::create_info_t fmt = {};
+            fmt.block_size = block_size;
+            fmt.min_block_size = 64;
+            fmt.bitmap_tree = bitmap_tree;
+            fmt.magazine_size = magazine_size;
+            auto pool = crocore::BuddyPool::create(fmt);
+
+            std::mt19937 rnd(0);
+            std::vector<crocore::Allocator::allocation_t> allocations;
+
+            for(uint32_t i = 0; i < 2000; ++i)
+            {
+                if(!allocations.empty() && rnd() % 3 == 0)
+                {
+                    size_t index = rnd() % allocations.size();
+                    auto allocation = allocations[index];
+                    allocations[index] = allocations.back();
+                    allocations.pop_back();
+
+                    // alternate between handle-based and sized free
+                    if(i % 2){ pool->free(allocation); }
+                    else{ pool->free(allocation.ptr, allocation.num_bytes); }
+                }
+                else
+                {
+                    // mix handle-based and pointer-based allocations
+                    size_t num_bytes = 1 + rnd() % 4096;
+                    auto allocation = i % 4 ? pool->allocate_handle(num_bytes)
+                                            : crocore::Allocator::allocation_t{pool->allocate(num_bytes), num_bytes};
+                    ASSERT_TRUE(allocation.ptr);
+                    ASSERT_EQ(allocation.num_bytes, num_bytes);
+
+                    // handles are only used without magazines
+                    if(!magazine_size && i % 4){ ASSERT_TRUE(allocation.handle); }
+                    allocations.push_back(allocation);
+                }
+                ASSERT_EQ(pool->state().num_live_allocations, allocations.size());
+            }
+            for(const auto &allocation: allocations){ pool->free(allocation); }
+            pool->shrink();
+
+            auto state = pool->state();
+            ASSERT_EQ(state.num_live_allocations, 0);
+            ASSERT_EQ(state.num_bytes_used, 0);
+            ASSERT_EQ(pool->pool_state().num_blocks, 0);
+        }
+    }
+
+    // handles stay valid, when slots of removed blocks are re-used
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1024;
+    fmt.min_block_size = 64;
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    auto a = pool->allocate_handle(1024);
+    auto b = pool->allocate_handle(1024);
+    pool->free(a);
+    auto c = pool->allocate_handle(512);
+    ASSERT_EQ(c.handle >> 32U, a.handle >> 32U);
+    ASSERT_NE(c.handle >> 32U, b.handle >> 32U);
+    pool->free(b);
+    pool->free(c);
+    ASSERT_EQ(pool->pool_state().num_blocks, 0);
+
+    // default implementation of the baseclass
+    crocore::AllocatorPtr allocator = crocore::BuddyPool::create(fmt);
+    auto allocation = allocator->allocate_handle(100);
+    ASSERT_TRUE(allocation.ptr);
+    allocator->free(allocation);
+    allocator->free(crocore::Allocator::allocation_t{});
+    ASSERT_EQ(allocator->state().num_live_allocations, 0);
+}
+
+TEST(BuddyPool, OffsetOnly)
+{
+    constexpr size_t block_size = 1U << 16U;
+
+    for(bool bitmap_tree: {false, true})
+    {
+        // no backing memory
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = block_size;
+        fmt.min_block_size = 64;
+        fmt.bitmap_tree = bitmap_tree;
+        fmt.alloc_fn = {};
+        fmt.dealloc_fn = {};
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        // pointer-based allocations are not available
+        ASSERT_EQ(pool->allocate(100), nullptr);
+        ASSERT_EQ(pool->reallocate(nullptr, 100), nullptr);
+        ASSERT_FALSE(pool->allocate_range(0));
+        ASSERT_FALSE(pool->allocate_range(block_size + 1));
+        ASSERT_FALSE(pool->allocate_range(100, 3));
+
+        std::mt19937 rnd(0);
+        std::vector<crocore::BuddyPool::range_t> ranges;
+
+        for(uint32_t i = 0; i < 2000; ++i)
+        {
+            if(!ranges.empty() && rnd() % 3 == 0)
+            {
+                size_t index = rnd() % ranges.size();
+                pool->free_range(ranges[index]);
+                ranges[index] = ranges.back();
+                ranges.pop_back();
+            }
+            else
+            {
+                size_t num_bytes = 1 + rnd() % 4096;
+                size_t alignment = size_t(1) << (rnd() % 10);
+                auto range = pool->allocate_range(num_bytes, alignment);
+                ASSERT_TRUE(range);
+                ASSERT_GE(range.size, num_bytes);
+                ASSERT_EQ(range.offset % alignment, 0);
+                ASSERT_EQ(range.offset % range.size, 0);
+                ASSERT_LE(range.offset + range.size, block_size);
+                ASSERT_EQ(pool->block_data(range.block), nullptr);
+                ranges.push_back(range);
+            }
+            ASSERT_EQ(pool->state().num_live_allocations, ranges.size());
+        }
+
+        // ranges within a block do not overlap
+        auto sorted = ranges;
+        std::sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs) {
+            return std::make_pair(lhs.block, lhs.offset) < std::make_pair(rhs.block, rhs.offset);
+        });
+        for(size_t i = 1; i < sorted.size(); ++i)
+        {
+            if(sorted[i].block == sorted[i - 1].block)
+            {
+                ASSERT_GE(sorted[i].offset, sorted[i - 1].offset + sorted[i - 1].size);
+            }
+        }
+
+        for(const auto &range: ranges){ pool->free_range(range); }
+        auto state = pool->state();
+        ASSERT_EQ(state.num_live_allocations, 0);
+        ASSERT_EQ(state.num_bytes_used, 0);
+        ASSERT_EQ(pool->pool_state().num_blocks, 0);
+    }
+
+    // sub-allocate a single, externally owned staging-buffer
+    std::vector<uint8_t> staging_buffer(block_size);
+
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = block_size;
+    fmt.min_block_size = 256;
+    fmt.min_num_blocks = fmt.max_num_blocks = 1;
+    fmt.alloc_fn = {};
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    auto a = pool->allocate_range(block_size / 2);
+    auto b = pool->allocate_range(block_size / 2);
+    ASSERT_TRUE(a && b);
+    ASSERT_EQ(a.block, b.block);
+    ASSERT_FALSE(pool->allocate_range(1));
+    memset(staging_buffer.data() + a.offset, 0xff, a.size);
+    memset(staging_buffer.data() + b.offset, 0x00, b.size);
+
+    // ranges not matching an allocation are ignored
+    for(crocore::BuddyPool::range_t invalid: {crocore::BuddyPool::range_t{a.block, a.offset, a.size / 2},
+                                              crocore::BuddyPool::range_t{a.block, a.offset, 2 * a.size},
+                                              crocore::BuddyPool::range_t{a.block, a.offset + 256, 256},
+                                              crocore::BuddyPool::range_t{a.block, 4 * block_size, a.size},
+                                              crocore::BuddyPool::range_t{a.block + 1, a.offset, a.size}})
+    {
+        pool->free_range(invalid);
+        ASSERT_EQ(pool->state().num_live_allocations, 2);
+    }
+
+    pool->free_range(a);
+    pool->free_range(b);
+    ASSERT_TRUE(pool->allocate_range(block_size));
+    ASSERT_EQ(pool->pool_state().num_blocks, 1);
+
+    // ranges also work with backing memory
+    fmt = {};
+    fmt.block_size = block_size;
+    pool = crocore::BuddyPool::create(fmt);
+    auto range = pool->allocate_range(1000);
+    ASSERT_TRUE(range);
+    auto *ptr = static_cast<uint8_t *>(pool->block_data(range.block)) + range.offset;
+    memset(ptr, 0, range.size);
+    pool->free_range(range);
+    ASSERT_EQ(pool->state().num_live_allocations, 0);
+    ASSERT_EQ(pool->block_data(range.block), nullptr);
+}
+
+TEST(BuddyPool, Defragment)
+{
+    constexpr size_t block_size = 1U << 16U;
+    constexpr size_t num_bytes = 1024;
+
+    for(bool bitmap_tree: {false, true})
+    {
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = block_size;
+        fmt.min_block_size = 64;
+        fmt.bitmap_tree = bitmap_tree;
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        // allocations and their content
+        std::unordered_map<void *, uint8_t> allocations;
+
+        for(uint32_t i = 0; i < 16 * block_size / num_bytes; ++i)
+        {
+            void *ptr = pool->allocate(num_bytes);
+            auto value = static_cast<uint8_t>(i);
+            memset(ptr, value, num_bytes);
+            allocations[ptr] = value;
+        }
+        ASSERT_EQ(pool->pool_state().num_blocks, 16);
+
+        // free 80% of all allocations
+        std::mt19937 rnd(0);
+        for(auto it = allocations.begin(); it != allocations.end();)
+        {
+            if(rnd() % 5)
+            {
+                pool->free(it->first);
+                it = allocations.erase(it);
+            }
+            else{ ++it; }
+        }
+        auto state = pool->state();
+        ASSERT_EQ(pool->pool_state().num_blocks, 16);
+
+        // pin a single allocation
+        void *pinned = allocations.begin()->first;
+
+        auto relocate = [&allocations, pinned](const crocore::BuddyPool::relocation_t &r) -> bool {
+            if(r.src_ptr == pinned){ return false; }
+            EXPECT_EQ(r.src.size, size_t(num_bytes));
+            memcpy(r.dst_ptr, r.src_ptr, r.src.size);
+            auto it = allocations.find(r.src_ptr);
+            EXPECT_NE(it, allocations.end());
+            allocations[r.dst_ptr] = it->second;
+            allocations.erase(it);
+            return true;
+        };
+
+        // single moves per call
+        size_t num_calls = 0, num_moves = 0, num_blocks_released = 0;
+        for(;; ++num_calls)
+        {
+            auto result = pool->defragment(relocate, std::chrono::nanoseconds(0));
+            num_moves += result.num_moves;
+            num_blocks_released += result.num_blocks_released;
+            if(result.done){ break; }
+            ASSERT_LE(result.num_moves, 1);
+        }
+        ASSERT_GT(num_calls, 1);
+        ASSERT_GT(num_moves, 0);
+        ASSERT_GT(num_blocks_released, 0);
+
+        // fewer blocks, all allocations intact
+        auto num_blocks = pool->pool_state().num_blocks;
+        ASSERT_LE(num_blocks, 16 - num_blocks_released);
+        ASSERT_EQ(pool->state().num_live_allocations, allocations.size());
+        ASSERT_EQ(pool->state().num_bytes_used, state.num_bytes_used);
+        ASSERT_TRUE(allocations.count(pinned));
+
+        for(const auto &[ptr, value]: allocations)
+        {
+            auto *data = static_cast<uint8_t *>(ptr);
+            for(size_t i = 0; i < num_bytes; ++i){ ASSERT_EQ(data[i], value); }
+        }
+
+        // dense blocks are left alone
+        auto result = pool->defragment(relocate, std::chrono::seconds(1), 0.1f);
+        ASSERT_TRUE(result.done);
+        ASSERT_EQ(result.num_moves, 0);
+
+        // all allocations pinned, the budget still applies
+        for(bool done = false; !done;)
+        {
+            size_t num_relocations = 0;
+            done = pool->defragment([&num_relocations](const crocore::BuddyPool::relocation_t &) {
+                num_relocations++;
+                return false;
+            }, std::chrono::nanoseconds(0), 1.f).done;
+            ASSERT_LE(num_relocations, 1);
+        }
+
+        for(const auto &[ptr, value]: allocations){ pool->free(ptr); }
+        ASSERT_EQ(pool->pool_state().num_blocks, 0);
+    }
+
+    // offset-only mode, ranges are updated through the callback
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = block_size;
+    fmt.min_block_size = 256;
+    fmt.alloc_fn = {};
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    std::vector<crocore::BuddyPool::range_t> ranges;
+    for(uint32_t i = 0; i < 4 * block_size / num_bytes; ++i){ ranges.push_back(pool->allocate_range(num_bytes)); }
+
+    // keep every 8th range
+    std::vector<crocore::BuddyPool::range_t> kept;
+    for(uint32_t i = 0; i < ranges.size(); ++i)
+    {
+        if(i % 8){ pool->free_range(ranges[i]); }
+        else{ kept.push_back(ranges[i]); }
+    }
+    ASSERT_EQ(pool->pool_state().num_blocks, 4);
+
+    auto result = pool->defragment([&kept](const crocore::BuddyPool::relocation_t &r) {
+        EXPECT_EQ(r.src_ptr, nullptr);
+        for(auto &range: kept)
+        {
+            if(range.block == r.src.block && range.offset == r.src.offset){ range = r.dst; }
+        }
+        return true;
+    }, std::chrono::seconds(1));
+    ASSERT_TRUE(result.done);
+    ASSERT_EQ(result.num_blocks_released, 3);
+    ASSERT_EQ(pool->pool_state().num_blocks, 1);
+
+    for(const auto &range: kept){ pool->free_range(range); }
+    ASSERT_EQ(pool->state().num_live_allocations, 0);
+
+    // magazines, cached blocks are not relocated while another thread keeps allocating
+    fmt = {};
+    fmt.block_size = block_size;
+    fmt.min_block_size = 64;
+    fmt.magazine_size = 8;
+    pool = crocore::BuddyPool::create(fmt);
+
+    std::unordered_set<void *> live;
+    for(uint32_t i = 0; i < 8 * block_size / num_bytes; ++i)
+    {
+        void *ptr = pool->allocate(num_bytes);
+        if(i % 4){ pool->free(ptr, num_bytes); }
+        else{ live.insert(ptr); }
+    }
+
+    std::atomic<bool> running = true;
+    std::thread worker([&pool, &running] {
+        while(running){ pool->free(pool->allocate(num_bytes), num_bytes); }
+    });
+
+    for(bool done = false; !done;)
+    {
+        done = pool->defragment([&live](const crocore::BuddyPool::relocation_t &r) {
+            auto it = live.find(r.src_ptr);
+            EXPECT_NE(it, live.end());
+            if(it == live.end()){ return false; }
+            live.erase(it);
+            live.insert(r.dst_ptr);
+            return true;
+        }, std::chrono::microseconds(100)).done;
+    }
+    running = false;
+    worker.join();
+
+    for(void *ptr: live){ pool->free(ptr, num_bytes); }
+    pool->shrink();
+    ASSERT_EQ(pool->state().num_live_allocations, 0);
+}
+
+TEST(BuddyPool, BlockLocks)
+{
+    constexpr size_t block_size = 1U << 18U;
+    constexpr size_t num_threads = 4;
+    constexpr size_t num_allocations = 2000;
+
+    for(bool bitmap_tree: {false, true})
+    {
+        crocore::BuddyPool::create_info_t fmt = {};
+        fmt.block_size = block_size;
+        fmt.min_block_size = 64;
+        fmt.bitmap_tree = bitmap_tree;
+        fmt.block_locks = true;
+        auto pool = crocore::BuddyPool::create(fmt);
+
+        // basic usage, new blocks are added on demand
+        void *ptr = pool->allocate(block_size);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(pool->reallocate(ptr, block_size / 2), ptr);
+        auto range = pool->allocate_range(block_size / 2);
+        ASSERT_TRUE(range);
+        ASSERT_EQ(pool->pool_state().num_blocks, 1);
+        ASSERT_EQ(static_cast<uint8_t *>(pool->block_data(range.block)) + range.offset,
+                  static_cast<uint8_t *>(ptr) + block_size / 2);
+        ASSERT_EQ(pool->state().fragmentation, 0.f);
+        pool->free_range(range);
+        pool->free(ptr, block_size / 2);
+        ASSERT_EQ(pool->pool_state().num_blocks, 0);
+
+        // concurrent mix of pointer-, handle- and sized allocations across several blocks
+        auto worker_fn = [&pool](uint32_t seed) {
+            std::mt19937 rnd(seed);
+            std::vector<std::pair<crocore::Allocator::allocation_t, uint8_t>> allocations;
+
+            for(uint32_t i = 0; i < num_allocations; ++i)
+            {
+                if(!allocations.empty() && rnd() % 2)
+                {
+                    size_t index = rnd() % allocations.size();
+                    auto [allocation, value] = allocations[index];
+                    allocations[index] = allocations.back();
+                    allocations.pop_back();
+
+                    auto p = static_cast<uint8_t *>(allocation.ptr);
+                    for(size_t k = 0; k < allocation.num_bytes; ++k){ ASSERT_EQ(p[k], value); }
+
+                    if(i % 3 == 0){ pool->free(allocation.ptr); }
+                    else{ pool->free(allocation); }
+                }
+                else
+                {
+                    size_t num_bytes = 1 + rnd() % 16384;
+                    auto allocation = i % 2 ? pool->allocate_handle(num_bytes)
+                                            : crocore::Allocator::allocation_t{pool->allocate(num_bytes), num_bytes};
+                    ASSERT_TRUE(allocation.ptr);
+                    auto value = static_cast<uint8_t>(rnd());
+                    memset(allocation.ptr, value, num_bytes);
+                    allocations.emplace_back(allocation, value);
+                }
+            }
+            for(auto &[allocation, value]: allocations){ pool->free(allocation); }
+        };
+
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < num_threads; ++i){ threads.emplace_back(worker_fn, i + 1); }
+        for(auto &t: threads){ t.join(); }
+
+        auto state = pool->state();
+        ASSERT_EQ(state.num_live_allocations, 0);
+        ASSERT_EQ(state.num_bytes_used, 0);
+
+        auto pool_state = pool->pool_state();
+        ASSERT_EQ(pool_state.allocations.size(), 0);
+        ASSERT_EQ(pool_state.num_blocks, 0);
+    }
+}
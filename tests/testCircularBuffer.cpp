@@ -2,6 +2,7 @@
 
 #include "crocore/crocore.hpp"
 #include "crocore/CircularBuffer.hpp"
+#include <numeric>
 
 
 TEST(testCircularBuffer, basic)
@@ -110,6 +111,108 @@ TEST(testCircularBuffer, basic)
     ASSERT_TRUE(circ_buf.empty());
 }
 
+TEST(testCircularBuffer, bulk)
+{
+    crocore::CircularBuffer<int> circ_buf(6);
+    std::vector<int> values(10);
+    std::iota(values.begin(), values.end(), 0);
+
+    circ_buf.push_back(std::span<const int>(values.data(), 4));
+    ASSERT_EQ(circ_buf.size(), 4);
+    ASSERT_EQ(circ_buf.back(), 3);
+
+    // contiguous, second region is empty
+    auto [first, second] = circ_buf.as_spans();
+    ASSERT_EQ(first.size(), 4);
+    ASSERT_TRUE(second.empty());
+
+    // wrap around the end of the storage
+    circ_buf.pop_front(3);
+    ASSERT_EQ(circ_buf.size(), 1);
+    ASSERT_EQ(circ_buf.front(), 3);
+    circ_buf.push_back(std::span<const int>(values.data() + 4, 5));
+    ASSERT_EQ(circ_buf.size(), 6);
+
+    std::tie(first, second) = circ_buf.as_spans();
+    ASSERT_FALSE(second.empty());
+    ASSERT_EQ(first.size() + second.size(), 6);
+    ASSERT_EQ(second.back(), circ_buf.back());
+    for(uint32_t i = 0; i < circ_buf.size(); ++i){ ASSERT_EQ(circ_buf[i], 3 + int(i)); }
+
+    // read without removing
+    std::vector<int> out(4);
+    ASSERT_EQ(circ_buf.read(out), 4);
+    ASSERT_EQ(out, std::vector<int>({3, 4, 5, 6}));
+    out.resize(10);
+    ASSERT_EQ(circ_buf.read(out), 6);
+    ASSERT_EQ(std::vector<int>(out.begin(), out.begin() + 6), std::vector<int>({3, 4, 5, 6, 7, 8}));
+    ASSERT_EQ(circ_buf.size(), 6);
+
+    // overflow drops the oldest values, only the last capacity() values are kept
+    circ_buf.push_back(std::span<const int>(values.data(), 2));
+    ASSERT_EQ(circ_buf.front(), 5);
+    ASSERT_EQ(circ_buf.back(), 1);
+    circ_buf.push_back(values);
+    ASSERT_EQ(circ_buf.size(), 6);
+    for(uint32_t i = 0; i < circ_buf.size(); ++i){ ASSERT_EQ(circ_buf[i], 4 + int(i)); }
+
+    // pop more than available
+    circ_buf.pop_front(100);
+    ASSERT_TRUE(circ_buf.empty());
+    ASSERT_EQ(circ_buf.read(out), 0);
+
+    // zero capacity
+    crocore::CircularBuffer<int> empty_buf(0);
+    empty_buf.push_back(values);
+    empty_buf.push_back(1);
+    ASSERT_TRUE(empty_buf.empty());
+}
+
+TEST(testCircularBuffer, non_trivial)
+{
+    auto value = std::make_shared<int>(42);
+
+    {
+        crocore::CircularBuffer<std::shared_ptr<int>> circ_buf(4);
+        for(uint32_t i = 0; i < 10; ++i){ circ_buf.push_back(value); }
+        ASSERT_EQ(circ_buf.size(), 4);
+        ASSERT_EQ(value.use_count(), 5);
+
+        // copies hold their own references
+        auto copy = circ_buf;
+        ASSERT_EQ(value.use_count(), 9);
+        copy.clear();
+        ASSERT_EQ(value.use_count(), 5);
+
+        circ_buf.pop_front();
+        circ_buf.pop_front(2);
+        ASSERT_EQ(value.use_count(), 2);
+
+        std::vector<std::shared_ptr<int>> values(3, value);
+        circ_buf.push_back(values);
+        ASSERT_EQ(circ_buf.size(), 4);
+        ASSERT_EQ(value.use_count(), 8);
+
+        std::vector<std::shared_ptr<int>> out(4);
+        ASSERT_EQ(circ_buf.read(out), 4);
+        ASSERT_EQ(*out.back(), 42);
+        out.clear();
+        values.clear();
+        ASSERT_EQ(value.use_count(), 5);
+    }
+    // remaining values are destroyed with the buffer
+    ASSERT_EQ(value.use_count(), 1);
+
+    // re-insert the oldest value into a full buffer
+    crocore::CircularBuffer<std::shared_ptr<int>> circ_buf(2);
+    circ_buf.push_back(value);
+    circ_buf.push_back(std::make_shared<int>(23));
+    circ_buf.push_back(circ_buf.front());
+    ASSERT_EQ(circ_buf.size(), 2);
+    ASSERT_EQ(circ_buf.back(), value);
+    ASSERT_EQ(value.use_count(), 2);
+}
+
 //____________________________________________________________________________//
 
 // EOF
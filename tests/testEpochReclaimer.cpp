@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "crocore/EpochReclaimer.hpp"
+
+TEST(EpochReclaimer, basic)
+{
+    crocore::EpochReclaimer::create_info_t create_info = {};
+    create_info.max_num_threads = 2;
+    create_info.batch_size = 1000;
+    auto reclaimer = crocore::EpochReclaimer::create(create_info);
+
+    size_t num_deleted = 0;
+    auto deleter = [](void *ptr, void *user_data) {
+        delete static_cast<int *>(ptr);
+        (*static_cast<size_t *>(user_data))++;
+    };
+
+    auto reader = reclaimer->register_thread();
+    auto writer = reclaimer->register_thread();
+    ASSERT_TRUE(reader.valid());
+    ASSERT_TRUE(writer.valid());
+
+    // all slots in use
+    ASSERT_THROW(reclaimer->register_thread(), std::runtime_error);
+
+    {
+        // reader enters a critical section
+        auto guard = reader.pin();
+
+        writer.retire(new int(42), deleter, &num_deleted);
+        ASSERT_EQ(writer.num_retired(), 1);
+
+        // pinned reader prevents reclamation, no matter how often we try
+        for(uint32_t i = 0; i < 10; ++i) { writer.collect(); }
+        ASSERT_EQ(num_deleted, 0);
+        ASSERT_EQ(writer.num_retired(), 1);
+    }
+
+    // reader left the critical section, object can go after aging for some epochs
+    for(uint32_t i = 0; i < 3; ++i) { writer.collect(); }
+    ASSERT_EQ(num_deleted, 1);
+    ASSERT_EQ(writer.num_retired(), 0);
+
+    // nested critical sections
+    {
+        auto guard = reader.pin();
+        {
+            auto inner_guard = reader.pin();
+        }
+        writer.retire(new int(69), deleter, &num_deleted);
+        for(uint32_t i = 0; i < 10; ++i) { writer.collect(); }
+        ASSERT_EQ(num_deleted, 1);
+    }
+
+    // unregistered participants leave orphans behind, reclaimed by the EpochReclaimer itself
+    writer = {};
+    ASSERT_FALSE(writer.valid());
+    ASSERT_EQ(num_deleted + reclaimer->collect_orphans() + reclaimer->collect_orphans(), 2);
+
+    // slot was released and can be re-used
+    writer = reclaimer->register_thread();
+    writer.retire(new int(1));
+}
+
+TEST(EpochReclaimer, concurrent)
+{
+    struct node_t
+    {
+        uint32_t value = 0;
+    };
+
+    //! reclaimed nodes are poisoned instead of freed, so readers can detect premature reclamation
+    constexpr uint32_t k_poison = 0xDEADBEEF;
+
+    struct graveyard_t
+    {
+        std::mutex mutex;
+        std::vector<node_t *> nodes;
+    } graveyard;
+
+    auto poison_fn = [](void *ptr, void *user_data) {
+        auto *node = static_cast<node_t *>(ptr);
+        auto *g = static_cast<graveyard_t *>(user_data);
+        std::atomic_ref(node->value).store(k_poison, std::memory_order_relaxed);
+        std::unique_lock lock(g->mutex);
+        g->nodes.push_back(node);
+    };
+
+    constexpr uint32_t num_readers = 3;
+    constexpr uint32_t num_updates = 20000;
+
+    auto reclaimer = crocore::EpochReclaimer::create({});
+    std::atomic<node_t *> shared_node = new node_t{0};
+    std::atomic<bool> running = true;
+    std::atomic<uint32_t> num_poisoned_reads = 0;
+
+    std::vector<std::thread> readers;
+    for(uint32_t i = 0; i < num_readers; ++i)
+    {
+        readers.emplace_back([&] {
+            auto participant = reclaimer->register_thread();
+
+            while(running)
+            {
+                auto guard = participant.pin();
+                node_t *node = shared_node.load(std::memory_order_acquire);
+                if(std::atomic_ref(node->value).load(std::memory_order_relaxed) == k_poison){ num_poisoned_reads++; }
+            }
+        });
+    }
+
+    {
+        auto writer = reclaimer->register_thread();
+
+        for(uint32_t i = 1; i <= num_updates; ++i)
+        {
+            node_t *old_node = shared_node.exchange(new node_t{i}, std::memory_order_acq_rel);
+            writer.retire(old_node, poison_fn, &graveyard);
+        }
+        running = false;
+        for(auto &t: readers) { t.join(); }
+
+        // no reader observed a reclaimed node, but reclamation did happen
+        ASSERT_EQ(num_poisoned_reads, 0);
+        std::unique_lock lock(graveyard.mutex);
+        ASSERT_GT(graveyard.nodes.size(), 0);
+    }
+
+    // remaining nodes are reclaimed with the reclaimer
+    reclaimer.reset();
+    ASSERT_EQ(graveyard.nodes.size(), num_updates);
+    for(auto *node: graveyard.nodes)
+    {
+        ASSERT_EQ(node->value, k_poison);
+        delete node;
+    }
+    delete shared_node.load();
+}
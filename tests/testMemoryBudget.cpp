@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <crocore/MemoryBudget.hpp>
+#include <crocore/MemoryCache.hpp>
+
+//! returns a MemoryCache, holding num_bytes in a single free chunk
+static crocore::MemoryCachePtr idle_cache(size_t num_bytes, crocore::MemoryBudgetPtr budget = {})
+{
+    crocore::MemoryCache::create_info_t create_info = {};
+    create_info.budget = std::move(budget);
+    auto cache = crocore::MemoryCache::create(create_info);
+    cache->free(cache->allocate(num_bytes));
+    return cache;
+}
+
+TEST(MemoryBudget, Constructors)
+{
+    // unlimited budget, no pressure
+    auto budget = crocore::MemoryBudget::create({});
+    ASSERT_NE(budget, nullptr);
+    EXPECT_EQ(budget->budget(), 0);
+    EXPECT_EQ(budget->usage(), 0);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+
+    // global budget is a singleton
+    ASSERT_NE(crocore::MemoryBudget::global(), nullptr);
+    EXPECT_EQ(crocore::MemoryBudget::global(), crocore::MemoryBudget::global());
+    EXPECT_EQ(crocore::MemoryBudget::global()->budget(), crocore::MemoryBudget::cgroup_limit());
+}
+
+TEST(MemoryBudget, PressureLevels)
+{
+    constexpr size_t num_bytes = 1U << 20U;
+    std::vector<crocore::MemoryPressure> levels;
+
+    crocore::MemoryBudget::create_info_t create_info = {};
+    create_info.budget = num_bytes;
+    create_info.pressure_fn = [&levels](crocore::MemoryPressure pressure) { levels.push_back(pressure); };
+    auto budget = crocore::MemoryBudget::create(create_info);
+
+    auto allocator = crocore::MemoryCache::create({});
+    budget->add(allocator);
+
+    void *ptr = allocator->allocate(num_bytes / 2);
+    EXPECT_EQ(budget->usage(), num_bytes / 2);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+
+    // used memory cannot be released
+    void *ptr2 = allocator->allocate(num_bytes / 4);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::MODERATE);
+    EXPECT_EQ(budget->pressure(), crocore::MemoryPressure::MODERATE);
+
+    void *ptr3 = allocator->allocate(num_bytes / 8);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::HIGH);
+
+    void *ptr4 = allocator->allocate(num_bytes / 8);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::CRITICAL);
+
+    // no change, no notification
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::CRITICAL);
+
+    for(void *p: {ptr, ptr2, ptr3, ptr4}){ allocator->free(p); }
+
+    // free chunks are released
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+    EXPECT_EQ(allocator->state().num_bytes_allocated, 0);
+
+    std::vector<crocore::MemoryPressure> expected = {crocore::MemoryPressure::MODERATE,
+                                                     crocore::MemoryPressure::HIGH,
+                                                     crocore::MemoryPressure::CRITICAL,
+                                                     crocore::MemoryPressure::NONE};
+    EXPECT_EQ(levels, expected);
+
+    // raising the budget relieves pressure
+    ptr = allocator->allocate(num_bytes);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::CRITICAL);
+    budget->set_budget(4 * num_bytes);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+    allocator->free(ptr);
+}
+
+TEST(MemoryBudget, ShrinkCascade)
+{
+    constexpr size_t num_bytes = 1U << 20U;
+
+    crocore::MemoryBudget::create_info_t create_info = {};
+    create_info.budget = 9 * num_bytes / 2;
+    auto budget = crocore::MemoryBudget::create(create_info);
+
+    // registered in reverse order of priority
+    auto high_priority = idle_cache(num_bytes);
+    auto low_priority = idle_cache(num_bytes);
+    auto used = crocore::MemoryCache::create({});
+    void *ptr = used->allocate(2 * num_bytes);
+
+    auto used_id = budget->add(used, -1);
+    budget->add(high_priority, 1);
+    budget->add(low_priority, 0);
+    EXPECT_EQ(budget->usage(), 4 * num_bytes);
+
+    // releasing the lowest priority with free chunks suffices
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+    EXPECT_EQ(low_priority->state().num_bytes_allocated, 0);
+    EXPECT_EQ(high_priority->state().num_bytes_allocated, num_bytes);
+    EXPECT_EQ(used->state().num_bytes_allocated, 2 * num_bytes);
+
+    // removed allocators are not accounted
+    budget->remove(used_id);
+    EXPECT_EQ(budget->usage(), num_bytes);
+
+    // expired allocators are ignored
+    high_priority.reset();
+    EXPECT_EQ(budget->usage(), 0);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+    used->free(ptr);
+}
+
+TEST(MemoryBudget, Trim)
+{
+    constexpr size_t num_bytes = 1U << 20U;
+
+    crocore::MemoryBudget::create_info_t create_info = {};
+    create_info.budget = 4 * num_bytes;
+    auto budget = crocore::MemoryBudget::create(create_info);
+
+    // 3 free chunks -> 75% -> MODERATE
+    crocore::MemoryCache::create_info_t cache_info = {};
+    cache_info.max_idle_duration = std::chrono::nanoseconds(1);
+    auto cache = crocore::MemoryCache::create(cache_info);
+    std::vector<void *> ptrs;
+    for(uint32_t i = 0; i < 3; ++i){ ptrs.push_back(cache->allocate(num_bytes)); }
+    for(void *p: ptrs){ cache->free(p); }
+
+    // without trim-function, moderate pressure does not shrink
+    auto id = budget->add(cache);
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::MODERATE);
+    EXPECT_EQ(cache->state().num_bytes_allocated, 3 * num_bytes);
+    budget->remove(id);
+
+    // incremental trimming, one chunk suffices
+    uint32_t num_trims = 0;
+    budget->add(cache, 0, [&cache, &num_trims] {
+        cache->trim(1);
+        num_trims++;
+    });
+    EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+    EXPECT_EQ(num_trims, 1);
+    EXPECT_EQ(cache->state().num_bytes_allocated, 2 * num_bytes);
+}
+
+TEST(MemoryBudget, MemoryCache)
+{
+    constexpr size_t num_bytes = 1U << 20U;
+
+    crocore::MemoryBudget::create_info_t create_info = {};
+    create_info.budget = num_bytes;
+    crocore::MemoryBudgetPtr budget = crocore::MemoryBudget::create(create_info);
+
+    for(bool size_classes: {false, true})
+    {
+        // another registered allocator exhausts the budget, the cache experiences pressure it didn't cause
+        auto other = crocore::MemoryCache::create({});
+        void *ptr = other->allocate(num_bytes);
+        auto other_id = budget->add(other);
+        EXPECT_EQ(budget->update(), crocore::MemoryPressure::CRITICAL);
+
+        crocore::MemoryCache::create_info_t cache_info = {};
+        cache_info.size_classes = size_classes;
+        cache_info.budget = budget;
+        auto cache = crocore::MemoryCache::create(cache_info);
+
+        // free chunk too small for re-use, released before growing
+        cache->free(cache->allocate(1U << 12U));
+        EXPECT_GT(cache->state().num_bytes_allocated, 0);
+
+        void *large = cache->allocate(num_bytes / 2);
+        ASSERT_NE(large, nullptr);
+        EXPECT_EQ(cache->state().num_bytes_allocated, cache->state().num_bytes_used);
+        cache->free(large);
+
+        // without pressure, free chunks are kept
+        other->free(ptr);
+        other->shrink();
+        EXPECT_EQ(budget->update(), crocore::MemoryPressure::NONE);
+        cache->free(cache->allocate(1U << 12U));
+        large = cache->allocate(num_bytes / 2);
+        EXPECT_GT(cache->state().num_bytes_allocated, cache->state().num_bytes_used);
+        cache->free(large);
+        budget->remove(other_id);
+    }
+}
+
+TEST(MemoryBudget, ProcessUsage)
+{
+#if defined(__linux__)
+    EXPECT_GT(crocore::MemoryBudget::process_rss(), 0);
+#endif
+    crocore::MemoryBudget::create_info_t create_info = {};
+    create_info.usage_source = crocore::MemoryUsageSource::PROCESS_RSS;
+    auto budget = crocore::MemoryBudget::create(create_info);
+    EXPECT_EQ(budget->usage() > 0, crocore::MemoryBudget::process_rss() > 0);
+
+    // cgroup-limits are optional, a limit is at least the usage
+    size_t limit = crocore::MemoryBudget::cgroup_limit();
+    if(limit){ EXPECT_GE(limit, crocore::MemoryBudget::cgroup_usage()); }
+}
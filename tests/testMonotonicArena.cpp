@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <crocore/MonotonicArena.hpp>
+#include <cstring>
+#include <vector>
+
+TEST(MonotonicArena, Allocations)
+{
+    crocore::MonotonicArena::create_info_t create_info;
+    create_info.chunk_size = 1U << 12U;
+    auto arena = crocore::MonotonicArena::create(create_info);
+    ASSERT_NE(arena, nullptr);
+    ASSERT_EQ(arena->state().num_allocations, 0);
+    ASSERT_EQ(arena->allocate(0), nullptr);
+
+    // consecutive allocations are bumped
+    auto *ptr1 = static_cast<uint8_t *>(arena->allocate(16));
+    auto *ptr2 = static_cast<uint8_t *>(arena->allocate(16));
+    ASSERT_NE(ptr1, nullptr);
+    ASSERT_EQ(ptr1 + 16, ptr2);
+    ASSERT_EQ(arena->state().num_allocations, 1);
+    ASSERT_EQ(arena->state().num_bytes_used, 32);
+
+    // default alignment
+    auto *ptr3 = static_cast<uint8_t *>(arena->allocate(1));
+    auto *ptr4 = static_cast<uint8_t *>(arena->allocate(1));
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr4) % alignof(std::max_align_t), 0);
+    ASSERT_GT(ptr4, ptr3);
+
+    // explicit alignment
+    for(size_t alignment = 1; alignment <= 256; alignment *= 2)
+    {
+        void *ptr = arena->allocate(3, alignment);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+    }
+    ASSERT_EQ(arena->allocate(8, 3), nullptr);
+
+    // chain more chunks, including an oversized one
+    std::vector<uint8_t *> ptrs;
+    for(size_t i = 0; i < 100; ++i)
+    {
+        size_t num_bytes = i == 50 ? 3 * create_info.chunk_size : 200;
+        auto *ptr = static_cast<uint8_t *>(arena->allocate(num_bytes));
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, static_cast<int>(i), num_bytes);
+        ptrs.push_back(ptr);
+    }
+    for(size_t i = 0; i < ptrs.size(); ++i){ ASSERT_EQ(ptrs[i][0], i); }
+
+    auto state = arena->state();
+    size_t num_chunks = state.num_allocations;
+    ASSERT_GT(num_chunks, 1);
+    ASSERT_GE(state.num_bytes_allocated, state.num_bytes_used);
+    ASSERT_GE(state.num_bytes_used, 99 * 200 + 3 * create_info.chunk_size);
+
+    // rewind, all chunks are kept and re-used
+    arena->reset();
+    state = arena->state();
+    ASSERT_EQ(state.num_allocations, num_chunks);
+    ASSERT_EQ(state.num_bytes_used, 0);
+    ASSERT_EQ(arena->allocate(16), ptr1);
+
+    for(size_t i = 0; i < 100; ++i){ arena->allocate(i == 50 ? 3 * create_info.chunk_size : 200); }
+    ASSERT_EQ(arena->state().num_allocations, num_chunks);
+
+    // release unused chunks
+    arena->reset();
+    arena->allocate(16);
+    arena->shrink();
+    ASSERT_EQ(arena->state().num_allocations, 1);
+    ASSERT_EQ(arena->state().num_bytes_allocated, create_info.chunk_size);
+}
+
+TEST(MonotonicArena, Reallocate)
+{
+    crocore::MonotonicArena::create_info_t create_info;
+    create_info.chunk_size = 1U << 12U;
+    auto arena = crocore::MonotonicArena::create(create_info);
+
+    auto *ptr = static_cast<uint8_t *>(arena->reallocate(nullptr, 20));
+    ASSERT_NE(ptr, nullptr);
+    for(uint8_t i = 0; i < 20; ++i){ ptr[i] = i; }
+
+    // most recent allocation grows in place
+    ASSERT_EQ(arena->reallocate(ptr, 1000), ptr);
+    ASSERT_EQ(arena->state().num_bytes_used, 1000);
+
+    // moved to another chunk
+    auto *new_ptr = static_cast<uint8_t *>(arena->reallocate(ptr, 2 * create_info.chunk_size));
+    ASSERT_NE(new_ptr, nullptr);
+    ASSERT_NE(new_ptr, ptr);
+    for(uint8_t i = 0; i < 20; ++i){ ASSERT_EQ(new_ptr[i], i); }
+
+    // not the most recent allocation, copied to a new location
+    auto *copy = static_cast<uint8_t *>(arena->reallocate(ptr, 10));
+    ASSERT_NE(copy, nullptr);
+    ASSERT_NE(copy, ptr);
+    for(uint8_t i = 0; i < 10; ++i){ ASSERT_EQ(copy[i], i); }
+
+    // original alignment is kept
+    auto *aligned = static_cast<uint8_t *>(arena->allocate(64, 64));
+    arena->allocate(1);
+    aligned = static_cast<uint8_t *>(arena->reallocate(aligned, 128));
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned) % 64, 0);
+
+    // pointers not allocated from this arena
+    int not_managed = 0;
+    ASSERT_EQ(arena->reallocate(&not_managed, 10), nullptr);
+
+    // freeing the most recent allocation rewinds
+    void *last = arena->allocate(32);
+    arena->free(last);
+    ASSERT_EQ(arena->allocate(32), last);
+}
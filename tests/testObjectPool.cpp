@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <crocore/ObjectPool.hpp>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+
+using string_pool_t = crocore::ObjectPool<std::string>;
+
+TEST(ObjectPool, basic)
+{
+    string_pool_t pool(string_pool_t::s_invalid_index, 4);
+    ASSERT_TRUE(pool.empty());
+
+    auto a = pool.create("foo");
+    auto b = pool.create("bar");
+    ASSERT_TRUE(a && b);
+    ASSERT_NE(a, b);
+    ASSERT_EQ(pool.size(), 2);
+    ASSERT_EQ(*pool.get(a), "foo");
+    ASSERT_EQ(*pool.get(b), "bar");
+
+    // packed handles
+    ASSERT_EQ(string_pool_t::handle_t::from_value(a.value()), a);
+
+    // invalid handles
+    ASSERT_FALSE(string_pool_t::handle_t{});
+    ASSERT_EQ(pool.get({}), nullptr);
+    ASSERT_EQ(pool.get({1000, 1}), nullptr);
+    ASSERT_FALSE(pool.destroy({}));
+
+    // stale handles are detected, also after the slot was re-used
+    ASSERT_TRUE(pool.destroy(a));
+    ASSERT_FALSE(pool.is_valid(a));
+    ASSERT_EQ(pool.get(a), nullptr);
+    ASSERT_FALSE(pool.destroy(a));
+
+    auto c = pool.create("baz");
+    ASSERT_EQ(c.index, a.index);
+    ASSERT_NE(c.generation, a.generation);
+    ASSERT_EQ(pool.get(a), nullptr);
+    ASSERT_EQ(*pool.get(c), "baz");
+    ASSERT_EQ(pool.size(), 2);
+
+    // maximum number of objects is respected
+    crocore::ObjectPool<uint32_t> small_pool(8, 8);
+    for(uint32_t i = 0; i < 8; ++i){ ASSERT_TRUE(small_pool.create(i)); }
+    ASSERT_FALSE(small_pool.create(8));
+}
+
+TEST(ObjectPool, iteration)
+{
+    crocore::ObjectPool<uint32_t> pool(crocore::ObjectPool<uint32_t>::s_invalid_index, 16);
+
+    std::vector<crocore::ObjectPool<uint32_t>::handle_t> handles;
+    for(uint32_t i = 0; i < 1000; ++i){ handles.push_back(pool.create(i)); }
+
+    // destroy every third object
+    std::set<uint32_t> values;
+    for(uint32_t i = 0; i < handles.size(); ++i)
+    {
+        if(i % 3 == 0){ pool.destroy(handles[i]); }
+        else{ values.insert(i); }
+    }
+    ASSERT_EQ(pool.size(), values.size());
+
+    // live objects are visited in index-order
+    std::set<uint32_t> visited;
+    uint32_t last_index = 0;
+    pool.for_each([&](crocore::ObjectPool<uint32_t>::handle_t handle, uint32_t &value) {
+        ASSERT_TRUE(visited.empty() || handle.index > last_index);
+        ASSERT_EQ(pool.get(handle), &value);
+        last_index = handle.index;
+        visited.insert(value);
+    });
+    ASSERT_EQ(visited, values);
+
+    const auto &const_pool = pool;
+    uint32_t num_visited = 0;
+    const_pool.for_each([&num_visited](auto, const uint32_t &){ num_visited++; });
+    ASSERT_EQ(num_visited, values.size());
+
+    pool.clear();
+    ASSERT_TRUE(pool.empty());
+    for(const auto &handle: handles){ ASSERT_FALSE(pool.is_valid(handle)); }
+}
+
+TEST(ObjectPool, destructor)
+{
+    auto counter = std::make_shared<int>();
+    {
+        crocore::ObjectPool<std::shared_ptr<int>> pool;
+        for(uint32_t i = 0; i < 100; ++i){ pool.create(counter); }
+        ASSERT_EQ(counter.use_count(), 101);
+    }
+    // remaining objects were destroyed
+    ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST(ObjectPool, concurrent)
+{
+    constexpr uint32_t num_threads = 8;
+    constexpr uint32_t num_iterations = 20000;
+    constexpr uint32_t max_num_live = 64;
+
+    string_pool_t pool(string_pool_t::s_invalid_index, 256, 16);
+
+    auto worker = [&pool](uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<std::pair<string_pool_t::handle_t, std::string>> handles;
+
+        for(uint32_t i = 0; i < num_iterations; ++i)
+        {
+            if(!handles.empty() && (handles.size() >= max_num_live || rng() % 2))
+            {
+                size_t pos = rng() % handles.size();
+                auto [handle, value] = handles[pos];
+                ASSERT_EQ(*pool.get(handle), value);
+                ASSERT_TRUE(pool.destroy(handle));
+                ASSERT_FALSE(pool.is_valid(handle));
+                handles[pos] = handles.back();
+                handles.pop_back();
+            }
+            else
+            {
+                auto value = std::to_string(seed) + "_" + std::to_string(i);
+                auto handle = pool.create(value);
+                ASSERT_TRUE(handle);
+                handles.emplace_back(handle, value);
+            }
+        }
+        for(const auto &[handle, value]: handles){ pool.destroy(handle); }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < num_threads; ++i){ threads.emplace_back(worker, i); }
+    for(auto &t: threads){ t.join(); }
+    ASSERT_TRUE(pool.empty());
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <crocore/BuddyPool.hpp>
+#include <crocore/RecordingAllocator.hpp>
+#include <thread>
+
+crocore::AllocatorPtr create_pool()
+{
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 20U;
+    fmt.min_block_size = 64;
+    return crocore::BuddyPool::create(fmt);
+}
+
+TEST(RecordingAllocator, Record)
+{
+    ASSERT_EQ(crocore::RecordingAllocator::create({}), nullptr);
+
+    auto pool = create_pool();
+    crocore::RecordingAllocatorPtr recorder = crocore::RecordingAllocator::create({pool});
+    ASSERT_NE(recorder, nullptr);
+
+    void *ptr1 = recorder->allocate(100);
+    void *ptr2 = recorder->allocate(1000, 256);
+    ptr1 = recorder->reallocate(ptr1, 5000);
+    recorder->free(ptr2);
+    recorder->free(ptr1);
+
+    // failed allocations are not recorded
+    ASSERT_EQ(recorder->allocate(2U << 20U), nullptr);
+
+    // forwarded to wrapped allocator
+    ASSERT_EQ(recorder->state().num_bytes_used, 0);
+
+    auto trace = recorder->trace();
+    ASSERT_EQ(trace.size(), 5);
+
+    ASSERT_EQ(trace[0].op, crocore::TraceOp::ALLOCATE);
+    ASSERT_EQ(trace[0].id, 0);
+    ASSERT_EQ(trace[0].num_bytes, 100);
+    ASSERT_EQ(trace[0].alignment_log2, 0);
+    ASSERT_EQ(trace[0].thread, crocore::thread_index());
+
+    ASSERT_EQ(trace[1].op, crocore::TraceOp::ALLOCATE);
+    ASSERT_EQ(trace[1].id, 1);
+    ASSERT_EQ(trace[1].alignment_log2, 8);
+
+    ASSERT_EQ(trace[2].op, crocore::TraceOp::REALLOCATE);
+    ASSERT_EQ(trace[2].id, 0);
+    ASSERT_EQ(trace[2].num_bytes, 5000);
+
+    ASSERT_EQ(trace[3].op, crocore::TraceOp::FREE);
+    ASSERT_EQ(trace[3].id, 1);
+    ASSERT_EQ(trace[4].op, crocore::TraceOp::FREE);
+    ASSERT_EQ(trace[4].id, 0);
+
+    recorder->clear();
+    ASSERT_TRUE(recorder->trace().empty());
+}
+
+TEST(RecordingAllocator, SaveLoad)
+{
+    auto recorder = crocore::RecordingAllocator::create({create_pool()});
+
+    std::vector<void *> ptrs;
+    std::vector<std::thread> threads;
+
+    for(uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&recorder] {
+            for(size_t i = 0; i < 100; ++i){ recorder->free(recorder->allocate(16 + i)); }
+        });
+    }
+    for(auto &thread: threads){ thread.join(); }
+
+    auto trace = recorder->trace();
+    ASSERT_EQ(trace.size(), 800);
+
+    auto path = std::filesystem::temp_directory_path() / "crocore_test_trace.bin";
+    ASSERT_TRUE(recorder->save(path));
+
+    auto loaded = crocore::RecordingAllocator::load(path);
+    ASSERT_EQ(loaded.size(), trace.size());
+    ASSERT_EQ(memcmp(loaded.data(), trace.data(), trace.size() * sizeof(crocore::trace_event_t)), 0);
+    std::filesystem::remove(path);
+
+    // invalid files
+    ASSERT_TRUE(crocore::RecordingAllocator::load(path).empty());
+}
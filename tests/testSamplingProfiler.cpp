@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <crocore/BuddyPool.hpp>
+#include <crocore/SamplingProfiler.hpp>
+#include <sstream>
+#include <thread>
+
+static crocore::AllocatorPtr create_pool()
+{
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 24U;
+    fmt.min_block_size = 64;
+    fmt.bitmap_tree = true;
+    return crocore::BuddyPool::create(fmt);
+}
+
+// distinct call-sites
+[[gnu::noinline]] static void *allocate_a(crocore::Allocator &allocator, size_t num_bytes)
+{
+    return allocator.allocate(num_bytes);
+}
+
+[[gnu::noinline]] static void *allocate_b(crocore::Allocator &allocator, size_t num_bytes)
+{
+    return allocator.allocate(num_bytes);
+}
+
+TEST(SamplingProfiler, CallSites)
+{
+    ASSERT_EQ(crocore::SamplingProfiler::create({}), nullptr);
+
+    // sample each allocation
+    crocore::SamplingProfiler::create_info_t create_info = {};
+    create_info.allocator = create_pool();
+    create_info.sample_interval = 1;
+    auto profiler = crocore::SamplingProfiler::create(create_info);
+    ASSERT_NE(profiler, nullptr);
+
+    std::vector<void *> ptrs_a, ptrs_b;
+    for(uint32_t i = 0; i < 100; ++i)
+    {
+        ptrs_a.push_back(allocate_a(*profiler, 1000));
+        ptrs_b.push_back(allocate_b(*profiler, 100));
+    }
+
+    // forwarded to wrapped allocator
+    ASSERT_EQ(profiler->state().num_live_allocations, 200);
+
+    auto call_sites = profiler->call_sites();
+    ASSERT_EQ(call_sites.size(), 2);
+    ASSERT_EQ(call_sites[0].num_live_allocations, 100);
+    ASSERT_EQ(call_sites[0].num_live_bytes, 100 * 1000);
+    ASSERT_EQ(call_sites[1].num_live_bytes, 100 * 100);
+    ASSERT_FALSE(call_sites[0].frames.empty());
+    ASSERT_NE(call_sites[0].frames, call_sites[1].frames);
+
+    // free half of site a, using sized frees
+    for(uint32_t i = 0; i < 50; ++i){ profiler->free(ptrs_a[i], 1000); }
+
+    call_sites = profiler->call_sites();
+    ASSERT_EQ(call_sites[0].num_live_allocations, 50);
+    ASSERT_EQ(call_sites[0].num_live_bytes, 50 * 1000);
+    ASSERT_EQ(call_sites[0].num_allocations, 100);
+    ASSERT_EQ(call_sites[0].num_bytes, 100 * 1000);
+
+    // collapsed stacks, one line per call-site with live bytes
+    std::stringstream ss(profiler->profile(crocore::ProfileFormat::COLLAPSED));
+    std::string line;
+    size_t num_lines = 0, num_bytes = 0;
+    while(std::getline(ss, line))
+    {
+        num_lines++;
+        num_bytes += std::stoul(line.substr(line.rfind(' ') + 1));
+    }
+    ASSERT_EQ(num_lines, 2);
+    ASSERT_EQ(num_bytes, 50 * 1000 + 100 * 100);
+
+    // pprof heap-profile
+    auto heap_profile = profiler->profile(crocore::ProfileFormat::PPROF_HEAP);
+    ASSERT_EQ(heap_profile.rfind("heap profile: 150: 60000 [200: 110000] @ heap\n", 0), 0);
+    ASSERT_NE(heap_profile.find("MAPPED_LIBRARIES:"), std::string::npos);
+
+    for(uint32_t i = 50; i < 100; ++i){ profiler->free(ptrs_a[i]); }
+    for(void *ptr: ptrs_b){ profiler->free(ptr); }
+    for(const auto &call_site: profiler->call_sites()){ ASSERT_EQ(call_site.num_live_bytes, 0); }
+    ASSERT_EQ(profiler->state().num_live_allocations, 0);
+
+    profiler->clear();
+    ASSERT_TRUE(profiler->call_sites().empty());
+}
+
+TEST(SamplingProfiler, Estimates)
+{
+    constexpr size_t num_allocations = 100000;
+    constexpr size_t num_bytes = 64;
+
+    crocore::SamplingProfiler::create_info_t create_info = {};
+    create_info.allocator = create_pool();
+    create_info.sample_interval = 4096;
+    auto profiler = crocore::SamplingProfiler::create(create_info);
+
+    std::vector<crocore::Allocator::allocation_t> allocations;
+    for(size_t i = 0; i < num_allocations; ++i){ allocations.push_back(profiler->allocate_handle(num_bytes)); }
+
+    // unbiased estimates, within 10%
+    size_t estimated_bytes = 0;
+    for(const auto &call_site: profiler->call_sites()){ estimated_bytes += call_site.num_live_bytes; }
+    ASSERT_NEAR(double(estimated_bytes), double(num_allocations * num_bytes), 0.1 * num_allocations * num_bytes);
+
+    for(const auto &allocation: allocations){ profiler->free(allocation); }
+    for(const auto &call_site: profiler->call_sites()){ ASSERT_EQ(call_site.num_live_bytes, 0); }
+}
+
+TEST(SamplingProfiler, Threads)
+{
+    crocore::SamplingProfiler::create_info_t create_info = {};
+    create_info.allocator = create_pool();
+    create_info.sample_interval = 16384;
+    auto profiler = crocore::SamplingProfiler::create(create_info);
+
+    auto worker = [&profiler]() {
+        std::vector<void *> ptrs;
+        for(uint32_t i = 0; i < 10000; ++i)
+        {
+            ptrs.push_back(profiler->allocate(64 + i % 512));
+            if(i % 3 == 0){ ptrs[i / 3] = profiler->reallocate(ptrs[i / 3], 128); }
+        }
+        for(void *ptr: ptrs){ profiler->free(ptr); }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < 4; ++i){ threads.emplace_back(worker); }
+    for(auto &t: threads){ t.join(); }
+
+    ASSERT_EQ(profiler->state().num_live_allocations, 0);
+    for(const auto &call_site: profiler->call_sites()){ ASSERT_EQ(call_site.num_live_bytes, 0); }
+}
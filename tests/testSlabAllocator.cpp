@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <crocore/SlabAllocator.hpp>
+#include <cstring>
+#include <random>
+#include <thread>
+
+TEST(SlabAllocator, Constructors)
+{
+    crocore::SlabAllocator::create_info_t create_info;
+
+    // check for existence of default allocator/de-allocator
+    ASSERT_TRUE(create_info.alloc_fn);
+    ASSERT_TRUE(create_info.dealloc_fn);
+
+    auto slab_allocator = crocore::SlabAllocator::create(create_info);
+    ASSERT_NE(slab_allocator, nullptr);
+
+    // nothing allocated yet
+    auto state = slab_allocator->state();
+    ASSERT_EQ(state.num_allocations, 0);
+    ASSERT_EQ(state.num_bytes_allocated, 0);
+    ASSERT_EQ(state.num_bytes_used, 0);
+}
+
+TEST(SlabAllocator, SizeClasses)
+{
+    crocore::SlabAllocator::create_info_t create_info;
+    create_info.slab_size = 1U << 16U;
+    auto slab_allocator = crocore::SlabAllocator::create(create_info);
+
+    // multiples of 16 bytes up to 128 bytes
+    ASSERT_EQ(slab_allocator->object_size(1), 16);
+    ASSERT_EQ(slab_allocator->object_size(16), 16);
+    ASSERT_EQ(slab_allocator->object_size(17), 32);
+    ASSERT_EQ(slab_allocator->object_size(128), 128);
+
+    // four size-classes per power of two
+    ASSERT_EQ(slab_allocator->object_size(129), 160);
+    ASSERT_EQ(slab_allocator->object_size(230), 256);
+    ASSERT_EQ(slab_allocator->object_size(257), 320);
+
+    // default max_object_size: slab_size / 8
+    ASSERT_EQ(slab_allocator->object_size(create_info.slab_size / 8), create_info.slab_size / 8);
+    ASSERT_EQ(slab_allocator->object_size(create_info.slab_size / 8 + 1), 0);
+    ASSERT_EQ(slab_allocator->allocate(create_info.slab_size / 8 + 1), nullptr);
+    ASSERT_EQ(slab_allocator->allocate(0), nullptr);
+}
+
+TEST(SlabAllocator, Allocations)
+{
+    crocore::SlabAllocator::create_info_t create_info;
+    create_info.slab_size = 1U << 14U;
+    auto slab_allocator = crocore::SlabAllocator::create(create_info);
+
+    constexpr size_t num_allocations = 1000;
+    constexpr size_t num_bytes = 48;
+    std::vector<void *> ptrs;
+
+    for(size_t i = 0; i < num_allocations; ++i)
+    {
+        auto *ptr = static_cast<uint8_t *>(slab_allocator->allocate(num_bytes));
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, static_cast<int>(i & 0xFFU), num_bytes);
+        ptrs.push_back(ptr);
+    }
+
+    // distinct, non-overlapping objects
+    auto sorted = ptrs;
+    std::sort(sorted.begin(), sorted.end());
+    for(size_t i = 1; i < sorted.size(); ++i)
+    {
+        ASSERT_GE(static_cast<uint8_t *>(sorted[i]) - static_cast<uint8_t *>(sorted[i - 1]), num_bytes);
+    }
+
+    // contents were not corrupted
+    for(size_t i = 0; i < num_allocations; ++i)
+    {
+        auto *ptr = static_cast<uint8_t *>(ptrs[i]);
+        ASSERT_EQ(ptr[0], i & 0xFFU);
+        ASSERT_EQ(ptr[num_bytes - 1], i & 0xFFU);
+    }
+
+    auto state = slab_allocator->state();
+    ASSERT_EQ(state.num_bytes_used, num_allocations * num_bytes);
+    ASSERT_EQ(state.num_bytes_allocated, state.num_allocations * create_info.slab_size);
+    ASSERT_GE(state.num_bytes_allocated, num_allocations * num_bytes);
+
+    // objects are re-used
+    void *ptr = ptrs.back();
+    slab_allocator->free(ptr);
+    ASSERT_EQ(slab_allocator->allocate(num_bytes), ptr);
+
+    for(void *p: ptrs){ slab_allocator->free(p); }
+
+    // empty slabs were released, except the active one
+    state = slab_allocator->state();
+    ASSERT_EQ(state.num_bytes_used, 0);
+    ASSERT_LE(state.num_allocations, 1);
+
+    slab_allocator->shrink();
+    state = slab_allocator->state();
+    ASSERT_EQ(state.num_allocations, 0);
+    ASSERT_EQ(state.num_bytes_allocated, 0);
+
+    // still usable after shrinking
+    ptr = slab_allocator->allocate(num_bytes);
+    ASSERT_NE(ptr, nullptr);
+    slab_allocator->free(ptr);
+}
+
+TEST(SlabAllocator, KeepEmptySlabs)
+{
+    crocore::SlabAllocator::create_info_t create_info;
+    create_info.slab_size = 1U << 12U;
+    create_info.dealloc_empty_slabs = false;
+    auto slab_allocator = crocore::SlabAllocator::create(create_info);
+
+    std::vector<void *> ptrs;
+    for(size_t i = 0; i < 500; ++i){ ptrs.push_back(slab_allocator->allocate(64)); }
+    for(void *p: ptrs){ slab_allocator->free(p); }
+
+    auto num_slabs = slab_allocator->state().num_allocations;
+    ASSERT_GT(num_slabs, 1);
+
+    // re-using existing slabs
+    for(size_t i = 0; i < 500; ++i){ ptrs[i] = slab_allocator->allocate(64); }
+    ASSERT_EQ(slab_allocator->state().num_allocations, num_slabs);
+    for(void *p: ptrs){ slab_allocator->free(p); }
+
+    // explicitly released
+    slab_allocator->shrink();
+    ASSERT_EQ(slab_allocator->state().num_allocations, 0);
+}
+
+TEST(SlabAllocator, AlignedAllocations)
+{
+    auto slab_allocator = crocore::SlabAllocator::create({});
+
+    for(size_t alignment = 1; alignment <= 64; alignment *= 2)
+    {
+        for(size_t num_bytes: {1, 24, 48, 100, 200, 1000})
+        {
+            void *ptr = slab_allocator->allocate(num_bytes, alignment);
+            ASSERT_NE(ptr, nullptr);
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+            slab_allocator->free(ptr);
+        }
+    }
+
+    // not supported
+    ASSERT_EQ(slab_allocator->allocate(64, 128), nullptr);
+    ASSERT_EQ(slab_allocator->allocate(64, 3), nullptr);
+}
+
+TEST(SlabAllocator, Reallocate)
+{
+    auto slab_allocator = crocore::SlabAllocator::create({});
+
+    auto *ptr = static_cast<uint8_t *>(slab_allocator->reallocate(nullptr, 20));
+    ASSERT_NE(ptr, nullptr);
+    for(uint8_t i = 0; i < 20; ++i){ ptr[i] = i; }
+
+    // same size-class
+    ASSERT_EQ(slab_allocator->reallocate(ptr, 32), ptr);
+
+    // moved to a larger size-class, contents preserved
+    auto *new_ptr = static_cast<uint8_t *>(slab_allocator->reallocate(ptr, 500));
+    ASSERT_NE(new_ptr, nullptr);
+    for(uint8_t i = 0; i < 20; ++i){ ASSERT_EQ(new_ptr[i], i); }
+
+    // too large, original allocation remains valid
+    ASSERT_EQ(slab_allocator->reallocate(new_ptr, 1U << 20U), nullptr);
+    ASSERT_EQ(new_ptr[19], 19);
+
+    ASSERT_EQ(slab_allocator->reallocate(new_ptr, 0), nullptr);
+    ASSERT_EQ(slab_allocator->state().num_bytes_used, 0);
+}
+
+TEST(SlabAllocator, Concurrent)
+{
+    crocore::SlabAllocator::create_info_t create_info;
+    create_info.slab_size = 1U << 13U;
+    auto slab_allocator = crocore::SlabAllocator::create(create_info);
+
+    constexpr size_t num_threads = 4;
+    constexpr size_t num_iterations = 5000;
+
+    // objects are allocated by one thread and freed by another
+    std::vector<std::vector<void *>> ptrs(num_threads);
+    std::vector<std::thread> threads;
+
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            std::mt19937 rnd(static_cast<uint32_t>(t));
+            std::uniform_int_distribution<size_t> dist(1, 300);
+
+            for(size_t i = 0; i < num_iterations; ++i)
+            {
+                size_t num_bytes = dist(rnd);
+                auto *ptr = static_cast<uint8_t *>(slab_allocator->allocate(num_bytes));
+                ASSERT_NE(ptr, nullptr);
+                memset(ptr, static_cast<int>(t), num_bytes);
+                ptrs[t].push_back(ptr);
+
+                // free half of the objects immediately
+                if(i % 2)
+                {
+                    ASSERT_EQ(ptr[num_bytes - 1], t);
+                    slab_allocator->free(ptr);
+                    ptrs[t].pop_back();
+                }
+            }
+        });
+    }
+    for(auto &thread: threads){ thread.join(); }
+    threads.clear();
+
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for(void *ptr: ptrs[(t + 1) % num_threads]){ slab_allocator->free(ptr); }
+        });
+    }
+    for(auto &thread: threads){ thread.join(); }
+
+    ASSERT_EQ(slab_allocator->state().num_bytes_used, 0);
+    slab_allocator->shrink();
+    ASSERT_EQ(slab_allocator->state().num_allocations, 0);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include <crocore/TLSFPool.hpp>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+
+TEST(TLSFPool, Constructors)
+{
+    crocore::TLSFPool::create_info_t create_info;
+
+    // check for existence of default allocator/de-allocator
+    ASSERT_TRUE(create_info.alloc_fn);
+    ASSERT_TRUE(create_info.dealloc_fn);
+
+    auto pool = crocore::TLSFPool::create(create_info);
+    ASSERT_NE(pool, nullptr);
+
+    // nothing allocated yet
+    auto state = pool->state();
+    ASSERT_EQ(state.num_allocations, 0);
+    ASSERT_EQ(state.num_bytes_allocated, 0);
+    ASSERT_EQ(state.num_bytes_used, 0);
+
+    // preallocated pools
+    create_info.min_num_pools = 3;
+    pool = crocore::TLSFPool::create(create_info);
+    state = pool->state();
+    ASSERT_EQ(state.num_allocations, 3);
+    ASSERT_EQ(state.num_bytes_allocated, 3 * create_info.pool_size);
+    ASSERT_FLOAT_EQ(state.fragmentation, 2.f / 3.f);
+}
+
+TEST(TLSFPool, Allocations)
+{
+    crocore::TLSFPool::create_info_t create_info;
+    create_info.pool_size = 1U << 16U;
+    auto pool = crocore::TLSFPool::create(create_info);
+
+    // zero or too large
+    ASSERT_EQ(pool->allocate(0), nullptr);
+    ASSERT_EQ(pool->allocate(create_info.pool_size), nullptr);
+    ASSERT_EQ(pool->allocate(pool->max_allocation_size() + 1), nullptr);
+
+    // largest allocation always fits into a new pool
+    void *large = pool->allocate(pool->max_allocation_size());
+    ASSERT_NE(large, nullptr);
+    ASSERT_EQ(pool->state().num_allocations, 1);
+    pool->free(large);
+    ASSERT_EQ(pool->state().num_allocations, 0);
+
+    // random allocations, each filled with a pattern
+    std::mt19937 rnd(0);
+    std::map<uint8_t *, std::pair<size_t, uint8_t>> allocations;
+
+    for(uint32_t i = 0; i < 20000; ++i)
+    {
+        if(!allocations.empty() && rnd() % 2)
+        {
+            auto it = allocations.begin();
+            std::advance(it, rnd() % allocations.size());
+            auto [num_bytes, value] = it->second;
+
+            // pattern is intact
+            for(size_t j = 0; j < num_bytes; ++j){ ASSERT_EQ(it->first[j], value); }
+            pool->free(it->first);
+            allocations.erase(it);
+        }
+        else
+        {
+            size_t num_bytes = 1 + (rnd() % 4 ? rnd() % 256 : rnd() % 8192);
+            auto *ptr = static_cast<uint8_t *>(pool->allocate(num_bytes));
+            ASSERT_NE(ptr, nullptr);
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t), 0);
+
+            auto value = static_cast<uint8_t>(i);
+            memset(ptr, value, num_bytes);
+            allocations[ptr] = {num_bytes, value};
+        }
+        ASSERT_EQ(pool->state().num_live_allocations, allocations.size());
+    }
+
+    // no overlaps
+    uint8_t *end = nullptr;
+    for(const auto &[ptr, a]: allocations)
+    {
+        ASSERT_GE(ptr, end);
+        end = ptr + a.first;
+    }
+
+    // all pools are returned, once everything was freed
+    for(const auto &[ptr, a]: allocations){ pool->free(ptr); }
+    auto state = pool->state();
+    ASSERT_EQ(state.num_allocations, 0);
+    ASSERT_EQ(state.num_bytes_used, 0);
+    ASSERT_EQ(state.num_live_allocations, 0);
+    ASSERT_GT(state.max_bytes_allocated, 0);
+}
+
+TEST(TLSFPool, MaxNumPools)
+{
+    crocore::TLSFPool::create_info_t create_info;
+    create_info.pool_size = 1U << 12U;
+    create_info.max_num_pools = 2;
+    create_info.dealloc_unused_pools = false;
+    auto pool = crocore::TLSFPool::create(create_info);
+
+    std::vector<void *> ptrs;
+    while(void *ptr = pool->allocate(130)){ ptrs.push_back(ptr); }
+    ASSERT_EQ(pool->state().num_allocations, 2);
+
+    // fits more blocks than power-of-two rounding (256 bytes) would
+    ASSERT_GT(ptrs.size(), 2 * create_info.pool_size / 256);
+
+    for(void *ptr: ptrs){ pool->free(ptr); }
+    ASSERT_EQ(pool->state().num_allocations, 2);
+
+    pool->shrink();
+    ASSERT_EQ(pool->state().num_allocations, 0);
+}
+
+TEST(TLSFPool, AlignedAllocations)
+{
+    crocore::TLSFPool::create_info_t create_info;
+    create_info.pool_size = 1U << 16U;
+    auto pool = crocore::TLSFPool::create(create_info);
+
+    ASSERT_EQ(pool->allocate(64, 0), nullptr);
+    ASSERT_EQ(pool->allocate(64, 3), nullptr);
+
+    // sizes or alignments close to SIZE_MAX must not wrap around
+    constexpr size_t max_size = std::numeric_limits<size_t>::max();
+    ASSERT_EQ(pool->allocate(max_size - 8, 64), nullptr);
+    ASSERT_EQ(pool->allocate(max_size, 64), nullptr);
+    ASSERT_EQ(pool->allocate(64, size_t(1) << 63U), nullptr);
+    ASSERT_EQ(pool->state().num_allocations, 0);
+
+    std::mt19937 rnd(0);
+    std::vector<void *> ptrs;
+
+    for(uint32_t i = 0; i < 1000; ++i)
+    {
+        size_t alignment = size_t(1) << (rnd() % 12);
+        size_t num_bytes = 1 + rnd() % 1024;
+        void *ptr = pool->allocate(num_bytes, alignment);
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+        memset(ptr, 0xff, num_bytes);
+        ptrs.push_back(ptr);
+
+        if(rnd() % 2)
+        {
+            size_t index = rnd() % ptrs.size();
+            pool->free(ptrs[index]);
+            ptrs[index] = ptrs.back();
+            ptrs.pop_back();
+        }
+    }
+    for(void *ptr: ptrs){ pool->free(ptr); }
+    ASSERT_EQ(pool->state().num_allocations, 0);
+}
+
+TEST(TLSFPool, Reallocate)
+{
+    crocore::TLSFPool::create_info_t create_info;
+    create_info.pool_size = 1U << 16U;
+    auto pool = crocore::TLSFPool::create(create_info);
+
+    // grow in place, followed by free space
+    auto *ptr = static_cast<uint8_t *>(pool->reallocate(nullptr, 100));
+    ASSERT_NE(ptr, nullptr);
+    for(uint32_t i = 0; i < 100; ++i){ ptr[i] = static_cast<uint8_t>(i); }
+
+    ASSERT_EQ(pool->reallocate(ptr, 1000), ptr);
+    ASSERT_EQ(pool->state().num_bytes_used, 1008);
+
+    // shrink in place
+    ASSERT_EQ(pool->reallocate(ptr, 50), ptr);
+    ASSERT_EQ(pool->state().num_bytes_used, 64);
+
+    // blocked by a neighbour, move
+    void *blocker = pool->allocate(16);
+    auto *moved = static_cast<uint8_t *>(pool->reallocate(ptr, 2000));
+    ASSERT_NE(moved, nullptr);
+    ASSERT_NE(moved, ptr);
+    for(uint32_t i = 0; i < 50; ++i){ ASSERT_EQ(moved[i], i); }
+    ASSERT_EQ(pool->state().num_live_allocations, 2);
+
+    // free via reallocate
+    ASSERT_EQ(pool->reallocate(moved, 0), nullptr);
+    pool->free(blocker);
+    ASSERT_EQ(pool->state().num_allocations, 0);
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+}
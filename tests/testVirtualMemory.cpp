@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+#include "crocore/BuddyPool.hpp"
+#include "crocore/MemoryCache.hpp"
+#include "crocore/virtual_memory.hpp"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+
+//! returns the number of resident pages in a page-aligned range
+size_t num_resident_pages(void *ptr, size_t num_bytes)
+{
+    size_t page_size = crocore::virtual_memory::page_size();
+    std::vector<unsigned char> residency((num_bytes + page_size - 1) / page_size);
+    if(mincore(ptr, num_bytes, residency.data())){ return 0; }
+
+    size_t ret = 0;
+    for(auto r: residency){ ret += r & 1; }
+    return ret;
+}
+#endif
+
+using crocore::virtual_memory::PageMode;
+
+TEST(VirtualMemory, Mappings)
+{
+    constexpr size_t num_bytes = 4U << 20U;
+    size_t page_size = crocore::virtual_memory::page_size();
+    size_t huge_page_size = crocore::virtual_memory::huge_page_size();
+    ASSERT_TRUE(crocore::is_pow_2(page_size));
+    ASSERT_TRUE(crocore::is_pow_2(huge_page_size));
+    ASSERT_GE(huge_page_size, page_size);
+
+    ASSERT_EQ(crocore::virtual_memory::map(0), nullptr);
+
+    for(auto mode: {PageMode::DEFAULT, PageMode::HUGE_TRANSPARENT, PageMode::HUGE_EXPLICIT})
+    {
+        auto ptr = static_cast<uint8_t *>(crocore::virtual_memory::map(num_bytes, mode));
+        ASSERT_NE(ptr, nullptr);
+
+        size_t alignment = mode == PageMode::DEFAULT ? page_size : huge_page_size;
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+
+        // zero-initialized and writable
+        ASSERT_EQ(ptr[0], 0);
+        ASSERT_EQ(ptr[num_bytes - 1], 0);
+        memset(ptr, 0xFF, num_bytes);
+
+        ASSERT_TRUE(crocore::virtual_memory::is_mapped(ptr));
+        ASSERT_FALSE(crocore::virtual_memory::is_mapped(ptr + 1));
+        crocore::virtual_memory::unmap(ptr);
+        ASSERT_FALSE(crocore::virtual_memory::is_mapped(ptr));
+    }
+
+    // unknown pointers are ignored
+    int foo = 0;
+    crocore::virtual_memory::unmap(&foo);
+    ASSERT_FALSE(crocore::virtual_memory::is_mapped(&foo));
+}
+
+TEST(VirtualMemory, Release)
+{
+    size_t page_size = crocore::virtual_memory::page_size();
+    size_t num_bytes = 16 * page_size;
+    auto ptr = static_cast<uint8_t *>(crocore::virtual_memory::map(num_bytes));
+    memset(ptr, 0xFF, num_bytes);
+
+    // only entire pages are released
+    ASSERT_EQ(crocore::virtual_memory::release(ptr + 1, page_size), 0);
+    ASSERT_EQ(crocore::virtual_memory::release(ptr + 1, 2 * page_size), page_size);
+    ASSERT_EQ(ptr[0], 0xFF);
+    ASSERT_EQ(ptr[2 * page_size], 0xFF);
+
+#if defined(__linux__)
+    ASSERT_EQ(crocore::virtual_memory::release(ptr, num_bytes), num_bytes);
+    ASSERT_EQ(num_resident_pages(ptr, num_bytes), 0);
+
+    // range remains usable, released pages read as zeros
+    ASSERT_EQ(ptr[0], 0);
+    ptr[0] = 42;
+    ASSERT_EQ(ptr[0], 42);
+#endif
+    crocore::virtual_memory::unmap(ptr);
+}
+
+TEST(VirtualMemory, BuddyPool)
+{
+    crocore::BuddyPool::create_info_t fmt = {};
+    fmt.block_size = 1U << 22U;
+    fmt.min_block_size = 256;
+    fmt.min_num_blocks = 1;
+    fmt.release_min_bytes = 1U << 16U;
+    fmt.alloc_fn = crocore::virtual_memory::alloc_fn(PageMode::HUGE_TRANSPARENT);
+    fmt.dealloc_fn = crocore::virtual_memory::unmap;
+    auto pool = crocore::BuddyPool::create(fmt);
+
+    auto small = static_cast<uint8_t *>(pool->allocate(256));
+    auto large = static_cast<uint8_t *>(pool->allocate(1U << 20U));
+    ASSERT_NE(small, nullptr);
+    ASSERT_NE(large, nullptr);
+    memset(small, 0xFF, 256);
+    memset(large, 0xFF, 1U << 20U);
+
+    // range is large enough to be released
+    pool->free(large);
+#if defined(__linux__)
+    ASSERT_EQ(num_resident_pages(large, 1U << 20U), 0);
+#endif
+    ASSERT_EQ(small[255], 0xFF);
+
+    large = static_cast<uint8_t *>(pool->allocate(1U << 20U));
+    memset(large, 0xFF, 1U << 20U);
+    pool->free(large);
+    pool->free(small);
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+}
+
+TEST(VirtualMemory, MemoryCache)
+{
+    crocore::MemoryCache::create_info_t create_info = {};
+    create_info.release_min_bytes = 1U << 16U;
+    create_info.alloc_fn = crocore::virtual_memory::alloc_fn(PageMode::DEFAULT);
+    create_info.dealloc_fn = crocore::virtual_memory::unmap;
+    auto cache = crocore::MemoryCache::create(create_info);
+
+    constexpr size_t num_bytes = 1U << 20U;
+    auto ptr = static_cast<uint8_t *>(cache->allocate(num_bytes));
+    memset(ptr, 0xFF, num_bytes);
+    cache->free(ptr);
+
+    // chunk is kept, but not resident anymore
+    ASSERT_EQ(cache->state().num_bytes_allocated, num_bytes);
+#if defined(__linux__)
+    ASSERT_EQ(num_resident_pages(ptr, num_bytes), 0);
+#endif
+    ASSERT_EQ(cache->allocate(num_bytes), ptr);
+    cache->free(ptr);
+
+    // heap-backed chunks are not released
+    for(bool size_classes: {false, true})
+    {
+        create_info = {};
+        create_info.release_min_bytes = 1U << 16U;
+        create_info.size_classes = size_classes;
+        cache = crocore::MemoryCache::create(create_info);
+
+        ptr = static_cast<uint8_t *>(cache->allocate(num_bytes));
+        memset(ptr, 0xFF, num_bytes);
+        cache->free(ptr);
+        ASSERT_EQ(cache->allocate(num_bytes), ptr);
+        ASSERT_EQ(ptr[num_bytes - 1], 0xFF);
+        cache->free(ptr);
+    }
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <bit>
+#include <crocore/fixed_size_free_list.h>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+
+using string_list_t = crocore::fixed_size_free_list<std::string>;
+
+TEST(fixed_size_free_list, basic)
+{
+    string_list_t free_list(16, 4);
+
+    auto a = free_list.create("foo");
+    auto b = free_list.create("bar");
+    ASSERT_NE(a, string_list_t::s_invalid_index);
+    ASSERT_NE(b, string_list_t::s_invalid_index);
+    ASSERT_NE(a, b);
+    ASSERT_EQ(free_list.get(a), "foo");
+    ASSERT_EQ(free_list.get(b), "bar");
+
+    // destroyed objects are recycled
+    free_list.destroy(a);
+    auto c = free_list.create("baz");
+    ASSERT_EQ(c, a);
+    ASSERT_EQ(free_list.get(c), "baz");
+
+    free_list.destroy(&free_list.get(b));
+    free_list.destroy(c);
+
+    // move construction
+    string_list_t other(std::move(free_list));
+    auto d = other.create("moved");
+    ASSERT_EQ(other.get(d), "moved");
+    other.destroy(d);
+}
+
+TEST(fixed_size_free_list, growable)
+{
+    constexpr uint32_t page_size = 4;
+
+    // page table grows on demand
+    {
+        string_list_t free_list(string_list_t::s_invalid_index, page_size);
+        ASSERT_EQ(free_list.capacity(), 0);
+
+        std::vector<uint32_t> indices;
+        for(uint32_t i = 0; i < 1000; ++i)
+        {
+            indices.push_back(free_list.create(std::to_string(i)));
+            ASSERT_NE(indices.back(), string_list_t::s_invalid_index);
+        }
+        ASSERT_GE(free_list.capacity(), 1000);
+        ASSERT_EQ(free_list.capacity() % page_size, 0);
+        for(uint32_t i = 0; i < 1000; ++i){ ASSERT_EQ(free_list.get(indices[i]), std::to_string(i)); }
+        for(auto index: indices){ free_list.destroy(index); }
+    }
+
+    // maximum number of objects is respected
+    {
+        string_list_t free_list(10, page_size);
+        std::vector<uint32_t> indices;
+        for(uint32_t index; (index = free_list.create()) != string_list_t::s_invalid_index;){ indices.push_back(index); }
+
+        // rounded up to pages
+        ASSERT_EQ(indices.size(), 12);
+        ASSERT_EQ(free_list.capacity(), 12);
+        for(auto index: indices){ free_list.destroy(index); }
+    }
+}
+
+TEST(fixed_size_free_list, batch)
+{
+    string_list_t free_list(64, 16);
+
+    std::set<uint32_t> indices;
+    string_list_t::batch_t batch;
+    for(uint32_t i = 0; i < 32; ++i)
+    {
+        auto index = free_list.create(std::string(64, 'x'));
+        indices.insert(index);
+        free_list.add_to_batch(batch, index);
+    }
+    ASSERT_EQ(batch.m_num_objects, 32);
+    free_list.destroy_batch(batch);
+
+    // all objects of the batch are recycled
+    std::vector<uint32_t> recycled;
+    for(uint32_t i = 0; i < 32; ++i){ recycled.push_back(free_list.create()); }
+    ASSERT_EQ(std::set<uint32_t>(recycled.begin(), recycled.end()), indices);
+    for(auto index: recycled){ free_list.destroy(index); }
+}
+
+TEST(fixed_size_free_list, caches)
+{
+    constexpr uint32_t num_threads = 8;
+    constexpr uint32_t num_iterations = 20000;
+    constexpr uint32_t max_num_live = 64;
+
+    string_list_t free_list(string_list_t::s_invalid_index, 256, 32);
+
+    auto worker = [&free_list](uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint32_t> indices;
+
+        for(uint32_t i = 0; i < num_iterations; ++i)
+        {
+            if(!indices.empty() && (indices.size() >= max_num_live || rng() % 2))
+            {
+                size_t pos = rng() % indices.size();
+                auto index = indices[pos];
+                ASSERT_EQ(free_list.get(index), std::to_string(seed) + "_" + std::to_string(index));
+                free_list.destroy(index);
+                indices[pos] = indices.back();
+                indices.pop_back();
+            }
+            else
+            {
+                auto index = free_list.create();
+                ASSERT_NE(index, string_list_t::s_invalid_index);
+                free_list.get(index) = std::to_string(seed) + "_" + std::to_string(index);
+                indices.push_back(index);
+            }
+        }
+        for(auto index: indices){ free_list.destroy(index); }
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < num_threads; ++i){ threads.emplace_back(worker, i); }
+    for(auto &t: threads){ t.join(); }
+
+    // capacity is bounded by live objects, cached objects and a page
+    uint32_t num_caches = std::bit_ceil(std::max(1U, std::thread::hardware_concurrency()));
+    ASSERT_LE(free_list.capacity(), num_threads * max_num_live + num_caches * 32 + 256);
+
+    // after flushing, all objects are available from any thread
+    free_list.flush_caches();
+    uint32_t capacity = free_list.capacity();
+    std::vector<uint32_t> indices;
+    for(uint32_t i = 0; i < capacity; ++i){ indices.push_back(free_list.create()); }
+    ASSERT_EQ(free_list.capacity(), capacity);
+    ASSERT_EQ(std::set<uint32_t>(indices.begin(), indices.end()).size(), capacity);
+    for(auto index: indices){ free_list.destroy(index); }
+
+    // bounded capacity, objects cached by other threads are not lost
+    string_list_t bounded_list(16, 16, 8);
+    indices.clear();
+    for(uint32_t i = 0; i < 16; ++i){ indices.push_back(bounded_list.create()); }
+    ASSERT_EQ(bounded_list.create(), string_list_t::s_invalid_index);
+
+    std::thread([&bounded_list, &indices] {
+        for(uint32_t i = 0; i < 4; ++i){ bounded_list.destroy(indices[i]); }
+    }).join();
+
+    for(uint32_t i = 0; i < 4; ++i)
+    {
+        indices[i] = bounded_list.create();
+        ASSERT_NE(indices[i], string_list_t::s_invalid_index);
+    }
+    for(auto index: indices){ bounded_list.destroy(index); }
+}
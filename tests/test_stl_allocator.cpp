@@ -1,5 +1,13 @@
 #include <gtest/gtest.h>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "crocore/BuddyPool.hpp"
+#include "crocore/MemoryCache.hpp"
+#include "crocore/MonotonicArena.hpp"
+#include "crocore/SlabAllocator.hpp"
 
 crocore::AllocatorPtr create_base_allocator()
 {
@@ -76,4 +84,114 @@ TEST(stl_custom_allocator, map)
         ASSERT_EQ(stl_map_custom["foo"], 42);
     }
     ASSERT_EQ(base_allocator->state().num_bytes_used, 0);
-}
\ No newline at end of file
+}
+TEST(stl_custom_allocator, over_aligned)
+{
+    auto base_allocator = create_base_allocator();
+
+    struct alignas(256) over_aligned_t
+    {
+        uint32_t value = 0;
+    };
+    crocore::stl_allocator<over_aligned_t> custom_allocator(base_allocator);
+
+    {
+        std::vector<over_aligned_t, crocore::stl_allocator<over_aligned_t>> vec(custom_allocator);
+
+        for(uint32_t i = 0; i < 100; ++i)
+        {
+            vec.push_back({i});
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(vec.data()) % alignof(over_aligned_t), 0);
+        }
+    }
+    ASSERT_EQ(base_allocator->state().num_bytes_used, 0);
+}
+
+TEST(pmr_resource, containers)
+{
+    auto base_allocator = create_base_allocator();
+    auto *pool = static_cast<crocore::BuddyPool *>(base_allocator.get());
+    crocore::pmr_resource<crocore::BuddyPool> resource(pool);
+
+    // std::pmr::vector
+    {
+        std::pmr::vector<int> vec(&resource);
+        vec.resize(42);
+        ASSERT_TRUE(pool->state().num_bytes_used >= vec.capacity() * sizeof(int));
+
+        // copies propagate the resource
+        auto copy = std::pmr::vector<int>(vec, &resource);
+        ASSERT_EQ(copy.get_allocator().resource(), &resource);
+    }
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+
+    // std::pmr::map with std::pmr::string keys, using the same resource
+    {
+        std::pmr::map<std::pmr::string, int> map(&resource);
+        map.emplace("a rather long key, exceeding small-string optimization", 69);
+        map.emplace("foo", 42);
+        ASSERT_EQ(map.size(), 2);
+        ASSERT_EQ(map.find("foo")->second, 42);
+        ASSERT_GT(pool->state().num_bytes_used, 0);
+    }
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+
+    // over-aligned
+    {
+        struct alignas(256) over_aligned_t
+        {
+            uint32_t value = 0;
+        };
+        std::pmr::vector<over_aligned_t> vec(&resource);
+
+        for(uint32_t i = 0; i < 100; ++i)
+        {
+            vec.push_back({i});
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(vec.data()) % alignof(over_aligned_t), 0);
+        }
+    }
+    ASSERT_EQ(pool->state().num_bytes_used, 0);
+
+    // no backend-allocator -> will throw upon usage
+    crocore::pmr_resource<crocore::BuddyPool> empty_resource;
+    std::pmr::vector<int> vec(&empty_resource);
+    ASSERT_THROW(vec.resize(10), std::bad_alloc);
+}
+
+TEST(pmr_resource, is_equal)
+{
+    auto base_allocator = create_base_allocator();
+    auto other_allocator = create_base_allocator();
+
+    crocore::pmr_resource<> resource_1(base_allocator.get()), resource_2(base_allocator.get());
+    crocore::pmr_resource<> resource_3(other_allocator.get());
+
+    ASSERT_TRUE(resource_1.is_equal(resource_1));
+    ASSERT_TRUE(resource_1.is_equal(resource_2));
+    ASSERT_FALSE(resource_1.is_equal(resource_3));
+    ASSERT_FALSE(resource_1.is_equal(*std::pmr::new_delete_resource()));
+}
+
+TEST(pmr_resource, allocators)
+{
+    auto memory_cache = crocore::MemoryCache::create({});
+    auto slab_allocator = crocore::SlabAllocator::create({});
+    auto arena = crocore::MonotonicArena::create({});
+
+    crocore::pmr_resource<crocore::MemoryCache> cache_resource(memory_cache.get());
+    crocore::pmr_resource<crocore::SlabAllocator> slab_resource(slab_allocator.get());
+    crocore::pmr_resource<crocore::MonotonicArena> arena_resource(arena.get());
+
+    for(std::pmr::memory_resource *resource: {static_cast<std::pmr::memory_resource *>(&cache_resource),
+                                              static_cast<std::pmr::memory_resource *>(&slab_resource),
+                                              static_cast<std::pmr::memory_resource *>(&arena_resource)})
+    {
+        std::pmr::list<uint64_t> list(resource);
+        for(uint64_t i = 0; i < 1000; ++i){ list.push_back(i); }
+        ASSERT_EQ(list.size(), 1000);
+        ASSERT_EQ(list.back(), 999);
+    }
+    ASSERT_EQ(memory_cache->state().num_bytes_used, 0);
+    ASSERT_EQ(slab_allocator->state().num_bytes_used, 0);
+    ASSERT_GT(arena->state().num_bytes_used, 0);
+}